@@ -0,0 +1,96 @@
+/**
+ * @file adc_sense.c
+ * @brief Implementação da aquisição analógica sincronizada com o PWM
+ *
+ * TIM1 channel 4 (internal only) fires TRGO just before the top of the
+ * center-aligned carrier, so the current conversions straddle it, away from
+ * the switching edges. A shunt carries its phase current only while its low
+ * side conducts: a phase near full duty is still off there (the power meter
+ * rebuilds or skips it). The ADC converts the sequence and the DMA stores
+ * it in a circular buffer; the transfer-complete interrupt runs the bus
+ * voltage filter (shift-only first-order IIR, no divides) and hands the
+ * currents to the power meter.
+ */
+
+#include "adc_sense.h"
+#include "power_meter.h"
+
+/* Private defines */
+#define BUS_FILTER_SHIFT    2   /* IIR weight 1/4 per carrier period */
+#define BUS_FILTER_FRAC     4   /* Extra fractional bits of the filter state */
+
+/* Private variables */
+static ADC_HandleTypeDef* adcHandle;
+static volatile uint16_t adcSamples[ADC_SENSE_CHANNELS];
+static volatile int32_t busFiltered;    /* ADC counts << BUS_FILTER_FRAC */
+
+/**
+ * @brief Initializes the acquisition and starts the DMA
+ * @param hadc Pointer to ADC handle (external trigger already configured)
+ * @retval None
+ */
+void AdcSense_Init(ADC_HandleTypeDef *hadc)
+{
+  adcHandle = hadc;
+
+  /* Until the first sample arrives, assume the nominal bus */
+  busFiltered = (int32_t)(((uint32_t)BUS_NOMINAL_DV * ADC_SENSE_FULL_SCALE) /
+                          BUS_FULL_SCALE_DV) << BUS_FILTER_FRAC;
+
+  HAL_ADCEx_Calibration_Start(adcHandle);
+  HAL_ADC_Start_DMA(adcHandle, (uint32_t*)adcSamples, ADC_SENSE_CHANNELS);
+}
+
+/**
+ * @brief Gets the filtered DC bus voltage
+ * @retval Bus voltage in 0.1 V
+ */
+uint16_t AdcSense_GetBusVoltage(void)
+{
+  uint32_t counts = (uint32_t)busFiltered >> BUS_FILTER_FRAC;
+
+  return (uint16_t)((counts * BUS_FULL_SCALE_DV) / ADC_SENSE_FULL_SCALE);
+}
+
+/**
+ * @brief Gets the bus voltage feed-forward factor
+ * @note nominal / measured, so the modulation index rises when the bus sags
+ *       and falls when it swells; 1.0 when no bus is sensed
+ * @retval Compensation factor, Q12 (BUS_COMP_ONE_Q12 = 1.0)
+ */
+uint16_t AdcSense_GetBusCompensation(void)
+{
+  uint32_t busDv = AdcSense_GetBusVoltage();
+  uint32_t factor;
+
+  if (busDv < BUS_SENSE_VALID_DV)
+  {
+    return BUS_COMP_ONE_Q12;
+  }
+
+  factor = ((uint32_t)BUS_NOMINAL_DV * BUS_COMP_ONE_Q12) / busDv;
+  if (factor < BUS_COMP_MIN_Q12)
+    factor = BUS_COMP_MIN_Q12;
+  if (factor > BUS_COMP_MAX_Q12)
+    factor = BUS_COMP_MAX_Q12;
+
+  return (uint16_t)factor;
+}
+
+/**
+ * @brief ADC conversion complete callback (end of the DMA sequence)
+ * @param hadc Pointer to ADC handle
+ * @retval None
+ */
+void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef *hadc)
+{
+  int32_t sample;
+
+  if (hadc == adcHandle)
+  {
+    sample = (int32_t)adcSamples[ADC_SENSE_RANK_VBUS] << BUS_FILTER_FRAC;
+    busFiltered += (sample - busFiltered) >> BUS_FILTER_SHIFT;
+
+    PowerMeter_Sample(adcSamples);
+  }
+}
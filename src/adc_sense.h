@@ -0,0 +1,69 @@
+/**
+ * @file adc_sense.h
+ * @brief Aquisição analógica sincronizada com o PWM (barramento CC e correntes de fase)
+ */
+
+#ifndef __ADC_SENSE_H
+#define __ADC_SENSE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes */
+#include "stm32f0xx_hal.h"
+#include <stdint.h>
+
+/* Defines */
+#ifndef ADC_SENSE_CURRENT_PHASES
+#define ADC_SENSE_CURRENT_PHASES  3       /* Shunts: 3 (U, V, W) or 2 (U, V; W = -U - V) */
+#endif
+#if ADC_SENSE_CURRENT_PHASES != 2 && ADC_SENSE_CURRENT_PHASES != 3
+#error "ADC_SENSE_CURRENT_PHASES must be 2 or 3"
+#endif
+#define ADC_SENSE_CHANNELS        (ADC_SENSE_CURRENT_PHASES + 1)  /* Conversions per PWM trigger */
+
+/* Positions in the sequence: scanned backwards (IN12, IN11, IN10, IN1) so
+   the currents are converted first, closest to the carrier peak */
+#define ADC_SENSE_RANK_IW         0       /* Only with 3 phases */
+#define ADC_SENSE_RANK_IV         (ADC_SENSE_CURRENT_PHASES - 2)
+#define ADC_SENSE_RANK_IU         (ADC_SENSE_CURRENT_PHASES - 1)
+#define ADC_SENSE_RANK_VBUS       ADC_SENSE_CURRENT_PHASES
+/* Conversion timing in TIM1 ticks: the ADC clock is PCLK / 2 and the timer
+   counts PCLK, so two ticks per ADC cycle at any PCLK (main.c ADC setup) */
+#define ADC_SENSE_SAMPLE_TICKS      27    /* 13.5-cycle sampling time; the hold is at its end */
+#define ADC_SENSE_CONVERSION_TICKS  52    /* Sampling + 12.5-cycle conversion: 6.5 us at 8 MHz */
+#define ADC_SENSE_FULL_SCALE      4095    /* 12-bit converter */
+#define ADC_SENSE_MID_SCALE       2048    /* Zero current of a bipolar sense amplifier */
+
+/* Bus voltage scaling (override with build_flags to match the divider) */
+#ifndef BUS_FULL_SCALE_DV
+#define BUS_FULL_SCALE_DV         4000    /* Bus voltage at ADC full scale, 0.1 V */
+#endif
+#ifndef BUS_NOMINAL_DV
+#define BUS_NOMINAL_DV            3110    /* V/f curve reference (220 Vac rectified), 0.1 V */
+#endif
+#define BUS_SENSE_VALID_DV        (BUS_NOMINAL_DV / 10)  /* Below this: no bus sensed */
+#ifndef BUS_MODULATION_MIN_DV
+#define BUS_MODULATION_MIN_DV     (BUS_NOMINAL_DV * 4 / 5)  /* Lowest bus still followed at full V/f, 0.1 V */
+#endif
+
+/* Feed-forward compensation factor, Q12 (4096 = 1.0) */
+#define BUS_COMP_ONE_Q12          4096
+#define BUS_COMP_MIN_Q12          2048    /* 0.5 */
+#define BUS_COMP_MAX_Q12          8192    /* 2.0 */
+
+/* Modulation index at the nominal bus, Q12: the headroom up to a full
+   index is what the feed-forward and the IR boost can add on a sag */
+#define BUS_MODULATION_INDEX_Q12  ((BUS_MODULATION_MIN_DV * BUS_COMP_ONE_Q12) / BUS_NOMINAL_DV)
+
+/* Public functions */
+void AdcSense_Init(ADC_HandleTypeDef *hadc);
+uint16_t AdcSense_GetBusVoltage(void);
+uint16_t AdcSense_GetBusCompensation(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ADC_SENSE_H */
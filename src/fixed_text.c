@@ -0,0 +1,201 @@
+/**
+ * @file fixed_text.c
+ * @brief Implementação da conversão texto <-> ponto fixo
+ *
+ * Numbers are handled as integers scaled by 10^decimals (e.g. 12.5 Hz with
+ * 3 decimals is 12500 mHz). Every routine runs in time bounded by the number
+ * of characters involved and pulls in neither newlib's float formatting nor
+ * its locale-aware parsers.
+ */
+
+#include "fixed_text.h"
+
+/* Private variables */
+static const uint32_t powersOfTen[FIXED_TEXT_MAX_DECIMALS + 1] = {
+  1, 10, 100, 1000, 10000, 100000, 1000000
+};
+
+/**
+ * @brief Skips blanks
+ * @param text Pointer to text
+ * @retval Pointer to the first non-blank character
+ */
+const char* FixedText_SkipSpaces(const char* text)
+{
+  while (*text == ' ' || *text == '\t')
+  {
+    text++;
+  }
+  return text;
+}
+
+/**
+ * @brief Parses a decimal number into fixed point, in place
+ * @note Accepts "[+|-]digits[.digits]"; fractional digits beyond 'decimals'
+ *       are truncated. The number must end at a blank or at the terminator.
+ * @param text Pointer to the text pointer (advanced past the number)
+ * @param value Pointer to store the value scaled by 10^decimals
+ * @param decimals Number of fractional digits kept (0-6)
+ * @retval 0=success, 1=error (syntax or overflow)
+ */
+uint8_t FixedText_ParseFixed(const char** text, int32_t* value, uint8_t decimals)
+{
+  const char* p = FixedText_SkipSpaces(*text);
+  uint32_t result = 0;
+  uint8_t negative = 0;
+  uint8_t digits = 0;
+  uint8_t fraction = 0;
+
+  if (decimals > FIXED_TEXT_MAX_DECIMALS)
+  {
+    return 1;
+  }
+
+  if (*p == '-' || *p == '+')
+  {
+    negative = (*p == '-');
+    p++;
+  }
+
+  /* Integer part */
+  while (*p >= '0' && *p <= '9')
+  {
+    if (result > (0x7FFFFFFFUL - 9) / 10)
+    {
+      return 1;
+    }
+    result = result * 10 + (uint32_t)(*p - '0');
+    digits++;
+    p++;
+  }
+
+  if (result > 0x7FFFFFFFUL / powersOfTen[decimals])
+  {
+    return 1;
+  }
+  result *= powersOfTen[decimals];
+
+  /* Fractional part */
+  if (*p == '.')
+  {
+    p++;
+    while (*p >= '0' && *p <= '9')
+    {
+      if (fraction < decimals)
+      {
+        fraction++;
+        result += (uint32_t)(*p - '0') * powersOfTen[decimals - fraction];
+        if (result > 0x7FFFFFFFUL)
+        {
+          return 1;
+        }
+      }
+      digits++;
+      p++;
+    }
+  }
+
+  if (digits == 0 || (*p != '\0' && *p != ' ' && *p != '\t'))
+  {
+    return 1;
+  }
+
+  *value = negative ? -(int32_t)result : (int32_t)result;
+  *text = p;
+  return 0;
+}
+
+/**
+ * @brief Copies a string
+ * @retval Pointer to the terminator written at the end
+ */
+char* FixedText_AppendText(char* dst, const char* text)
+{
+  while (*text)
+  {
+    *dst++ = *text++;
+  }
+  *dst = '\0';
+  return dst;
+}
+
+/**
+ * @brief Writes an unsigned integer in decimal
+ * @retval Pointer to the terminator written at the end
+ */
+char* FixedText_AppendUint(char* dst, uint32_t value)
+{
+  char digits[10];
+  uint8_t count = 0;
+
+  do
+  {
+    digits[count++] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+
+  while (count > 0)
+  {
+    *dst++ = digits[--count];
+  }
+  *dst = '\0';
+  return dst;
+}
+
+/**
+ * @brief Writes a signed integer in decimal
+ * @retval Pointer to the terminator written at the end
+ */
+char* FixedText_AppendInt(char* dst, int32_t value)
+{
+  if (value < 0)
+  {
+    *dst++ = '-';
+    return FixedText_AppendUint(dst, (uint32_t)(-(value + 1)) + 1);
+  }
+  return FixedText_AppendUint(dst, (uint32_t)value);
+}
+
+/**
+ * @brief Writes a fixed-point value with a fixed number of decimals
+ * @param dst Destination buffer
+ * @param value Value scaled by 10^decimals
+ * @param decimals Number of fractional digits (0-6)
+ * @retval Pointer to the terminator written at the end
+ */
+char* FixedText_AppendFixed(char* dst, int32_t value, uint8_t decimals)
+{
+  uint32_t magnitude;
+  uint32_t scale;
+  uint32_t fraction;
+
+  if (decimals > FIXED_TEXT_MAX_DECIMALS)
+  {
+    decimals = FIXED_TEXT_MAX_DECIMALS;
+  }
+  scale = powersOfTen[decimals];
+
+  if (value < 0)
+  {
+    *dst++ = '-';
+    magnitude = (uint32_t)(-(value + 1)) + 1;
+  }
+  else
+  {
+    magnitude = (uint32_t)value;
+  }
+
+  dst = FixedText_AppendUint(dst, magnitude / scale);
+  if (decimals > 0)
+  {
+    fraction = magnitude % scale;
+    *dst++ = '.';
+    while (decimals-- > 0)
+    {
+      scale /= 10;
+      *dst++ = (char)('0' + (fraction / scale) % 10);
+    }
+    *dst = '\0';
+  }
+  return dst;
+}
@@ -0,0 +1,31 @@
+/**
+ * @file fixed_text.h
+ * @brief Conversão texto <-> ponto fixo sem ponto flutuante (sem atof/sprintf)
+ */
+
+#ifndef __FIXED_TEXT_H
+#define __FIXED_TEXT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes */
+#include <stdint.h>
+
+/* Defines */
+#define FIXED_TEXT_MAX_DECIMALS  6
+
+/* Public functions */
+uint8_t FixedText_ParseFixed(const char** text, int32_t* value, uint8_t decimals);
+const char* FixedText_SkipSpaces(const char* text);
+char* FixedText_AppendText(char* dst, const char* text);
+char* FixedText_AppendUint(char* dst, uint32_t value);
+char* FixedText_AppendInt(char* dst, int32_t value);
+char* FixedText_AppendFixed(char* dst, int32_t value, uint8_t decimals);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __FIXED_TEXT_H */
@@ -1,10 +1,51 @@
 /**
  * @file freq_control.c
  * @brief Implementação do controle de frequência para o inversor trifásico
+ *
+ * Each axis is a FreqControl_t: a V/f sine modulator and the PWM output it
+ * drives. All axes share one sine table and are advanced together by the
+ * control tick (TIM1 update interrupt). The electrical angle is a 32-bit
+ * phase accumulator (2^32 = one turn), so a tick costs one addition and three
+ * table look-ups per axis, with no floating point in the interrupt. The table
+ * spans 0..PWM_MAX_VALUE; each frame is scaled to the carrier period of its
+ * output (the frame's ARR), so the duty does not depend on the carrier.
+ *
+ * The applied setpoint belongs to the control tick. The main loop (commands,
+ * Modbus) posts setpoints through a per-axis single-writer mailbox that the
+ * tick takes at its start; the sequencer, which runs inside the tick, applies
+ * them directly. Neither side ever masks interrupts.
+ *
+ * Stopping is also done by the tick: FreqControl_Stop() clears runCommand
+ * and the tick plays the configured stop mode (ramp down, DC injection or
+ * both) before switching the outputs off and recording the stop time. Coast
+ * switches the outputs off at once, as before. A START while braking returns
+ * to the setpoint.
+ *
+ * Synchronous PWM: at a fixed frequency whose period is a whole number of
+ * control ticks (over one or a few turns), the compare sequence repeats
+ * exactly. FreqControl_Process() renders that sequence into a RAM cache once
+ * the setpoint has held for a main loop pass, and the control tick hands the
+ * output to a circular DMA at the next zero crossing of phase U. The tick
+ * then only keeps the angle running; any change of setpoint, a bus gain
+ * drift, a ramp or a stop returns to live computation at once.
+ *
+ * Timebase: the control tick counts itself, and an offset set by
+ * FreqControl_AlignTimebase() maps that count onto a timebase shared by
+ * several drives (the master broadcasts its tick). Setpoints can be queued
+ * for a timebase tick: the control tick commits them at that tick, so every
+ * drive applies a coordinated change in the same control period whenever
+ * its main loop received it, and records how late each commit was.
+ *
+ * Load compensation: the motor compensation module hands the tick a slip
+ * frequency and an IR boost (FreqControl_SetCompensation()); the tick adds
+ * them to its copy of the setpoint, so the applied setpoint, the cache and
+ * the commands keep seeing the reference frequency. The mains dip
+ * ride-through caps the frequency the same way (FreqControl_SetFrequencyLimit()).
  */
 
 #include "freq_control.h"
 #include "pwm_control.h"
+#include "adc_sense.h"
 #include "main.h"
 #include <math.h>
 
@@ -13,163 +54,1104 @@
 #define TWO_PI              (2.0f * PI)
 #define PWM_MAX_VALUE       1000
 #define PWM_CARRIER_FREQ    10000   /* 10kHz PWM carrier frequency */
-#define SINE_TABLE_SIZE     360     /* One value per degree */
-#define PHASE_120_DEGREES   120
-#define PHASE_240_DEGREES   240
+#define SINE_TABLE_BITS     8
+#define SINE_TABLE_SIZE     (1U << SINE_TABLE_BITS)
+#define SINE_INDEX_SHIFT    (32 - SINE_TABLE_BITS)
+#define PHASE_120_DEGREES   ((uint32_t)0x55555555UL)   /* 2^32 / 3 (wraps with the angle) */
+#define PHASE_240_DEGREES   ((uint32_t)0xAAAAAAABUL)   /* 2^32 * 2 / 3 */
+#define DEFAULT_DECEL_MHZ_S 10000UL         /* 10 Hz/s */
+#define DEFAULT_DC_DUTY     50              /* 5.0 % */
+#define DEFAULT_DC_TIME_MS  500
+#define SYNC_BUS_TOLERANCE  (BUS_COMP_ONE_Q12 / 64)   /* Bus gain drift served from the cache */
+#define STEP_PER_MHZ_Q16    ((int64_t)((1ULL << 48) / (1000ULL * PWM_CONTROL_TICK_HZ)))  /* Phase step per mHz, Q16 */
+
+/* Braking phases (FreqControl_t.stopPhase) */
+#define STOP_PHASE_NONE     0
+#define STOP_PHASE_RAMP     1
+#define STOP_PHASE_DC       2
 
 /* Private variables */
-static float targetFrequency = 10.0f;  /* Default frequency 10 Hz */
-static float currentAngle = 0.0f;
-static float angleIncrement = 0.0f;
-static uint8_t isRunning = 0;
+static FreqControl_t axes[FREQ_AXIS_COUNT];
 static uint16_t sineTable[SINE_TABLE_SIZE];
-static uint8_t voltageBoost = 0;       /* Voltage boost percentage (0-20) */
+static uint16_t syncCompares[FREQ_SYNC_CACHE_FRAMES * PWM_PHASE_COUNT];
+static uint8_t syncCacheTaken = 0;     /* The cache serves one axis */
+static volatile uint32_t controlTicks = 0;    /* Control tick count since reset */
+static volatile uint32_t timebaseOffset = 0;  /* Main loop: timebase - controlTicks */
+static volatile int32_t lastAlignment = 0;    /* Timebase correction of the last alignment */
 
 /* Private function prototypes */
-static void UpdateAngleIncrement(void);
+static void ComputeSetpoint(FreqSetpoint_t *setpoint, uint32_t freqMilliHz);
+static void TakeMailbox(FreqControl_t *axis);
+static void TakeSchedule(FreqControl_t *axis, uint32_t timebase);
 static void GenerateSineTable(void);
-static uint16_t GetSineValue(float angle);
+static void ApplyCompensation(const FreqControl_t *axis, FreqSetpoint_t *setpoint);
+static void UpdateAxis(FreqControl_t *axis, const FreqSetpoint_t *setpoint, uint16_t busGain);
+static uint8_t SyncTick(FreqControl_t *axis, const FreqSetpoint_t *setpoint, uint16_t busGain);
+static void RenderSyncCache(FreqControl_t *axis, uint32_t freqMilliHz, uint16_t busGain);
+static uint16_t ModulationGain(const FreqSetpoint_t *setpoint, uint16_t busGain, uint8_t *clipped);
+static void RenderFrame(uint32_t angle, uint16_t gainQ12, uint16_t period, uint16_t *compare);
+static uint8_t BusGainDrifted(uint16_t busGain, uint16_t cachedGain);
+static uint32_t Gcd(uint32_t a, uint32_t b);
+static void BrakeAxis(FreqControl_t *axis, uint16_t busGain);
+static void ApplyDcInjection(FreqControl_t *axis, uint16_t busGain);
+static void FinishStop(FreqControl_t *axis);
+static uint16_t ScaleAmplitude(uint16_t value, uint16_t scaleQ12, uint16_t period);
 
 /**
- * @brief Initializes the frequency control module
+ * @brief Initializes the frequency control module (shared sine table)
+ * @note Call before FreqControl_InitAxis()
  * @retval None
  */
 void FreqControl_Init(void)
 {
   /* Generate sine look-up table */
   GenerateSineTable();
-  
-  /* Initialize PWM carrier frequency */
-  PWMControl_SetCarrierFreq(PWM_CARRIER_FREQ);
-  
-  /* Initial update of angle increment */
-  UpdateAngleIncrement();
-  
+}
+
+/**
+ * @brief Initializes one axis and its PWM output
+ * @param number Axis number (1..FREQ_AXIS_COUNT)
+ * @param htim Pointer to the PWM timer handle of the axis
+ * @retval Axis object, NULL if the number is invalid
+ */
+FreqControl_t* FreqControl_InitAxis(uint8_t number, TIM_HandleTypeDef *htim)
+{
+  FreqControl_t* axis;
+
+  if (number < 1 || number > FREQ_AXIS_COUNT)
+  {
+    return NULL;
+  }
+  axis = &axes[number - 1];
+
   /* Reset variables */
-  currentAngle = 0.0f;
-  isRunning = 0;
-  voltageBoost = 10; /* 10% voltage boost at low frequencies */
+  axis->number = number;
+  axis->isRunning = 0;
+  axis->runCommand = 0;
+  axis->stopPhase = STOP_PHASE_NONE;
+  axis->lastStopMs = 0;
+  axis->phase = 0;
+  axis->faultCode = FREQ_FAULT_NONE;
+  axis->limitMilliHz = 0;
+  axis->compSlipMilliHz = 0;
+  axis->compSlipStep = 0;
+  axis->compBoostQ12 = 0;
+  axis->clippedTicks = 0;
+
+  /* Coast to stop unless configured otherwise */
+  axis->stop.mode = FREQ_STOP_COAST;
+  axis->stop.decelMilliHzPerS = DEFAULT_DECEL_MHZ_S;
+  axis->stop.dcDutyPermille = DEFAULT_DC_DUTY;
+  axis->stop.dcTimeMs = DEFAULT_DC_TIME_MS;
+  axis->mailbox.published = 0;
+  axis->mailbox.sequence = 0;
+  axis->appliedSequence = 0;
+  axis->schedule.head = 0;
+  axis->schedule.tail = 0;
+  axis->schedule.commits = 0;
+  axis->schedule.lastLateness = 0;
+  axis->schedule.worstLateness = 0;
+
+  /* Initialize PWM output and carrier frequency */
+  PWMControl_Init(&axis->pwm, htim);
+  PWMControl_SetCarrierFreq(&axis->pwm, PWM_CARRIER_FREQ);
+
+  /* Synchronous PWM cache (off until requested) for the first output with
+     a replay DMA */
+  axis->sync.compares = NULL;
+  axis->sync.enabled = 0;
+  axis->sync.valid = 0;
+  axis->sync.frames = 0;
+  axis->sync.periods = 0;
+  axis->sync.period = 0;
+  axis->sync.lastMilliHz = 0;
+  axis->sync.replayedTicks = 0;
+  if (!syncCacheTaken && PWMControl_CanReplay(&axis->pwm))
+  {
+    axis->sync.compares = syncCompares;
+    syncCacheTaken = 1;
+  }
+
+  /* Default frequency 10 Hz */
+  FreqControl_ApplyFrequencyMilliHz(axis, 10000);
+
+  return axis;
+}
+
+/**
+ * @brief Gets an initialized axis
+ * @param number Axis number (1..FREQ_AXIS_COUNT)
+ * @retval Axis object, NULL if the number is invalid or not initialized
+ */
+FreqControl_t* FreqControl_GetAxis(uint8_t number)
+{
+  if (number < 1 || number > FREQ_AXIS_COUNT || axes[number - 1].number == 0)
+  {
+    return NULL;
+  }
+  return &axes[number - 1];
 }
 
 /**
  * @brief Sets the output frequency
+ * @param axis Axis object
  * @param freqHz Frequency in Hz
  * @retval 0=success, 1=error (invalid frequency)
  */
-uint8_t FreqControl_SetFrequency(float freqHz)
+uint8_t FreqControl_SetFrequency(FreqControl_t *axis, float freqHz)
 {
   /* Validate frequency */
   if (freqHz < FREQ_MIN || freqHz > FREQ_MAX)
   {
     return 1; /* Error: Invalid frequency */
   }
-  
-  /* Update target frequency */
-  targetFrequency = freqHz;
-  
-  /* Update angle increment */
-  UpdateAngleIncrement();
-  
+
+  return FreqControl_SetFrequencyMilliHz(axis, (uint32_t)(freqHz * 1000.0f + 0.5f));
+}
+
+/**
+ * @brief Sets the output frequency in fixed point
+ * @note Main loop context only (single writer of the mailbox). The control
+ *       tick applies the setpoint at its next start.
+ * @param axis Axis object
+ * @param freqMilliHz Frequency in mHz
+ * @retval 0=success, 1=error (invalid frequency)
+ */
+uint8_t FreqControl_SetFrequencyMilliHz(FreqControl_t *axis, uint32_t freqMilliHz)
+{
+  FreqMailbox_t* mailbox = &axis->mailbox;
+  uint8_t slot;
+
+  /* Validate frequency */
+  if (freqMilliHz < FREQ_MIN_MHZ || freqMilliHz > FREQ_MAX_MHZ)
+  {
+    return 1; /* Error: Invalid frequency */
+  }
+
+  /* Fill the slot the control tick cannot be reading, then publish it */
+  slot = mailbox->published ^ 1;
+  ComputeSetpoint(&mailbox->slots[slot], freqMilliHz);
+  __DMB();
+  mailbox->published = slot;
+  __DMB();
+  mailbox->sequence++;
+
   return 0; /* Success */
 }
 
+/**
+ * @brief Applies the output frequency immediately
+ * @note Control tick context only (e.g. the sequencer), or before the
+ *       control tick is enabled
+ * @param axis Axis object
+ * @param freqMilliHz Frequency in mHz
+ * @retval 0=success, 1=error (invalid frequency)
+ */
+uint8_t FreqControl_ApplyFrequencyMilliHz(FreqControl_t *axis, uint32_t freqMilliHz)
+{
+  FreqSetpoint_t setpoint;
+
+  if (freqMilliHz < FREQ_MIN_MHZ || freqMilliHz > FREQ_MAX_MHZ)
+  {
+    return 1;
+  }
+
+  ComputeSetpoint(&setpoint, freqMilliHz);
+  axis->setpoint = setpoint;
+
+  return 0;
+}
+
+/**
+ * @brief Gets the output frequency setpoint in fixed point
+ * @note Includes a setpoint posted but not yet taken by the control tick
+ * @param axis Axis object
+ * @retval Frequency in mHz
+ */
+uint32_t FreqControl_GetFrequencyMilliHz(const FreqControl_t *axis)
+{
+  if (axis->mailbox.sequence != axis->appliedSequence)
+  {
+    return axis->mailbox.slots[axis->mailbox.published].milliHz;
+  }
+  return axis->setpoint.milliHz;
+}
+
+/**
+ * @brief Gets the frequency currently applied to the motor in fixed point
+ * @param axis Axis object
+ * @retval Output frequency in mHz (0 when stopped)
+ */
+uint32_t FreqControl_GetOutputFrequencyMilliHz(const FreqControl_t *axis)
+{
+  int32_t output;
+
+  if (!axis->isRunning || axis->stopPhase == STOP_PHASE_DC)
+  {
+    return 0;
+  }
+  if (axis->stopPhase == STOP_PHASE_RAMP)
+  {
+    return axis->rampMilliHz;
+  }
+  output = (int32_t)axis->setpoint.milliHz;
+  if (axis->limitMilliHz != 0 && (int32_t)axis->limitMilliHz < output)
+  {
+    output = (int32_t)axis->limitMilliHz;
+  }
+  output += axis->compSlipMilliHz;
+  return (output > 0) ? (uint32_t)output : 0;
+}
+
 /**
  * @brief Gets the current output frequency
+ * @param axis Axis object
  * @retval Current frequency in Hz
  */
-float FreqControl_GetFrequency(void)
+float FreqControl_GetFrequency(const FreqControl_t *axis)
+{
+  return FreqControl_GetFrequencyMilliHz(axis) / 1000.0f;
+}
+
+/**
+ * @brief Gets the frequency currently applied to the motor
+ * @param axis Axis object
+ * @retval Output frequency in Hz (0 when stopped)
+ */
+float FreqControl_GetOutputFrequency(const FreqControl_t *axis)
 {
-  return targetFrequency;
+  return FreqControl_GetOutputFrequencyMilliHz(axis) / 1000.0f;
 }
 
 /**
  * @brief Starts the inverter
+ * @param axis Axis object
  * @retval 0=success, 1=error
  */
-uint8_t FreqControl_Start(void)
+uint8_t FreqControl_Start(FreqControl_t *axis)
 {
-  if (!isRunning)
+  /* While braking, the control tick resumes on its own; once it has
+     finished the stop (isRunning cleared) the outputs are restarted here */
+  axis->runCommand = 1;
+  __DMB();
+  if (!axis->isRunning)
   {
     /* Enable PWM outputs */
-    PWMControl_Enable();
-    isRunning = 1;
+    PWMControl_Enable(&axis->pwm);
+    axis->isRunning = 1;
   }
-  
+
   return 0; /* Success */
 }
 
 /**
- * @brief Stops the inverter
+ * @brief Stops the inverter with the configured stop mode
+ * @note Coast switches the outputs off here; the other modes are played by
+ *       the control tick and FreqControl_IsRunning() stays 1 until done
+ * @param axis Axis object
  * @retval 0=success, 1=error
  */
-uint8_t FreqControl_Stop(void)
+uint8_t FreqControl_Stop(FreqControl_t *axis)
 {
-  if (isRunning)
+  axis->runCommand = 0;
+  __DMB();
+  if (axis->isRunning && axis->stop.mode == FREQ_STOP_COAST)
   {
-    /* Disable PWM outputs */
-    PWMControl_Disable();
-    isRunning = 0;
+    /* Stop modulating first: the control tick must not commit frames
+       while the outputs are being switched off */
+    axis->isRunning = 0;
+    PWMControl_Disable(&axis->pwm);
+    axis->lastStopMs = 0;
   }
-  
+
   return 0; /* Success */
 }
 
 /**
  * @brief Checks if the inverter is running
- * @retval 1 if running, 0 if stopped
+ * @param axis Axis object
+ * @retval 1 if running (outputs enabled, braking included), 0 if stopped
+ */
+uint8_t FreqControl_IsRunning(const FreqControl_t *axis)
+{
+  return axis->isRunning;
+}
+
+/**
+ * @brief Checks if a stop is in progress (ramp or DC injection)
+ * @param axis Axis object
+ * @retval 1 if braking
+ */
+uint8_t FreqControl_IsStopping(const FreqControl_t *axis)
+{
+  return axis->isRunning && !axis->runCommand;
+}
+
+/**
+ * @brief Selects how FreqControl_Stop() stops the motor
+ * @note Takes effect at the next stop; a coast request during a controlled
+ *       stop switches the outputs off at once
+ * @param axis Axis object
+ * @param mode FREQ_STOP_* mode
+ * @retval 0=success, 1=error (invalid mode)
+ */
+uint8_t FreqControl_SetStopMode(FreqControl_t *axis, FreqStopMode_t mode)
+{
+  if (mode > FREQ_STOP_RAMP_DC)
+  {
+    return 1;
+  }
+  axis->stop.mode = mode;
+  return 0;
+}
+
+/**
+ * @brief Sets the ramp-to-stop deceleration
+ * @param axis Axis object
+ * @param milliHzPerS Deceleration in mHz/s
+ * @retval 0=success, 1=error (out of range)
+ */
+uint8_t FreqControl_SetDecelRate(FreqControl_t *axis, uint32_t milliHzPerS)
+{
+  if (milliHzPerS < FREQ_DECEL_MIN_MHZ_S || milliHzPerS > FREQ_DECEL_MAX_MHZ_S)
+  {
+    return 1;
+  }
+  axis->stop.decelMilliHzPerS = milliHzPerS;
+  return 0;
+}
+
+/**
+ * @brief Sets the DC injection braking level and duration
+ * @param axis Axis object
+ * @param dutyPermille DC voltage between phase U and phases V/W, permille
+ *        of the bus (sets the braking current through the winding resistance)
+ * @param timeMs Injection time in ms
+ * @retval 0=success, 1=error (out of range)
+ */
+uint8_t FreqControl_SetDcBrake(FreqControl_t *axis, uint16_t dutyPermille, uint16_t timeMs)
+{
+  if (dutyPermille > FREQ_DC_DUTY_MAX || timeMs > FREQ_DC_TIME_MAX_MS)
+  {
+    return 1;
+  }
+  axis->stop.dcDutyPermille = dutyPermille;
+  axis->stop.dcTimeMs = timeMs;
+  return 0;
+}
+
+/**
+ * @brief Gets the stop configuration
+ * @param axis Axis object
+ * @retval Pointer to the stop configuration
+ */
+const FreqStopConfig_t* FreqControl_GetStopConfig(const FreqControl_t *axis)
+{
+  return &axis->stop;
+}
+
+/**
+ * @brief Gets the duration of the last stop
+ * @param axis Axis object
+ * @retval Time from the stop request to the outputs off, in ms (0 for coast)
+ */
+uint32_t FreqControl_GetLastStopTimeMs(const FreqControl_t *axis)
+{
+  return axis->lastStopMs;
+}
+
+/**
+ * @brief Gets the number of ticks with the amplitude limited
+ * @param axis Axis object
+ * @retval Control ticks (live or replayed) modulated below the V/f voltage
+ */
+uint32_t FreqControl_GetClippedTicks(const FreqControl_t *axis)
+{
+  return axis->clippedTicks;
+}
+
+/**
+ * @brief Enables or disables synchronous PWM
+ * @note The cache is rendered by FreqControl_Process() once the setpoint
+ *       holds; disabling returns to live computation at the next tick
+ * @param axis Axis object
+ * @param enable 1 = replay cached periods when possible, 0 = always live
+ * @retval 0=success, 1=error (no replay DMA on this output)
+ */
+uint8_t FreqControl_SetSync(FreqControl_t *axis, uint8_t enable)
+{
+  if (axis->sync.compares == NULL)
+  {
+    return 1;
+  }
+  axis->sync.enabled = enable ? 1 : 0;
+  return 0;
+}
+
+/**
+ * @brief Gets the synchronous PWM cache state
+ * @param axis Axis object
+ * @retval Pointer to the cache state (compares is NULL without replay DMA)
+ */
+const FreqSync_t* FreqControl_GetSync(const FreqControl_t *axis)
+{
+  return &axis->sync;
+}
+
+/**
+ * @brief Checks if the outputs are being replayed from the cache
+ * @param axis Axis object
+ * @retval 1 if the DMA feeds the compares (cache hit)
+ */
+uint8_t FreqControl_IsSyncActive(const FreqControl_t *axis)
+{
+  return axis->pwm.replaying;
+}
+
+/**
+ * @brief Gets the number of control ticks since reset
+ * @note Used to time-stamp received commands for FreqControl_AlignTimebase()
+ * @retval Control ticks (wraps around)
+ */
+uint32_t FreqControl_GetTick(void)
+{
+  return controlTicks;
+}
+
+/**
+ * @brief Gets the shared timebase
+ * @retval Aligned tick of the last control tick
+ */
+uint32_t FreqControl_GetTimebase(void)
+{
+  return controlTicks + timebaseOffset;
+}
+
+/**
+ * @brief Aligns the timebase on a tick sent by the master
+ * @note Main loop context. The master's tick is taken as the timebase at
+ *       the reception of the command, so the main loop latency does not
+ *       count; queued setpoints keep their timebase ticks.
+ * @param timebase Tick sent by the master
+ * @param rxTick FreqControl_GetTick() when the command was received
+ * @retval Correction applied, in ticks (> 0 = this drive was behind)
+ */
+int32_t FreqControl_AlignTimebase(uint32_t timebase, uint32_t rxTick)
+{
+  uint32_t offset = timebase - rxTick;
+  int32_t correction = (int32_t)(offset - timebaseOffset);
+
+  timebaseOffset = offset;
+  lastAlignment = correction;
+  return correction;
+}
+
+/**
+ * @brief Gets the correction applied by the last timebase alignment
+ * @retval Ticks (> 0 = this drive was behind)
+ */
+int32_t FreqControl_GetLastAlignment(void)
+{
+  return lastAlignment;
+}
+
+/**
+ * @brief Queues a setpoint to commit at a timebase tick
+ * @note Main loop context only (single writer of the queue). A tick already
+ *       past is committed at the next control tick and reported as late.
+ * @param axis Axis object
+ * @param freqMilliHz Frequency in mHz
+ * @param atTick Timebase tick of the commit (not before the last queued one)
+ * @retval 0=success, 1=error (invalid frequency, queue full or out of order)
+ */
+uint8_t FreqControl_ScheduleFrequencyMilliHz(FreqControl_t *axis, uint32_t freqMilliHz, uint32_t atTick)
+{
+  FreqSchedule_t* schedule = &axis->schedule;
+  uint8_t next = (schedule->head + 1) % FREQ_SCHEDULE_SLOTS;
+
+  if (freqMilliHz < FREQ_MIN_MHZ || freqMilliHz > FREQ_MAX_MHZ ||
+      !FreqControl_CanSchedule(axis, atTick))
+  {
+    return 1;
+  }
+
+  ComputeSetpoint(&schedule->entries[schedule->head].setpoint, freqMilliHz);
+  schedule->entries[schedule->head].atTick = atTick;
+  schedule->lastTick = atTick;
+  __DMB();
+  schedule->head = next;
+
+  return 0;
+}
+
+/**
+ * @brief Checks whether a setpoint can be queued for a timebase tick
+ * @note Lets a caller validate a request before acting on it; main loop only
+ * @param axis Axis object
+ * @param atTick Timebase tick of the commit
+ * @retval 1 if the queue has room and the tick is not before the last queued one
+ */
+uint8_t FreqControl_CanSchedule(const FreqControl_t *axis, uint32_t atTick)
+{
+  const FreqSchedule_t* schedule = &axis->schedule;
+
+  if (FreqControl_GetScheduledCount(axis) >= FREQ_SCHEDULE_DEPTH)
+  {
+    return 0;
+  }
+
+  /* The control tick only looks at the oldest entry */
+  return schedule->head == schedule->tail || (int32_t)(atTick - schedule->lastTick) >= 0;
+}
+
+/**
+ * @brief Gets the scheduled setpoint queue and its commit statistics
+ * @param axis Axis object
+ * @retval Pointer to the queue
+ */
+const FreqSchedule_t* FreqControl_GetSchedule(const FreqControl_t *axis)
+{
+  return &axis->schedule;
+}
+
+/**
+ * @brief Gets the number of setpoints waiting for their tick
+ * @param axis Axis object
+ * @retval Pending entries
+ */
+uint8_t FreqControl_GetScheduledCount(const FreqControl_t *axis)
+{
+  return (uint8_t)((axis->schedule.head + FREQ_SCHEDULE_SLOTS - axis->schedule.tail) %
+                   FREQ_SCHEDULE_SLOTS);
+}
+
+/**
+ * @brief Sets the load compensation of an axis (slip and IR boost)
+ * @note Called from the control tick, before FreqControl_Update(); applied
+ *       on top of the setpoint while the axis runs, never while braking
+ * @param axis Axis object
+ * @param slipMilliHz Frequency added to the setpoint, mHz (< 0 regenerating)
+ * @param boostQ12 Amplitude gain added to the nominal V/f, Q12
+ * @retval None
+ */
+void FreqControl_SetCompensation(FreqControl_t *axis, int32_t slipMilliHz, uint16_t boostQ12)
+{
+  /* Multiply and shift (the divide by 2^16 is folded by the compiler) */
+  axis->compSlipStep = (int32_t)((slipMilliHz * STEP_PER_MHZ_Q16) / 65536);
+  axis->compSlipMilliHz = slipMilliHz;
+  axis->compBoostQ12 = boostQ12;
+}
+
+/**
+ * @brief Caps the output frequency of an axis below its setpoint
+ * @note Called from the control tick (mains dip ride-through). The setpoint
+ *       is kept, so removing the cap returns to it; a ramp stop starts from
+ *       the capped frequency and clears the cap
+ * @param axis Axis object
+ * @param limitMilliHz Highest output frequency, mHz (0 = no cap)
+ * @retval None
  */
-uint8_t FreqControl_IsRunning(void)
+void FreqControl_SetFrequencyLimit(FreqControl_t *axis, uint32_t limitMilliHz)
 {
-  return isRunning;
+  axis->limitMilliHz = limitMilliHz;
 }
 
 /**
- * @brief Updates the inverter state (should be called periodically)
+ * @brief Updates the inverter state of every axis
+ * @note Called once per control tick from the TIM1 update interrupt
  * @retval None
  */
 void FreqControl_Update(void)
 {
-  if (isRunning)
+  /* DC bus feed-forward: keep the applied V/f independent of bus ripple */
+  uint16_t busGain = AdcSense_GetBusCompensation();
+  uint32_t timebase;
+  uint8_t i;
+
+  controlTicks++;
+  timebase = controlTicks + timebaseOffset;
+
+  for (i = 0; i < FREQ_AXIS_COUNT; i++)
   {
-    uint16_t phaseU, phaseV, phaseW;
-    float angleU, angleV, angleW;
-    
-    /* Update current angle */
-    currentAngle += angleIncrement;
-    if (currentAngle >= TWO_PI)
+    FreqControl_t* axis = &axes[i];
+
+    if (axis->pwm.advanced)
+    {
+      PWMControl_CountUpdateEvent(&axis->pwm);
+    }
+    TakeMailbox(axis);
+    TakeSchedule(axis, timebase);
+    if (!axis->isRunning)
     {
-      currentAngle -= TWO_PI;
+      continue;
+    }
+    if (axis->runCommand)
+    {
+      FreqSetpoint_t setpoint = axis->setpoint;
+
+      axis->stopPhase = STOP_PHASE_NONE;
+      if (axis->limitMilliHz != 0 && axis->limitMilliHz < setpoint.milliHz)
+      {
+        ComputeSetpoint(&setpoint, axis->limitMilliHz);
+      }
+      ApplyCompensation(axis, &setpoint);
+      if (axis->sync.compares == NULL || !SyncTick(axis, &setpoint, busGain))
+      {
+        UpdateAxis(axis, &setpoint, busGain);
+      }
+    }
+    else
+    {
+      /* Braking frames are always computed */
+      PWMControl_StopReplay(&axis->pwm);
+      BrakeAxis(axis, busGain);
     }
-    
-    /* Calculate the three phase angles (120 degrees apart) */
-    angleU = currentAngle;
-    angleV = currentAngle + (PHASE_120_DEGREES * (PI / 180.0f));
-    angleW = currentAngle + (PHASE_240_DEGREES * (PI / 180.0f));
-    
-    /* Wrap angles to 0-2PI */
-    if (angleV >= TWO_PI) angleV -= TWO_PI;
-    if (angleW >= TWO_PI) angleW -= TWO_PI;
-    
-    /* Get sine values for each phase */
-    phaseU = GetSineValue(angleU);
-    phaseV = GetSineValue(angleV);
-    phaseW = GetSineValue(angleW);
-    
-    /* Update PWM outputs */
-    PWMControl_SetOutputs(phaseU, phaseV, phaseW);
   }
 }
 
 /**
- * @brief Updates angle increment based on target frequency
+ * @brief Background work of every axis (synchronous PWM cache)
+ * @note Called from the main loop; renders a cache only when the setpoint
+ *       is unchanged since the previous call, so ramps stay live
  * @retval None
  */
-static void UpdateAngleIncrement(void)
+void FreqControl_Process(void)
 {
+  uint16_t busGain = AdcSense_GetBusCompensation();
+  uint8_t i;
+
+  for (i = 0; i < FREQ_AXIS_COUNT; i++)
+  {
+    FreqSync_t* sync = &axes[i].sync;
+    uint32_t milliHz = axes[i].setpoint.milliHz;
+
+    if (sync->compares == NULL)
+    {
+      continue;
+    }
+
+    /* Stale cache: the control tick stops replaying it at its next run */
+    if (sync->valid && (!sync->enabled || sync->milliHz != milliHz ||
+                        BusGainDrifted(busGain, sync->busGain) ||
+                        sync->period != PWMControl_GetActiveFrame(&axes[i].pwm)->period))
+    {
+      sync->valid = 0;
+      __DMB();
+    }
+
+    /* A cache that is not valid is never started, so once the replay has
+       stopped it belongs to this loop */
+    if (sync->enabled && !sync->valid && !axes[i].pwm.replaying &&
+        milliHz == sync->lastMilliHz)
+    {
+      RenderSyncCache(&axes[i], milliHz, busGain);
+    }
+    sync->lastMilliHz = milliHz;
+  }
+}
+
+/**
+ * @brief Gets the active fault code
+ * @param axis Axis object
+ * @retval FREQ_FAULT_* code
+ */
+uint16_t FreqControl_GetFaultCode(const FreqControl_t *axis)
+{
+  return axis->faultCode;
+}
+
+/**
+ * @brief Clears the active fault
+ * @param axis Axis object
+ * @retval None
+ */
+void FreqControl_ClearFault(FreqControl_t *axis)
+{
+  axis->faultCode = FREQ_FAULT_NONE;
+}
+
+/**
+ * @brief Adds the load compensation to the setpoint of a running axis
+ * @param axis Axis object
+ * @param setpoint Copy of the applied setpoint, modified
+ * @retval None
+ */
+static void ApplyCompensation(const FreqControl_t *axis, FreqSetpoint_t *setpoint)
+{
+  int32_t step = (int32_t)setpoint->phaseStep + axis->compSlipStep;
+
+  /* Never turns the field backwards: a regenerating slip stops at 0 Hz */
+  setpoint->phaseStep = (step > 0) ? (uint32_t)step : 0;
+  setpoint->gainQ12 += axis->compBoostQ12;
+}
+
+/**
+ * @brief Advances one axis by one control tick and commits its PWM frame
+ * @param axis Axis object
+ * @param setpoint Frequency terms to modulate with
+ * @param busGain DC bus compensation, Q12
+ * @retval None
+ */
+static void UpdateAxis(FreqControl_t *axis, const FreqSetpoint_t *setpoint, uint16_t busGain)
+{
+  uint16_t compare[PWM_PHASE_COUNT];
+  uint16_t gainQ12;
+  uint8_t clipped;
+
+  /* Update current angle (wraps around by itself) */
+  axis->phase += setpoint->phaseStep;
+
+  gainQ12 = ModulationGain(setpoint, busGain, &clipped);
+  axis->clippedTicks += clipped;
+  RenderFrame(axis->phase, gainQ12, PWMControl_GetActiveFrame(&axis->pwm)->period, compare);
+
+  /* Update PWM outputs */
+  PWMControl_SetOutputs(&axis->pwm, compare[0], compare[1], compare[2]);
+}
+
+/**
+ * @brief Serves one control tick from the synchronous PWM cache
+ * @note While replaying, the DMA writes the compares and the tick only keeps
+ *       the angle running. A replay starts on the tick where phase U would
+ *       wrap: that frame is computed at angle 0 (the last cache entry), and
+ *       the DMA plays the first entry at the next update event.
+ * @param axis Axis object (running, with a cache)
+ * @param setpoint Frequency terms to modulate with
+ * @param busGain DC bus compensation, Q12
+ * @retval 1 if the tick was handled, 0 if the frame must be computed live
+ */
+static uint8_t SyncTick(FreqControl_t *axis, const FreqSetpoint_t *setpoint, uint16_t busGain)
+{
+  FreqSync_t* sync = &axis->sync;
+  uint8_t usable = sync->valid && sync->milliHz == setpoint->milliHz &&
+                   !BusGainDrifted(busGain, sync->busGain) &&
+                   sync->period == PWMControl_GetActiveFrame(&axis->pwm)->period &&
+                   axis->compSlipStep == 0 && axis->compBoostQ12 == 0;
+
+  if (axis->pwm.replaying)
+  {
+    if (usable)
+    {
+      axis->phase += setpoint->phaseStep;
+      axis->clippedTicks += sync->clipped;
+      sync->replayedTicks++;
+      return 1;
+    }
+
+    /* The frame committed now replaces the triplet written at this update */
+    PWMControl_StopReplay(&axis->pwm);
+    return 0;
+  }
+
+  if (usable && axis->phase + setpoint->phaseStep < axis->phase)
+  {
+    axis->phase = 0 - setpoint->phaseStep;
+    UpdateAxis(axis, setpoint, busGain);
+    PWMControl_StartReplay(&axis->pwm, sync->compares, sync->frames);
+    return 1;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Renders the synchronous PWM cache for a frequency
+ * @note The cache holds the smallest whole number of turns that is also a
+ *       whole number of control ticks; entry i is the frame of tick i + 1
+ *       after a zero crossing, so the last entry is angle 0 again
+ * @param axis Axis object (cache not being replayed)
+ * @param freqMilliHz Frequency in mHz
+ * @param busGain DC bus compensation to freeze in the cache, Q12
+ * @retval None
+ */
+static void RenderSyncCache(FreqControl_t *axis, uint32_t freqMilliHz, uint16_t busGain)
+{
+  FreqSync_t* sync = &axis->sync;
+  FreqSetpoint_t setpoint;
+  uint32_t divisor = Gcd(freqMilliHz, 1000UL * PWM_CONTROL_TICK_HZ);
+  uint32_t frames = (1000UL * PWM_CONTROL_TICK_HZ) / divisor;
+  uint32_t periods = freqMilliHz / divisor;
+  uint16_t period = PWMControl_GetActiveFrame(&axis->pwm)->period;
+  uint16_t gainQ12;
+  uint8_t clipped;
+  uint32_t i;
+
+  sync->milliHz = freqMilliHz;
+  if (frames > FREQ_SYNC_CACHE_FRAMES)
+  {
+    /* No whole period fits: stays live */
+    sync->frames = 0;
+    sync->periods = 0;
+    return;
+  }
+
+  ComputeSetpoint(&setpoint, freqMilliHz);
+  gainQ12 = ModulationGain(&setpoint, busGain, &clipped);
+  for (i = 0; i < frames; i++)
+  {
+    /* Exact angle (i + 1) * periods / frames of a turn, no accumulated error */
+    uint32_t angle = (uint32_t)(((uint64_t)(((i + 1) * periods) % frames) << 32) / frames);
+
+    RenderFrame(angle, gainQ12, period, &sync->compares[i * PWM_PHASE_COUNT]);
+  }
+
+  sync->busGain = busGain;
+  sync->period = period;
+  sync->clipped = clipped;
+  sync->frames = (uint16_t)frames;
+  sync->periods = (uint16_t)periods;
+  __DMB();
+  sync->valid = 1;
+}
+
+/**
+ * @brief Amplitude gain of a setpoint: load boost and bus feed-forward
+ * @note The nominal index leaves headroom for a sag down to
+ *       BUS_MODULATION_MIN_DV; past it the gain is held at a full index
+ *       (a clean sine, short of the V/f voltage) and the tick is counted
+ * @param setpoint Frequency terms
+ * @param busGain DC bus compensation, Q12
+ * @param clipped Receives 1 if the gain was limited
+ * @retval Gain, Q12 (BUS_COMP_ONE_Q12 spans the whole carrier period)
+ */
+static uint16_t ModulationGain(const FreqSetpoint_t *setpoint, uint16_t busGain, uint8_t *clipped)
+{
+  uint32_t gain = ((uint32_t)setpoint->gainQ12 * busGain) / BUS_COMP_ONE_Q12;
+
+  gain = (gain * BUS_MODULATION_INDEX_Q12) / BUS_COMP_ONE_Q12;
+  *clipped = gain > BUS_COMP_ONE_Q12;
+
+  return *clipped ? BUS_COMP_ONE_Q12 : (uint16_t)gain;
+}
+
+/**
+ * @brief Computes the compare values of the three phases at one angle
+ * @param angle Electrical angle of phase U, 2^32 = one turn
+ * @param gainQ12 Amplitude gain, Q12
+ * @param period Carrier period of the output (compare of a 100% duty)
+ * @param compare Receives the U, V and W compare values
+ * @retval None
+ */
+static void RenderFrame(uint32_t angle, uint16_t gainQ12, uint16_t period, uint16_t *compare)
+{
+  /* Table units to timer counts folded into the gain: one divide per frame */
+  uint16_t scaleQ12 = (uint16_t)(((uint32_t)gainQ12 * period) / PWM_MAX_VALUE);
+
+  /* Sine values for the three phases (120 degrees apart) */
+  compare[0] = ScaleAmplitude(sineTable[angle >> SINE_INDEX_SHIFT], scaleQ12, period);
+  compare[1] = ScaleAmplitude(sineTable[(angle + PHASE_120_DEGREES) >> SINE_INDEX_SHIFT], scaleQ12, period);
+  compare[2] = ScaleAmplitude(sineTable[(angle + PHASE_240_DEGREES) >> SINE_INDEX_SHIFT], scaleQ12, period);
+}
+
+/**
+ * @brief Checks if the bus gain moved too far from the one in the cache
+ * @param busGain Current DC bus compensation, Q12
+ * @param cachedGain Compensation rendered into the cache, Q12
+ * @retval 1 if the cache no longer matches the bus
+ */
+static uint8_t BusGainDrifted(uint16_t busGain, uint16_t cachedGain)
+{
+  uint16_t delta = (busGain > cachedGain) ? busGain - cachedGain : cachedGain - busGain;
+
+  return delta > SYNC_BUS_TOLERANCE;
+}
+
+/**
+ * @brief Greatest common divisor
+ * @retval gcd(a, b)
+ */
+static uint32_t Gcd(uint32_t a, uint32_t b)
+{
+  while (b != 0)
+  {
+    uint32_t rest = a % b;
+
+    a = b;
+    b = rest;
+  }
+  return a;
+}
+
+/**
+ * @brief Plays one control tick of the configured stop mode
+ * @param axis Axis object (running, stop requested)
+ * @param busGain DC bus compensation, Q12
+ * @retval None
+ */
+static void BrakeAxis(FreqControl_t *axis, uint16_t busGain)
+{
+  FreqSetpoint_t setpoint;
+  uint32_t decel = axis->stop.decelMilliHzPerS;
+  uint32_t step;
+
+  if (axis->stopPhase == STOP_PHASE_NONE)
+  {
+    /* First tick after the stop request: latch the mode */
+    axis->stopTicks = 0;
+    axis->brakeTicks = 0;
+    axis->brakeMode = (uint8_t)axis->stop.mode;
+    if (axis->brakeMode == FREQ_STOP_RAMP || axis->brakeMode == FREQ_STOP_RAMP_DC)
+    {
+      axis->rampMilliHz = axis->setpoint.milliHz;
+      if (axis->limitMilliHz != 0 && axis->limitMilliHz < axis->rampMilliHz)
+      {
+        axis->rampMilliHz = axis->limitMilliHz;
+      }
+      axis->limitMilliHz = 0;
+      axis->rampRemainder = 0;
+      axis->stopPhase = STOP_PHASE_RAMP;
+    }
+    else if (axis->brakeMode == FREQ_STOP_DC)
+    {
+      axis->stopPhase = STOP_PHASE_DC;
+    }
+    else
+    {
+      FinishStop(axis);
+      return;
+    }
+  }
+  axis->stopTicks++;
+
+  if (axis->stopPhase == STOP_PHASE_RAMP)
+  {
+    /* Integer part plus accumulated remainder of decel / tick rate */
+    step = decel / PWM_CONTROL_TICK_HZ;
+    axis->rampRemainder += decel % PWM_CONTROL_TICK_HZ;
+    if (axis->rampRemainder >= PWM_CONTROL_TICK_HZ)
+    {
+      axis->rampRemainder -= PWM_CONTROL_TICK_HZ;
+      step++;
+    }
+
+    if (axis->rampMilliHz > FREQ_MIN_MHZ + step)
+    {
+      axis->rampMilliHz -= step;
+      ComputeSetpoint(&setpoint, axis->rampMilliHz);
+      UpdateAxis(axis, &setpoint, busGain);
+      return;
+    }
+
+    /* Bottom of the ramp */
+    if (axis->brakeMode != FREQ_STOP_RAMP_DC)
+    {
+      FinishStop(axis);
+      return;
+    }
+    axis->stopPhase = STOP_PHASE_DC;
+    axis->brakeTicks = 0;
+  }
+
+  /* DC injection */
+  if (axis->brakeTicks >= ((uint32_t)axis->stop.dcTimeMs * PWM_CONTROL_TICK_HZ) / 1000)
+  {
+    FinishStop(axis);
+    return;
+  }
+  axis->brakeTicks++;
+  ApplyDcInjection(axis, busGain);
+}
+
+/**
+ * @brief Applies a stationary voltage vector (U high, V and W low)
+ * @note The compares are taken from the period on the outputs, so the
+ *       injected voltage does not depend on the carrier frequency
+ * @param axis Axis object
+ * @param busGain DC bus compensation, Q12 (keeps the braking current constant)
+ * @retval None
+ */
+static void ApplyDcInjection(FreqControl_t *axis, uint16_t busGain)
+{
+  uint16_t period = PWMControl_GetActiveFrame(&axis->pwm)->period;
+  uint32_t half = ((uint32_t)axis->stop.dcDutyPermille * period * busGain) /
+                  (2000UL * BUS_COMP_ONE_Q12);
+
+  if (half > period / 2)
+  {
+    half = period / 2;
+  }
+  PWMControl_SetOutputs(&axis->pwm, (uint16_t)(period / 2 + half), (uint16_t)(period / 2 - half),
+                        (uint16_t)(period / 2 - half));
+}
+
+/**
+ * @brief Ends a controlled stop: outputs off, stop time recorded
+ * @param axis Axis object
+ * @retval None
+ */
+static void FinishStop(FreqControl_t *axis)
+{
+  axis->lastStopMs = (axis->stopTicks * 1000UL) / PWM_CONTROL_TICK_HZ;
+  axis->stopPhase = STOP_PHASE_NONE;
+  axis->isRunning = 0;
+  PWMControl_Disable(&axis->pwm);
+}
+
+/**
+ * @brief Takes a setpoint posted to the mailbox (control tick context)
+ * @param axis Axis object
+ * @retval None
+ */
+static void TakeMailbox(FreqControl_t *axis)
+{
+  uint32_t sequence = axis->mailbox.sequence;
+
+  if (sequence != axis->appliedSequence)
+  {
+    axis->setpoint = axis->mailbox.slots[axis->mailbox.published];
+    axis->appliedSequence = sequence;
+  }
+}
+
+/**
+ * @brief Commits the scheduled setpoints that are due (control tick context)
+ * @param axis Axis object
+ * @param timebase Aligned tick of this control tick
+ * @retval None
+ */
+static void TakeSchedule(FreqControl_t *axis, uint32_t timebase)
+{
+  FreqSchedule_t* schedule = &axis->schedule;
+
+  while (schedule->tail != schedule->head)
+  {
+    const FreqScheduleEntry_t* entry = &schedule->entries[schedule->tail];
+    int32_t lateness = (int32_t)(timebase - entry->atTick);
+
+    if (lateness < 0)
+    {
+      return;
+    }
+    axis->setpoint = entry->setpoint;
+    schedule->lastLateness = lateness;
+    if (schedule->commits == 0 || lateness > schedule->worstLateness)
+    {
+      schedule->worstLateness = lateness;
+    }
+    schedule->commits++;
+    __DMB();  /* Done with the entry before handing it back */
+    schedule->tail = (schedule->tail + 1) % FREQ_SCHEDULE_SLOTS;
+  }
+}
+
+/**
+ * @brief Computes angle increment and amplitude gain for a frequency
+ * @param setpoint Pointer to store the setpoint
+ * @param freqMilliHz Frequency in mHz
+ * @retval None
+ */
+static void ComputeSetpoint(FreqSetpoint_t *setpoint, uint32_t freqMilliHz)
+{
+  setpoint->milliHz = freqMilliHz;
+
   /* Calculate angle increment per update cycle */
-  /* angle_increment = 2π * frequency * update_period */
-  /* For update_period = 10ms (100Hz), and frequency in Hz */
-  angleIncrement = TWO_PI * targetFrequency * 0.01f;
+  /* phase_step = 2^32 * frequency * update_period */
+  /* update_period = one control tick (1 / PWM_CONTROL_TICK_HZ) */
+  setpoint->phaseStep = (uint32_t)(((uint64_t)freqMilliHz << 32) /
+                                   (1000ULL * PWM_CONTROL_TICK_HZ));
+
+  /* Nominal V/f; the load boost is added by the control tick */
+  setpoint->gainQ12 = BUS_COMP_ONE_Q12;
 }
 
 /**
@@ -181,59 +1163,45 @@ static void GenerateSineTable(void)
   float angle;
   float sinValue;
   uint16_t i;
-  
-  /* Generate sine values for 0 to 359 degrees */
+
+  /* Generate sine values for one turn */
   for (i = 0; i < SINE_TABLE_SIZE; i++)
   {
-    /* Convert degree to radian */
+    /* Convert index to radian */
     angle = i * (TWO_PI / SINE_TABLE_SIZE);
-    
+
     /* Calculate sine value (-1 to +1) */
     sinValue = sinf(angle);
-    
+
     /* Scale to PWM range (0 to PWM_MAX_VALUE) */
     /* First scale to 0-1 range by adding 1 and dividing by 2 */
     sinValue = (sinValue + 1.0f) / 2.0f;
-    
+
     /* Then scale to PWM range */
     sineTable[i] = (uint16_t)(sinValue * PWM_MAX_VALUE);
   }
 }
 
 /**
- * @brief Gets the sine value for a specific angle
- * @param angle Angle in radians
- * @retval PWM value corresponding to the sine of the angle
+ * @brief Scales a sine table value to a compare around the carrier midpoint
+ * @param value Table value (0 to PWM_MAX_VALUE)
+ * @param scaleQ12 Amplitude gain times period / PWM_MAX_VALUE, Q12
+ * @param period Carrier period of the output
+ * @retval Compare value, limited to 0 to period
  */
-static uint16_t GetSineValue(float angle)
+static uint16_t ScaleAmplitude(uint16_t value, uint16_t scaleQ12, uint16_t period)
 {
-  uint16_t index;
-  uint16_t sineVal;
-  float voltageRatio;
-  float boostFactor;
-  
-  /* Convert angle to index in sine table */
-  index = (uint16_t)((angle * 180.0f / PI)) % SINE_TABLE_SIZE;
-  
-  /* Get base sine value */
-  sineVal = sineTable[index];
-  
-  /* Apply voltage boost at low frequencies (V/f control) */
-  if (targetFrequency < 10.0f && voltageBoost > 0)
+  int32_t centered = (int32_t)value - (PWM_MAX_VALUE / 2);
+
+  centered = (centered * scaleQ12) / BUS_COMP_ONE_Q12 + (period / 2);
+  if (centered < 0)
   {
-    /* Calculate voltage boost ratio */
-    voltageRatio = targetFrequency / 10.0f;  /* 0-1 for 0-10Hz */
-    
-    /* Apply boost factor based on frequency */
-    boostFactor = 1.0f + (voltageBoost / 100.0f) * (1.0f - voltageRatio);
-    
-    /* Apply boost but don't exceed PWM_MAX_VALUE */
-    sineVal = (uint16_t)(sineVal * boostFactor);
-    if (sineVal > PWM_MAX_VALUE)
-    {
-      sineVal = PWM_MAX_VALUE;
-    }
+    centered = 0;
   }
-  
-  return sineVal;
+  if (centered > period)
+  {
+    centered = period;
+  }
+
+  return (uint16_t)centered;
 }
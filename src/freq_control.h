@@ -11,20 +11,206 @@ extern "C" {
 #endif
 
 /* Includes */
+#include "pwm_control.h"
 #include <stdint.h>
 
 /* Defines */
 #define FREQ_MIN  0.1f   /* Minimum frequency in Hz */
 #define FREQ_MAX  50.0f  /* Maximum frequency in Hz */
+#define FREQ_MIN_MHZ  100UL    /* Minimum frequency in mHz */
+#define FREQ_MAX_MHZ  50000UL  /* Maximum frequency in mHz */
+
+/* Quadrature encoder on TIM3 for the speed loop (build_flags); TIM3 then
+   no longer drives a second axis */
+#ifndef SPEED_ENCODER_ENABLE
+#define SPEED_ENCODER_ENABLE  0
+#endif
+
+/* Three-phase outputs: axis 1 on TIM1, axis 2 on TIM3 (override with build_flags) */
+#ifndef FREQ_AXIS_COUNT
+#if SPEED_ENCODER_ENABLE
+#define FREQ_AXIS_COUNT    1
+#else
+#define FREQ_AXIS_COUNT    2
+#endif
+#endif
+#if SPEED_ENCODER_ENABLE && FREQ_AXIS_COUNT > 1
+#error "TIM3 is either the encoder input or the second axis (FREQ_AXIS_COUNT=1)"
+#endif
+#define FREQ_AXIS_DEFAULT  1   /* Axis of Modbus, profiles and commands without an axis */
+
+/* Stop modes */
+#define FREQ_DECEL_MIN_MHZ_S    100UL       /* 0.1 Hz/s */
+#define FREQ_DECEL_MAX_MHZ_S    1000000UL   /* 1000 Hz/s */
+#define FREQ_DC_DUTY_MAX        200         /* DC injection duty limit, permille */
+#define FREQ_DC_TIME_MAX_MS     10000
+
+/* Synchronous PWM: compare triplets cached for the output with a replay DMA */
+#ifndef FREQ_SYNC_CACHE_FRAMES
+#define FREQ_SYNC_CACHE_FRAMES  200   /* Control ticks; 5 Hz and up have a whole period */
+#endif
+
+/* Scheduled setpoints: commits queued per axis for a given timebase tick */
+#ifndef FREQ_SCHEDULE_DEPTH
+#define FREQ_SCHEDULE_DEPTH     4
+#endif
+#define FREQ_SCHEDULE_SLOTS     (FREQ_SCHEDULE_DEPTH + 1)  /* One stays free: full != empty */
+
+/* Fault codes */
+#define FREQ_FAULT_NONE  0
+
+/* Types */
+typedef enum {
+  FREQ_STOP_COAST = 0,    /* Outputs off at once, the load coasts */
+  FREQ_STOP_RAMP,         /* Decelerate to FREQ_MIN_MHZ, then outputs off */
+  FREQ_STOP_DC,           /* DC injection braking, then outputs off */
+  FREQ_STOP_RAMP_DC       /* Decelerate, then DC hold */
+} FreqStopMode_t;
+
+/**
+ * @brief Stop configuration (written by the main loop, read by the control tick)
+ */
+typedef struct {
+  volatile FreqStopMode_t mode;
+  volatile uint32_t decelMilliHzPerS;   /* Ramp-down rate */
+  volatile uint16_t dcDutyPermille;     /* DC voltage, permille of the bus */
+  volatile uint16_t dcTimeMs;           /* DC injection duration */
+} FreqStopConfig_t;
+
+/**
+ * @brief Frequency setpoint with the modulator terms derived from it
+ */
+typedef struct {
+  uint32_t milliHz;
+  uint32_t phaseStep;         /* Angle advance per control tick */
+  uint16_t gainQ12;           /* Amplitude gain before load and bus compensation, Q12 */
+} FreqSetpoint_t;
+
+/**
+ * @brief Single-writer mailbox from command context to the control tick
+ * @note The writer fills the slot that is not published, then publishes it
+ *       and bumps the sequence; the control tick (which preempts the writer
+ *       and is never preempted by it) copies the published slot when the
+ *       sequence changed. No slot is ever written while it can be read.
+ */
+typedef struct {
+  FreqSetpoint_t slots[2];
+  volatile uint8_t published;   /* Slot the control tick may read */
+  volatile uint32_t sequence;   /* Number of posts */
+} FreqMailbox_t;
+
+/**
+ * @brief Setpoint to commit at a timebase tick
+ */
+typedef struct {
+  FreqSetpoint_t setpoint;
+  uint32_t atTick;                    /* Aligned timebase tick of the commit */
+} FreqScheduleEntry_t;
+
+/**
+ * @brief Single-writer queue of scheduled setpoints (main loop to control tick)
+ * @note Entries are queued in tick order, so the control tick only checks
+ *       the oldest one; lateness is the commit tick minus the requested tick
+ */
+typedef struct {
+  FreqScheduleEntry_t entries[FREQ_SCHEDULE_SLOTS];
+  volatile uint8_t head;              /* Main loop: next free entry */
+  volatile uint8_t tail;              /* Control tick: oldest pending entry */
+  uint32_t lastTick;                  /* Main loop: tick of the newest entry */
+  volatile uint32_t commits;
+  volatile int32_t lastLateness;      /* Ticks, > 0 = committed late */
+  volatile int32_t worstLateness;
+} FreqSchedule_t;
+
+/**
+ * @brief Synchronous PWM cache: a whole number of electrical periods of
+ *        compare triplets, replayed by DMA while the setpoint holds
+ * @note Rendered by the main loop while the cache is not being replayed;
+ *       valid is set last and cleared first, the control tick only starts
+ *       a replay from a valid cache
+ */
+typedef struct {
+  uint16_t* compares;                 /* CCR1..CCR3 triplets, NULL without DMA */
+  volatile uint8_t enabled;           /* Main loop: SYNC ON */
+  volatile uint8_t valid;             /* Cache matches milliHz, busGain and period */
+  volatile uint32_t milliHz;          /* Frequency the cache was rendered for */
+  volatile uint16_t busGain;          /* Bus compensation frozen in the cache, Q12 */
+  volatile uint16_t period;           /* Carrier period the compares were scaled to */
+  volatile uint8_t clipped;           /* Amplitude limited in the cache */
+  volatile uint16_t frames;           /* Triplets in the cache (0 = no fit) */
+  volatile uint16_t periods;          /* Electrical periods in the cache */
+  uint32_t lastMilliHz;               /* Main loop: setpoint seen at the last pass */
+  volatile uint32_t replayedTicks;    /* Control tick: ticks served by the DMA */
+} FreqSync_t;
+
+/**
+ * @brief One modulator (V/f sine generator) and the PWM output it drives
+ */
+typedef struct {
+  PWMControl_t pwm;
+  volatile FreqSetpoint_t setpoint;   /* Applied; owned by the control tick */
+  FreqMailbox_t mailbox;              /* Posted by the main loop */
+  volatile uint32_t appliedSequence;  /* Last mailbox post taken by the tick */
+  uint32_t phase;                     /* Electrical angle of phase U, 2^32 = one turn */
+  FreqStopConfig_t stop;
+  volatile uint8_t runCommand;        /* Main loop: 1 = run, 0 = stop requested */
+  volatile uint8_t stopPhase;         /* Control tick: braking phase */
+  uint32_t stopTicks;                 /* Control tick: ticks since the stop request */
+  uint32_t brakeTicks;                /* Control tick: ticks of DC injection */
+  uint8_t brakeMode;                  /* Control tick: mode latched at the stop request */
+  uint32_t rampMilliHz;               /* Control tick: decelerating frequency */
+  uint32_t rampRemainder;
+  volatile uint32_t lastStopMs;       /* Duration of the last stop */
+  FreqSync_t sync;
+  FreqSchedule_t schedule;
+  volatile uint32_t limitMilliHz;     /* Control tick: output frequency cap (0 = none) */
+  volatile int32_t compSlipMilliHz;   /* Control tick: slip compensation */
+  volatile int32_t compSlipStep;      /* Control tick: the same as an angle step */
+  volatile uint16_t compBoostQ12;     /* Control tick: IR compensation, Q12 */
+  volatile uint32_t clippedTicks;     /* Control tick: ticks with the amplitude limited */
+  volatile uint16_t faultCode;
+  volatile uint8_t isRunning;         /* Outputs enabled (also while braking) */
+  uint8_t number;                     /* 1..FREQ_AXIS_COUNT */
+} FreqControl_t;
 
 /* Public functions */
 void FreqControl_Init(void);
-uint8_t FreqControl_SetFrequency(float freqHz);
-float FreqControl_GetFrequency(void);
-uint8_t FreqControl_Start(void);
-uint8_t FreqControl_Stop(void);
-uint8_t FreqControl_IsRunning(void);
+FreqControl_t* FreqControl_InitAxis(uint8_t number, TIM_HandleTypeDef *htim);
+FreqControl_t* FreqControl_GetAxis(uint8_t number);
+uint8_t FreqControl_SetFrequency(FreqControl_t *axis, float freqHz);
+float FreqControl_GetFrequency(const FreqControl_t *axis);
+float FreqControl_GetOutputFrequency(const FreqControl_t *axis);
+uint8_t FreqControl_SetFrequencyMilliHz(FreqControl_t *axis, uint32_t freqMilliHz);
+uint8_t FreqControl_ApplyFrequencyMilliHz(FreqControl_t *axis, uint32_t freqMilliHz);
+uint32_t FreqControl_GetFrequencyMilliHz(const FreqControl_t *axis);
+uint32_t FreqControl_GetOutputFrequencyMilliHz(const FreqControl_t *axis);
+uint8_t FreqControl_Start(FreqControl_t *axis);
+uint8_t FreqControl_Stop(FreqControl_t *axis);
+uint8_t FreqControl_IsRunning(const FreqControl_t *axis);
+uint8_t FreqControl_IsStopping(const FreqControl_t *axis);
+uint8_t FreqControl_SetStopMode(FreqControl_t *axis, FreqStopMode_t mode);
+uint8_t FreqControl_SetDecelRate(FreqControl_t *axis, uint32_t milliHzPerS);
+uint8_t FreqControl_SetDcBrake(FreqControl_t *axis, uint16_t dutyPermille, uint16_t timeMs);
+const FreqStopConfig_t* FreqControl_GetStopConfig(const FreqControl_t *axis);
+uint32_t FreqControl_GetLastStopTimeMs(const FreqControl_t *axis);
+uint32_t FreqControl_GetClippedTicks(const FreqControl_t *axis);
+uint8_t FreqControl_SetSync(FreqControl_t *axis, uint8_t enable);
+const FreqSync_t* FreqControl_GetSync(const FreqControl_t *axis);
+uint8_t FreqControl_IsSyncActive(const FreqControl_t *axis);
+uint32_t FreqControl_GetTick(void);
+uint32_t FreqControl_GetTimebase(void);
+int32_t FreqControl_AlignTimebase(uint32_t timebase, uint32_t rxTick);
+int32_t FreqControl_GetLastAlignment(void);
+uint8_t FreqControl_ScheduleFrequencyMilliHz(FreqControl_t *axis, uint32_t freqMilliHz, uint32_t atTick);
+uint8_t FreqControl_CanSchedule(const FreqControl_t *axis, uint32_t atTick);
+const FreqSchedule_t* FreqControl_GetSchedule(const FreqControl_t *axis);
+uint8_t FreqControl_GetScheduledCount(const FreqControl_t *axis);
+void FreqControl_SetCompensation(FreqControl_t *axis, int32_t slipMilliHz, uint16_t boostQ12);
+void FreqControl_SetFrequencyLimit(FreqControl_t *axis, uint32_t limitMilliHz);
 void FreqControl_Update(void);
+void FreqControl_Process(void);
+uint16_t FreqControl_GetFaultCode(const FreqControl_t *axis);
+void FreqControl_ClearFault(FreqControl_t *axis);
 
 #ifdef __cplusplus
 }
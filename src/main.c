@@ -12,6 +12,12 @@
 #include "serial_comm.h"
 #include "pwm_control.h"
 #include "freq_control.h"
+#include "adc_sense.h"
+#include "sequencer.h"
+#include "speed_control.h"
+#include "power_meter.h"
+#include "motor_comp.h"
+#include "ride_through.h"
 
 #include <stdint.h>
 
@@ -20,10 +26,25 @@ static void SystemClock_Config(void);
 static void GPIO_Init(void);
 static void UART2_Init(void);
 static void TIM1_PWM_Init(void);
+#if FREQ_AXIS_COUNT > 1
+static void TIM3_PWM_Init(void);
+#endif
+#if SPEED_ENCODER_ENABLE
+static void TIM3_Encoder_Init(void);
+#endif
+static void TIM16_Gap_Init(void);
+static void ADC1_Init(void);
 
 // Variáveis globais para os periféricos
 UART_HandleTypeDef huart2;
+DMA_HandleTypeDef hdma_usart2_rx;
+DMA_HandleTypeDef hdma_usart2_tx;
 TIM_HandleTypeDef htim1;
+DMA_HandleTypeDef hdma_tim1_ch1;
+TIM_HandleTypeDef htim3;
+TIM_HandleTypeDef htim16;
+ADC_HandleTypeDef hadc;
+DMA_HandleTypeDef hdma_adc;
 
 // Enum para os estados do sistema
 typedef enum {
@@ -95,39 +116,67 @@ int main(void)
   /* MCU Configuration */
   HAL_Init();
   SystemClock_Config();
+
+  /* The HAL time base only serves the main loop: lowest priority */
+  HAL_NVIC_SetPriority(SysTick_IRQn, IRQ_PRIORITY_TICK, 0);
   
   /* Initialize all configured peripherals */
   GPIO_Init();
   UART2_Init();
   TIM1_PWM_Init();
+#if FREQ_AXIS_COUNT > 1
+  TIM3_PWM_Init();
+#endif
+#if SPEED_ENCODER_ENABLE
+  TIM3_Encoder_Init();
+#endif
+  TIM16_Gap_Init();
+  ADC1_Init();
   
   /* Initialize modules */
-  SerialComm_Init(&huart2);
-  PWMControl_Init(&htim1);
+  SerialComm_Init(&huart2, &htim16);
+  AdcSense_Init(&hadc);
   FreqControl_Init();
+  FreqControl_InitAxis(1, &htim1);
+  PowerMeter_Init(FreqControl_GetAxis(1));
+  MotorComp_Init(FreqControl_GetAxis(1));
+  RideThrough_Init(FreqControl_GetAxis(1));
+#if FREQ_AXIS_COUNT > 1
+  FreqControl_InitAxis(2, &htim3);
+#endif
+
+  Sequencer_Init();
+#if SPEED_ENCODER_ENABLE
+  SpeedControl_Init(&htim3, FreqControl_GetAxis(FREQ_AXIS_DEFAULT));
+#else
+  SpeedControl_Init(NULL, FreqControl_GetAxis(FREQ_AXIS_DEFAULT));
+#endif
+
+  /* Control timebase: TIM1 update interrupt (modulation and sequencer) */
+  __HAL_TIM_CLEAR_FLAG(&htim1, TIM_FLAG_UPDATE);
+  __HAL_TIM_ENABLE_IT(&htim1, TIM_IT_UPDATE);
 
   sistemaEstado = SISTEMA_TESTE;
   uint32_t initTick = HAL_GetTick();
-  float testFreq = 1.0f;
-  uint8_t testUp = 1;
+
+  // Teste: varre frequência de 1 a 10 Hz e volta (5 Hz/s), tocado pelo sequenciador
+  FreqControl_SetFrequencyMilliHz(FreqControl_GetAxis(FREQ_AXIS_DEFAULT), 1000);
+  Sequencer_AddSegment(10000, 1800, 0);
+  Sequencer_AddSegment(1000, 1800, 0);
+  Sequencer_SetLoopCount(0);
+  Sequencer_Start();
+  FreqControl_Start(FreqControl_GetAxis(FREQ_AXIS_DEFAULT));
 
   /* Infinite loop */
   while (1)
   {
     if (sistemaEstado == SISTEMA_TESTE) {
-        // Teste: varre frequência de 1 a 10 Hz e volta
-        if (testUp) {
-            testFreq += 0.05f;
-            if (testFreq >= 10.0f) testUp = 0;
-        } else {
-            testFreq -= 0.05f;
-            if (testFreq <= 1.0f) testUp = 1;
-        }
-        FreqControl_SetFrequency(testFreq);
-        if (FreqControl_IsRunning() == 0) FreqControl_Start();
         // Se receber comando serial, sai do teste
         if (SerialComm_HasReceivedCommand()) {
-            FreqControl_Stop();
+            Sequencer_Stop();
+            Sequencer_Clear();
+            Sequencer_SetLoopCount(1);
+            FreqControl_Stop(FreqControl_GetAxis(FREQ_AXIS_DEFAULT));
             sistemaEstado = SISTEMA_PRONTO;
         }
     } else {
@@ -137,7 +186,7 @@ int main(void)
         }
         /* Atualiza estado conforme funcionamento do inversor */
         if (sistemaEstado != SISTEMA_INICIALIZANDO) {
-            if (FreqControl_IsRunning()) {
+            if (FreqControl_IsRunning(FreqControl_GetAxis(FREQ_AXIS_DEFAULT))) {
                 sistemaEstado = SISTEMA_RODANDO;
             } else {
                 sistemaEstado = SISTEMA_PRONTO;
@@ -148,7 +197,8 @@ int main(void)
     AtualizaLedStatus();
     AtualizaLedMCU();
     SerialComm_Process();
-    FreqControl_Update();
+    FreqControl_Process();
+    PowerMeter_Process();
     HAL_Delay(10);
   }
 }
@@ -219,6 +269,7 @@ static void UART2_Init(void)
   /* Enable GPIO clock */
   __HAL_RCC_GPIOA_CLK_ENABLE();
   __HAL_RCC_USART2_CLK_ENABLE();
+  __HAL_RCC_DMA1_CLK_ENABLE();
   
   /* Configure USART2 pins (PA2=TX, PA3=RX) */
   GPIO_InitStruct.Pin = GPIO_PIN_2 | GPIO_PIN_3;
@@ -241,6 +292,191 @@ static void UART2_Init(void)
   {
     Error_Handler();
   }
+
+  /* USART2_RX on DMA1 channel 5: circular, used by the Modbus RTU mode */
+  hdma_usart2_rx.Instance = DMA1_Channel5;
+  hdma_usart2_rx.Init.Direction = DMA_PERIPH_TO_MEMORY;
+  hdma_usart2_rx.Init.PeriphInc = DMA_PINC_DISABLE;
+  hdma_usart2_rx.Init.MemInc = DMA_MINC_ENABLE;
+  hdma_usart2_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+  hdma_usart2_rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+  hdma_usart2_rx.Init.Mode = DMA_CIRCULAR;
+  hdma_usart2_rx.Init.Priority = DMA_PRIORITY_MEDIUM;
+  if (HAL_DMA_Init(&hdma_usart2_rx) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  __HAL_LINKDMA(&huart2, hdmarx, hdma_usart2_rx);
+
+  /* USART2_TX on DMA1 channel 4: Modbus responses */
+  hdma_usart2_tx.Instance = DMA1_Channel4;
+  hdma_usart2_tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+  hdma_usart2_tx.Init.PeriphInc = DMA_PINC_DISABLE;
+  hdma_usart2_tx.Init.MemInc = DMA_MINC_ENABLE;
+  hdma_usart2_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+  hdma_usart2_tx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+  hdma_usart2_tx.Init.Mode = DMA_NORMAL;
+  hdma_usart2_tx.Init.Priority = DMA_PRIORITY_LOW;
+  if (HAL_DMA_Init(&hdma_usart2_tx) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  __HAL_LINKDMA(&huart2, hdmatx, hdma_usart2_tx);
+
+  HAL_NVIC_SetPriority(DMA1_Channel4_5_IRQn, IRQ_PRIORITY_COMM, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel4_5_IRQn);
+  HAL_NVIC_SetPriority(USART2_IRQn, IRQ_PRIORITY_COMM, 0);
+  HAL_NVIC_EnableIRQ(USART2_IRQn);
+}
+
+/**
+ * @brief ADC Initialization (phase currents and DC bus voltage, triggered by TIM1 TRGO)
+ * @retval None
+ */
+static void ADC1_Init(void)
+{
+  ADC_ChannelConfTypeDef sConfig = {0};
+  GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+  __HAL_RCC_GPIOA_CLK_ENABLE();
+  __HAL_RCC_GPIOC_CLK_ENABLE();
+  __HAL_RCC_ADC1_CLK_ENABLE();
+  __HAL_RCC_DMA1_CLK_ENABLE();
+
+  /* Configure bus voltage divider input: PA1 (ADC_IN1) */
+  GPIO_InitStruct.Pin = GPIO_PIN_1;
+  GPIO_InitStruct.Mode = GPIO_MODE_ANALOG;
+  GPIO_InitStruct.Pull = GPIO_NOPULL;
+  HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
+
+  /* Configure phase current amplifier inputs: PC0 (ADC_IN10, U), PC1
+     (ADC_IN11, V) and PC2 (ADC_IN12, W) */
+#if ADC_SENSE_CURRENT_PHASES > 2
+  GPIO_InitStruct.Pin = GPIO_PIN_0 | GPIO_PIN_1 | GPIO_PIN_2;
+#else
+  GPIO_InitStruct.Pin = GPIO_PIN_0 | GPIO_PIN_1;
+#endif
+  HAL_GPIO_Init(GPIOC, &GPIO_InitStruct);
+
+  /* ADC: synchronous clock (fixed trigger latency), one sequence per TRGO,
+     highest channel first so the currents come before the bus voltage; the
+     clock and sampling time match ADC_SENSE_SAMPLE/CONVERSION_TICKS */
+  hadc.Instance = ADC1;
+  hadc.Init.ClockPrescaler = ADC_CLOCK_SYNC_PCLK_DIV2;
+  hadc.Init.Resolution = ADC_RESOLUTION_12B;
+  hadc.Init.DataAlign = ADC_DATAALIGN_RIGHT;
+  hadc.Init.ScanConvMode = ADC_SCAN_DIRECTION_BACKWARD;
+  hadc.Init.EOCSelection = ADC_EOC_SEQ_CONV;
+  hadc.Init.LowPowerAutoWait = DISABLE;
+  hadc.Init.LowPowerAutoPowerOff = DISABLE;
+  hadc.Init.ContinuousConvMode = DISABLE;
+  hadc.Init.DiscontinuousConvMode = DISABLE;
+  hadc.Init.ExternalTrigConv = ADC_EXTERNALTRIGCONV_T1_TRGO;
+  hadc.Init.ExternalTrigConvEdge = ADC_EXTERNALTRIGCONVEDGE_RISING;
+  hadc.Init.DMAContinuousRequests = ENABLE;
+  hadc.Init.Overrun = ADC_OVR_DATA_OVERWRITTEN;
+  hadc.Init.SamplingTimeCommon = ADC_SAMPLETIME_13CYCLES_5;
+  if (HAL_ADC_Init(&hadc) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
+  sConfig.Channel = ADC_CHANNEL_1;
+  sConfig.Rank = ADC_RANK_CHANNEL_NUMBER;
+  sConfig.SamplingTime = ADC_SAMPLETIME_13CYCLES_5;
+  if (HAL_ADC_ConfigChannel(&hadc, &sConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sConfig.Channel = ADC_CHANNEL_10;
+  if (HAL_ADC_ConfigChannel(&hadc, &sConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  sConfig.Channel = ADC_CHANNEL_11;
+  if (HAL_ADC_ConfigChannel(&hadc, &sConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+#if ADC_SENSE_CURRENT_PHASES > 2
+  sConfig.Channel = ADC_CHANNEL_12;
+  if (HAL_ADC_ConfigChannel(&hadc, &sConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+#endif
+
+  /* ADC on DMA1 channel 1: circular, one entry per converted channel */
+  hdma_adc.Instance = DMA1_Channel1;
+  hdma_adc.Init.Direction = DMA_PERIPH_TO_MEMORY;
+  hdma_adc.Init.PeriphInc = DMA_PINC_DISABLE;
+  hdma_adc.Init.MemInc = DMA_MINC_ENABLE;
+  hdma_adc.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+  hdma_adc.Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+  hdma_adc.Init.Mode = DMA_CIRCULAR;
+  hdma_adc.Init.Priority = DMA_PRIORITY_HIGH;
+  if (HAL_DMA_Init(&hdma_adc) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  __HAL_LINKDMA(&hadc, DMA_Handle, hdma_adc);
+
+  HAL_NVIC_SetPriority(DMA1_Channel1_IRQn, IRQ_PRIORITY_SENSE, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel1_IRQn);
+}
+
+/**
+ * @brief TIM16 Initialization (Modbus RTU inter-frame gap timer)
+ * @note One-pulse, 1 us resolution; the period is loaded by serial_comm.c
+ * @retval None
+ */
+static void TIM16_Gap_Init(void)
+{
+  __HAL_RCC_TIM16_CLK_ENABLE();
+
+  htim16.Instance = TIM16;
+  htim16.Init.Prescaler = (HAL_RCC_GetPCLK1Freq() / 1000000) - 1;  // 1 MHz
+  htim16.Init.CounterMode = TIM_COUNTERMODE_UP;
+  htim16.Init.Period = 0xFFFF;
+  htim16.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+  htim16.Init.RepetitionCounter = 0;
+  htim16.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+  if (HAL_TIM_Base_Init(&htim16) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
+  /* Stop at the update event; the prescaler load (UG) must not raise UIF */
+  htim16.Instance->CR1 |= TIM_CR1_OPM | TIM_CR1_URS;
+  __HAL_TIM_CLEAR_FLAG(&htim16, TIM_FLAG_UPDATE);
+
+  HAL_NVIC_SetPriority(TIM16_IRQn, IRQ_PRIORITY_COMM, 0);
+  HAL_NVIC_EnableIRQ(TIM16_IRQn);
+}
+
+/**
+ * @brief Timer update callback (dispatches to the owning module)
+ * @param htim Pointer to the timer handle
+ * @retval None
+ */
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
+{
+  if (htim->Instance == TIM1)
+  {
+    /* Control tick: the meter latches the frame now on the outputs, then
+       the sequencer or the speed loop sets the frequency this tick modulates,
+       capped by the ride-through, plus the load compensation */
+    PowerMeter_Tick();
+    Sequencer_Tick();
+    SpeedControl_Tick();
+    RideThrough_Tick();
+    MotorComp_Tick();
+    FreqControl_Update();
+  }
+  else if (htim->Instance == TIM16)
+  {
+    SerialComm_GapTimerElapsed();
+  }
 }
 
 /**
@@ -258,6 +494,7 @@ static void TIM1_PWM_Init(void)
   
   /* Enable GPIO clock */
   __HAL_RCC_GPIOA_CLK_ENABLE();
+  __HAL_RCC_GPIOB_CLK_ENABLE();
   
   /* Configure Timer1 pins: PA8(TIM1_CH1), PA9(TIM1_CH2), PA10(TIM1_CH3) */
   GPIO_InitStruct.Pin = GPIO_PIN_8 | GPIO_PIN_9 | GPIO_PIN_10;
@@ -266,6 +503,10 @@ static void TIM1_PWM_Init(void)
   GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
   GPIO_InitStruct.Alternate = GPIO_AF2_TIM1;
   HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
+
+  /* Complementary pins: PB13(TIM1_CH1N), PB14(TIM1_CH2N), PB15(TIM1_CH3N) */
+  GPIO_InitStruct.Pin = GPIO_PIN_13 | GPIO_PIN_14 | GPIO_PIN_15;
+  HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
   
   /* Enable TIM1 clock */
   __HAL_RCC_TIM1_CLK_ENABLE();
@@ -283,8 +524,8 @@ static void TIM1_PWM_Init(void)
     Error_Handler();
   }
 
-  /* Master configuration */
-  sMasterConfig.MasterOutputTrigger = TIM_TRGO_RESET;
+  /* Master configuration: TRGO = OC4REF, triggers the ADC at the carrier peak */
+  sMasterConfig.MasterOutputTrigger = TIM_TRGO_OC4REF;
   sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
   if (HAL_TIMEx_MasterConfigSynchronization(&htim1, &sMasterConfig) != HAL_OK)
   {
@@ -294,11 +535,11 @@ static void TIM1_PWM_Init(void)
   /* PWM configuration for phase U */
   sConfigOC.OCMode = TIM_OCMODE_PWM1;
   sConfigOC.Pulse = 0;
-  sConfigOC.OCPolarity = TIM_OCPOLARITY_HIGH;
-  sConfigOC.OCNPolarity = TIM_OCNPOLARITY_HIGH;
+  sConfigOC.OCPolarity = PWM_OC_POLARITY;
+  sConfigOC.OCNPolarity = PWM_OCN_POLARITY;
   sConfigOC.OCFastMode = TIM_OCFAST_DISABLE;
-  sConfigOC.OCIdleState = TIM_OCIDLESTATE_RESET;
-  sConfigOC.OCNIdleState = TIM_OCNIDLESTATE_RESET;
+  sConfigOC.OCIdleState = PWM_OC_IDLE_STATE;
+  sConfigOC.OCNIdleState = PWM_OCN_IDLE_STATE;
   if (HAL_TIM_PWM_ConfigChannel(&htim1, &sConfigOC, TIM_CHANNEL_1) != HAL_OK)
   {
     Error_Handler();
@@ -315,11 +556,21 @@ static void TIM1_PWM_Init(void)
   {
     Error_Handler();
   }
-  /* Configure dead time */
-  sBreakDeadTimeConfig.OffStateRunMode = TIM_OSSR_DISABLE;
-  sBreakDeadTimeConfig.OffStateIDLEMode = TIM_OSSI_DISABLE;
+
+  /* Channel 4 (no pin): OC4REF high around the carrier peak -> ADC trigger */
+  sConfigOC.OCMode = TIM_OCMODE_PWM2;
+  sConfigOC.Pulse = htim1.Init.Period - PWM_ADC_TRIGGER_LEAD;
+  if (HAL_TIM_PWM_ConfigChannel(&htim1, &sConfigOC, TIM_CHANNEL_4) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  /* Configure dead time (inserted between CHx and CHxN by the timer) */
+  /* Off-state selection: disabled outputs are driven to their inactive/idle
+     level instead of floating, so the gate drivers always see "off" */
+  sBreakDeadTimeConfig.OffStateRunMode = TIM_OSSR_ENABLE;
+  sBreakDeadTimeConfig.OffStateIDLEMode = TIM_OSSI_ENABLE;
   sBreakDeadTimeConfig.LockLevel = TIM_LOCKLEVEL_OFF;
-  sBreakDeadTimeConfig.DeadTime = 100; // Dead time in timer ticks
+  sBreakDeadTimeConfig.DeadTime = PWM_DEAD_TIME_TICKS; // Dead time in timer ticks
   sBreakDeadTimeConfig.BreakState = TIM_BREAK_DISABLE;
   sBreakDeadTimeConfig.BreakPolarity = TIM_BREAKPOLARITY_HIGH;
   sBreakDeadTimeConfig.AutomaticOutput = TIM_AUTOMATICOUTPUT_DISABLE;
@@ -328,11 +579,143 @@ static void TIM1_PWM_Init(void)
     Error_Handler();
   }
 
-  /* Start PWM for all channels */
-  HAL_TIM_PWM_Start(&htim1, TIM_CHANNEL_1);
-  HAL_TIM_PWM_Start(&htim1, TIM_CHANNEL_2);
-  HAL_TIM_PWM_Start(&htim1, TIM_CHANNEL_3);
+  /* TIM1_CH1 request on DMA1 channel 2: synchronous PWM replay of CCR1..CCR3
+     (CCDS moves the request to the update event; channel 5, TIM1_UP, is
+     taken by USART2_RX). Circular, no interrupt. */
+  __HAL_RCC_DMA1_CLK_ENABLE();
+  hdma_tim1_ch1.Instance = DMA1_Channel2;
+  hdma_tim1_ch1.Init.Direction = DMA_MEMORY_TO_PERIPH;
+  hdma_tim1_ch1.Init.PeriphInc = DMA_PINC_DISABLE;
+  hdma_tim1_ch1.Init.MemInc = DMA_MINC_ENABLE;
+  hdma_tim1_ch1.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+  hdma_tim1_ch1.Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+  hdma_tim1_ch1.Init.Mode = DMA_CIRCULAR;
+  hdma_tim1_ch1.Init.Priority = DMA_PRIORITY_HIGH;
+  if (HAL_DMA_Init(&hdma_tim1_ch1) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  __HAL_LINKDMA(&htim1, hdma[TIM_DMA_ID_CC1], hdma_tim1_ch1);
+
+  /* Update interrupt = control timebase, highest priority */
+  HAL_NVIC_SetPriority(TIM1_BRK_UP_TRG_COM_IRQn, IRQ_PRIORITY_CONTROL, 0);
+  HAL_NVIC_EnableIRQ(TIM1_BRK_UP_TRG_COM_IRQn);
+
+  /* Start the counter only; the outputs are enabled by PWMControl_Enable() */
+  __HAL_TIM_ENABLE(&htim1);
+}
+
+#if FREQ_AXIS_COUNT > 1
+/**
+ * @brief TIM3 PWM Initialization (second axis, high-side outputs only)
+ * @retval None
+ */
+static void TIM3_PWM_Init(void)
+{
+  TIM_OC_InitTypeDef sConfigOC = {0};
+  GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+  __HAL_RCC_GPIOB_CLK_ENABLE();
+
+  /* Configure Timer3 pins: PB4(TIM3_CH1), PB5(TIM3_CH2), PB0(TIM3_CH3) */
+  GPIO_InitStruct.Pin = GPIO_PIN_4 | GPIO_PIN_5 | GPIO_PIN_0;
+  GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+  GPIO_InitStruct.Pull = GPIO_NOPULL;
+  GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
+  GPIO_InitStruct.Alternate = GPIO_AF1_TIM3;
+  HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
+
+  /* Enable TIM3 clock */
+  __HAL_RCC_TIM3_CLK_ENABLE();
+
+  /* Timer base configuration (period set by PWMControl, same carrier as TIM1) */
+  htim3.Instance = TIM3;
+  htim3.Init.Prescaler = 0;
+  htim3.Init.CounterMode = TIM_COUNTERMODE_CENTERALIGNED1;
+  htim3.Init.Period = 1000;
+  htim3.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+  htim3.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE;
+  if (HAL_TIM_PWM_Init(&htim3) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
+  /* PWM configuration for phases U, V, W; no complementary outputs and no
+     dead time on TIM3, the gate drivers must insert it */
+  sConfigOC.OCMode = TIM_OCMODE_PWM1;
+  sConfigOC.Pulse = 0;
+  sConfigOC.OCPolarity = PWM_OC_POLARITY;
+  sConfigOC.OCFastMode = TIM_OCFAST_DISABLE;
+  if (HAL_TIM_PWM_ConfigChannel(&htim3, &sConfigOC, TIM_CHANNEL_1) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  if (HAL_TIM_PWM_ConfigChannel(&htim3, &sConfigOC, TIM_CHANNEL_2) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  if (HAL_TIM_PWM_ConfigChannel(&htim3, &sConfigOC, TIM_CHANNEL_3) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
+  /* Start the counter only; the outputs are enabled by PWMControl_Enable() */
+  __HAL_TIM_ENABLE(&htim3);
+}
+#endif
+
+#if SPEED_ENCODER_ENABLE
+/**
+ * @brief TIM3 Encoder Initialization (speed loop feedback, replaces axis 2)
+ * @retval None
+ */
+static void TIM3_Encoder_Init(void)
+{
+  TIM_Encoder_InitTypeDef sConfig = {0};
+  GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+  __HAL_RCC_GPIOB_CLK_ENABLE();
+
+  /* Encoder A/B on PB4(TIM3_CH1) and PB5(TIM3_CH2), pulled up for open
+     collector encoders */
+  GPIO_InitStruct.Pin = GPIO_PIN_4 | GPIO_PIN_5;
+  GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+  GPIO_InitStruct.Pull = GPIO_PULLUP;
+  GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+  GPIO_InitStruct.Alternate = GPIO_AF1_TIM3;
+  HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
+
+  /* Enable TIM3 clock */
+  __HAL_RCC_TIM3_CLK_ENABLE();
+
+  /* Free-running 16-bit position counter, both edges of both channels (x4) */
+  htim3.Instance = TIM3;
+  htim3.Init.Prescaler = 0;
+  htim3.Init.CounterMode = TIM_COUNTERMODE_UP;
+  htim3.Init.Period = 0xFFFF;
+  htim3.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+  htim3.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+  sConfig.EncoderMode = TIM_ENCODERMODE_TI12;
+  sConfig.IC1Polarity = TIM_ICPOLARITY_RISING;
+  sConfig.IC1Selection = TIM_ICSELECTION_DIRECTTI;
+  sConfig.IC1Prescaler = TIM_ICPSC_DIV1;
+  sConfig.IC1Filter = 0x6;   /* Rejects glitches shorter than ~1 us */
+  sConfig.IC2Polarity = TIM_ICPOLARITY_RISING;
+  sConfig.IC2Selection = TIM_ICSELECTION_DIRECTTI;
+  sConfig.IC2Prescaler = TIM_ICPSC_DIV1;
+  sConfig.IC2Filter = 0x6;
+  if (HAL_TIM_Encoder_Init(&htim3, &sConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
+  /* Read by the control tick, no interrupt */
+  if (HAL_TIM_Encoder_Start(&htim3, TIM_CHANNEL_ALL) != HAL_OK)
+  {
+    Error_Handler();
+  }
 }
+#endif
 
 /**
  * @brief  This function is executed in case of error occurrence.
@@ -13,6 +13,15 @@ extern "C" {
 /* Includes */
 #include "stm32f0xx_hal.h"
 
+/* Interrupt priorities (Cortex-M0: 2 bits, 0 = highest)
+   Each level may preempt the ones below it and is never preempted by them:
+   data crossing levels goes through single-writer buffers, not critical
+   sections, so the control tick latency does not depend on lower levels */
+#define IRQ_PRIORITY_CONTROL  0   /* TIM1 update: modulation, sequencer, setpoint mailboxes */
+#define IRQ_PRIORITY_SENSE    1   /* ADC DMA: bus voltage filter, power meter sums, faults */
+#define IRQ_PRIORITY_COMM     2   /* USART2, its DMA channels and the TIM16 gap timer */
+#define IRQ_PRIORITY_TICK     3   /* SysTick (HAL_GetTick/HAL_Delay of the main loop) */
+
 /* Exported functions prototypes */
 void Error_Handler(void);
 
@@ -0,0 +1,487 @@
+/**
+ * @file modbus_rtu.c
+ * @brief Implementação do escravo Modbus RTU (funções 03, 06 e 16)
+ *
+ * This module only knows about frames: it validates address and CRC, executes
+ * the request against the register map and builds the response. Framing
+ * (inter-frame gap) and the UART live in serial_comm.c, so this file builds
+ * unchanged on the host.
+ *
+ * 32-bit values span two registers, high word first. Writing the high word
+ * only latches it; writing the low word acts on the whole value, so one
+ * "write multiple" of both is one operation. A broadcast write of the
+ * timebase aligns every drive on the bus at once, and the scheduled commit
+ * registers queue a frequency change for a timebase tick.
+ */
+
+#include "modbus_rtu.h"
+#include "freq_control.h"
+#include "sequencer.h"
+#include "speed_control.h"
+
+/* Private defines */
+#define MODBUS_MIN_ADU_SIZE       4       /* Address + function + CRC */
+#define MODBUS_MAX_READ_REGS      125
+#define MODBUS_MAX_WRITE_REGS     123
+#define MHZ_PER_UNIT              10      /* Frequency registers in 0.01 Hz */
+
+/* Private variables */
+static uint8_t slaveAddress = MODBUS_DEFAULT_ADDRESS;
+static uint8_t exitRequested = 0;
+static uint32_t frameCount = 0;
+static uint32_t errorCount = 0;
+static uint32_t frameTick = 0;          /* Reception tick of the frame being executed */
+static uint16_t timebaseHigh = 0;       /* Latched high words */
+static uint16_t schedTickHigh = 0;
+static uint16_t checkTickHigh = 0;      /* High word seen by the validate pass */
+static uint16_t schedFreq = 0;
+static uint32_t timebaseRead = 0;       /* Timebase sampled with its high word */
+
+/* CRC-16/MODBUS (polynomial 0xA001 reflected), one entry per byte value */
+static const uint16_t crcTable[256] = {
+  0x0000, 0xC0C1, 0xC181, 0x0140, 0xC301, 0x03C0, 0x0280, 0xC241,
+  0xC601, 0x06C0, 0x0780, 0xC741, 0x0500, 0xC5C1, 0xC481, 0x0440,
+  0xCC01, 0x0CC0, 0x0D80, 0xCD41, 0x0F00, 0xCFC1, 0xCE81, 0x0E40,
+  0x0A00, 0xCAC1, 0xCB81, 0x0B40, 0xC901, 0x09C0, 0x0880, 0xC841,
+  0xD801, 0x18C0, 0x1980, 0xD941, 0x1B00, 0xDBC1, 0xDA81, 0x1A40,
+  0x1E00, 0xDEC1, 0xDF81, 0x1F40, 0xDD01, 0x1DC0, 0x1C80, 0xDC41,
+  0x1400, 0xD4C1, 0xD581, 0x1540, 0xD701, 0x17C0, 0x1680, 0xD641,
+  0xD201, 0x12C0, 0x1380, 0xD341, 0x1100, 0xD1C1, 0xD081, 0x1040,
+  0xF001, 0x30C0, 0x3180, 0xF141, 0x3300, 0xF3C1, 0xF281, 0x3240,
+  0x3600, 0xF6C1, 0xF781, 0x3740, 0xF501, 0x35C0, 0x3480, 0xF441,
+  0x3C00, 0xFCC1, 0xFD81, 0x3D40, 0xFF01, 0x3FC0, 0x3E80, 0xFE41,
+  0xFA01, 0x3AC0, 0x3B80, 0xFB41, 0x3900, 0xF9C1, 0xF881, 0x3840,
+  0x2800, 0xE8C1, 0xE981, 0x2940, 0xEB01, 0x2BC0, 0x2A80, 0xEA41,
+  0xEE01, 0x2EC0, 0x2F80, 0xEF41, 0x2D00, 0xEDC1, 0xEC81, 0x2C40,
+  0xE401, 0x24C0, 0x2580, 0xE541, 0x2700, 0xE7C1, 0xE681, 0x2640,
+  0x2200, 0xE2C1, 0xE381, 0x2340, 0xE101, 0x21C0, 0x2080, 0xE041,
+  0xA001, 0x60C0, 0x6180, 0xA141, 0x6300, 0xA3C1, 0xA281, 0x6240,
+  0x6600, 0xA6C1, 0xA781, 0x6740, 0xA501, 0x65C0, 0x6480, 0xA441,
+  0x6C00, 0xACC1, 0xAD81, 0x6D40, 0xAF01, 0x6FC0, 0x6E80, 0xAE41,
+  0xAA01, 0x6AC0, 0x6B80, 0xAB41, 0x6900, 0xA9C1, 0xA881, 0x6840,
+  0x7800, 0xB8C1, 0xB981, 0x7940, 0xBB01, 0x7BC0, 0x7A80, 0xBA41,
+  0xBE01, 0x7EC0, 0x7F80, 0xBF41, 0x7D00, 0xBDC1, 0xBC81, 0x7C40,
+  0xB401, 0x74C0, 0x7580, 0xB541, 0x7700, 0xB7C1, 0xB681, 0x7640,
+  0x7200, 0xB2C1, 0xB381, 0x7340, 0xB101, 0x71C0, 0x7080, 0xB041,
+  0x5000, 0x90C1, 0x9181, 0x5140, 0x9301, 0x53C0, 0x5280, 0x9241,
+  0x9601, 0x56C0, 0x5780, 0x9741, 0x5500, 0x95C1, 0x9481, 0x5440,
+  0x9C01, 0x5CC0, 0x5D80, 0x9D41, 0x5F00, 0x9FC1, 0x9E81, 0x5E40,
+  0x5A00, 0x9AC1, 0x9B81, 0x5B40, 0x9901, 0x59C0, 0x5880, 0x9841,
+  0x8801, 0x48C0, 0x4980, 0x8941, 0x4B00, 0x8BC1, 0x8A81, 0x4A40,
+  0x4E00, 0x8EC1, 0x8F81, 0x4F40, 0x8D01, 0x4DC0, 0x4C80, 0x8C41,
+  0x4400, 0x84C1, 0x8581, 0x4540, 0x8701, 0x47C0, 0x4680, 0x8641,
+  0x8201, 0x42C0, 0x4380, 0x8341, 0x4100, 0x81C1, 0x8081, 0x4040
+};
+
+/* Private function prototypes */
+static uint8_t ReadRegister(uint16_t address, uint16_t* value);
+static uint8_t WriteRegister(uint16_t address, uint16_t value, uint8_t apply);
+static uint16_t BuildException(uint8_t* response, uint8_t function, uint8_t code);
+static uint16_t AppendCRC(uint8_t* frame, uint16_t length);
+
+/**
+ * @brief Initializes the Modbus RTU slave
+ * @param address Slave address (1-247)
+ * @retval None
+ */
+void ModbusRTU_Init(uint8_t address)
+{
+  if (ModbusRTU_SetAddress(address) != 0)
+  {
+    slaveAddress = MODBUS_DEFAULT_ADDRESS;
+  }
+  exitRequested = 0;
+  frameCount = 0;
+  errorCount = 0;
+}
+
+/**
+ * @brief Sets the slave address
+ * @param address Slave address (1-247)
+ * @retval 0=success, 1=error (invalid address)
+ */
+uint8_t ModbusRTU_SetAddress(uint8_t address)
+{
+  if (address == MODBUS_BROADCAST_ADDRESS || address > MODBUS_MAX_ADDRESS)
+  {
+    return 1;
+  }
+
+  slaveAddress = address;
+  return 0;
+}
+
+/**
+ * @brief Gets the slave address
+ * @retval Slave address
+ */
+uint8_t ModbusRTU_GetAddress(void)
+{
+  return slaveAddress;
+}
+
+/**
+ * @brief Computes the Modbus CRC-16 of a buffer
+ * @param data Pointer to data
+ * @param length Number of bytes
+ * @retval CRC (low byte is transmitted first)
+ */
+uint16_t ModbusRTU_CRC16(const uint8_t* data, uint16_t length)
+{
+  uint16_t crc = 0xFFFF;
+
+  while (length--)
+  {
+    crc = (crc >> 8) ^ crcTable[(crc ^ *data++) & 0xFF];
+  }
+
+  return crc;
+}
+
+/**
+ * @brief Executes one received frame
+ * @param request Received ADU (address, PDU and CRC)
+ * @param length Number of bytes in the ADU
+ * @param response Buffer for the response ADU (MODBUS_MAX_ADU_SIZE bytes)
+ * @param rxTick FreqControl_GetTick() at the end of the frame
+ * @retval Response length in bytes, 0 if nothing must be sent
+ */
+uint16_t ModbusRTU_HandleFrame(const uint8_t* request, uint16_t length, uint8_t* response,
+                               uint32_t rxTick)
+{
+  uint8_t address;
+  uint8_t function;
+  uint16_t start, count, i;
+  uint16_t value = 0;
+  uint16_t respLen = 2;
+  uint8_t ex = 0;
+
+  if (length < MODBUS_MIN_ADU_SIZE || length > MODBUS_MAX_ADU_SIZE)
+  {
+    errorCount++;
+    return 0;
+  }
+
+  /* Frames with a bad CRC are silently discarded */
+  if (ModbusRTU_CRC16(request, length - 2) !=
+      (uint16_t)(request[length - 2] | (request[length - 1] << 8)))
+  {
+    errorCount++;
+    return 0;
+  }
+
+  address = request[0];
+  if (address != slaveAddress && address != MODBUS_BROADCAST_ADDRESS)
+  {
+    return 0; /* Frame for another slave */
+  }
+
+  frameCount++;
+  frameTick = rxTick;
+  function = request[1];
+  start = (uint16_t)((request[2] << 8) | request[3]);
+  response[0] = slaveAddress;
+  response[1] = function;
+
+  switch (function)
+  {
+    case MODBUS_FC_READ_HOLDING:
+      if (length != 8)
+      {
+        ex = MODBUS_EX_ILLEGAL_VALUE;
+        break;
+      }
+      count = (uint16_t)((request[4] << 8) | request[5]);
+      if (count == 0 || count > MODBUS_MAX_READ_REGS)
+      {
+        ex = MODBUS_EX_ILLEGAL_VALUE;
+        break;
+      }
+      if ((uint32_t)start + count > MODBUS_REG_COUNT)
+      {
+        ex = MODBUS_EX_ILLEGAL_ADDRESS;
+        break;
+      }
+      response[2] = (uint8_t)(count * 2);
+      respLen = 3;
+      for (i = 0; i < count; i++)
+      {
+        ReadRegister(start + i, &value);
+        response[respLen++] = (uint8_t)(value >> 8);
+        response[respLen++] = (uint8_t)value;
+      }
+      break;
+
+    case MODBUS_FC_WRITE_SINGLE:
+      if (length != 8)
+      {
+        ex = MODBUS_EX_ILLEGAL_VALUE;
+        break;
+      }
+      value = (uint16_t)((request[4] << 8) | request[5]);
+      checkTickHigh = schedTickHigh;
+      ex = WriteRegister(start, value, 0);
+      if (ex == 0)
+      {
+        ex = WriteRegister(start, value, 1);
+      }
+      /* Echo of the request */
+      for (respLen = 2; respLen < 6; respLen++)
+      {
+        response[respLen] = request[respLen];
+      }
+      break;
+
+    case MODBUS_FC_WRITE_MULTIPLE:
+      count = (uint16_t)((request[4] << 8) | request[5]);
+      if (count == 0 || count > MODBUS_MAX_WRITE_REGS ||
+          request[6] != count * 2 || length != 9 + count * 2)
+      {
+        ex = MODBUS_EX_ILLEGAL_VALUE;
+        break;
+      }
+      if ((uint32_t)start + count > MODBUS_REG_COUNT)
+      {
+        ex = MODBUS_EX_ILLEGAL_ADDRESS;
+        break;
+      }
+      /* Validate every register before applying any of them */
+      checkTickHigh = schedTickHigh;
+      for (i = 0; i < count && ex == 0; i++)
+      {
+        value = (uint16_t)((request[7 + i * 2] << 8) | request[8 + i * 2]);
+        ex = WriteRegister(start + i, value, 0);
+      }
+      for (i = 0; i < count && ex == 0; i++)
+      {
+        value = (uint16_t)((request[7 + i * 2] << 8) | request[8 + i * 2]);
+        ex = WriteRegister(start + i, value, 1);
+      }
+      for (respLen = 2; respLen < 6; respLen++)
+      {
+        response[respLen] = request[respLen];
+      }
+      break;
+
+    default:
+      ex = MODBUS_EX_ILLEGAL_FUNCTION;
+      break;
+  }
+
+  /* Broadcast requests are executed but never answered */
+  if (address == MODBUS_BROADCAST_ADDRESS)
+  {
+    return 0;
+  }
+
+  if (ex != 0)
+  {
+    return BuildException(response, function, ex);
+  }
+
+  return AppendCRC(response, respLen);
+}
+
+/**
+ * @brief Checks (and clears) a pending request to leave Modbus mode
+ * @retval 1 if the master wrote 0 to MODBUS_REG_PROTOCOL
+ */
+uint8_t ModbusRTU_TakeExitRequest(void)
+{
+  uint8_t pending = exitRequested;
+  exitRequested = 0;
+  return pending;
+}
+
+/**
+ * @brief Gets the number of frames addressed to this slave
+ * @retval Frame count
+ */
+uint32_t ModbusRTU_GetFrameCount(void)
+{
+  return frameCount;
+}
+
+/**
+ * @brief Gets the number of discarded frames (bad CRC or length)
+ * @retval Error count
+ */
+uint32_t ModbusRTU_GetErrorCount(void)
+{
+  return errorCount;
+}
+
+/**
+ * @brief Reads one holding register
+ * @param address Register address
+ * @param value Pointer to store the value
+ * @retval 0=success, exception code otherwise
+ */
+static uint8_t ReadRegister(uint16_t address, uint16_t* value)
+{
+  const FreqControl_t* axis = FreqControl_GetAxis(FREQ_AXIS_DEFAULT);
+  uint16_t status = 0;
+
+  switch (address)
+  {
+    case MODBUS_REG_FREQ_SETPOINT:
+      *value = (uint16_t)((FreqControl_GetFrequencyMilliHz(axis) + MHZ_PER_UNIT / 2) / MHZ_PER_UNIT);
+      break;
+    case MODBUS_REG_RUN_COMMAND:
+      *value = FreqControl_IsRunning(axis);
+      break;
+    case MODBUS_REG_STATUS_WORD:
+      if (FreqControl_IsRunning(axis))
+        status |= MODBUS_STATUS_RUNNING;
+      if (FreqControl_IsRunning(axis) &&
+          FreqControl_GetOutputFrequencyMilliHz(axis) == FreqControl_GetFrequencyMilliHz(axis))
+        status |= MODBUS_STATUS_AT_SPEED;
+      if (FreqControl_GetFaultCode(axis) != FREQ_FAULT_NONE)
+        status |= MODBUS_STATUS_FAULT;
+      *value = status;
+      break;
+    case MODBUS_REG_ACTUAL_FREQ:
+      *value = (uint16_t)((FreqControl_GetOutputFrequencyMilliHz(axis) + MHZ_PER_UNIT / 2) / MHZ_PER_UNIT);
+      break;
+    case MODBUS_REG_FAULT_CODE:
+      *value = FreqControl_GetFaultCode(axis);
+      break;
+    case MODBUS_REG_PROTOCOL:
+      *value = 1;
+      break;
+    case MODBUS_REG_TIMEBASE_HI:
+      timebaseRead = FreqControl_GetTimebase();
+      *value = (uint16_t)(timebaseRead >> 16);
+      break;
+    case MODBUS_REG_TIMEBASE_LO:
+      *value = (uint16_t)timebaseRead;
+      break;
+    case MODBUS_REG_SCHED_FREQ:
+      *value = schedFreq;
+      break;
+    case MODBUS_REG_SCHED_TICK_HI:
+      *value = (uint16_t)(FreqControl_GetSchedule(axis)->lastTick >> 16);
+      break;
+    case MODBUS_REG_SCHED_TICK_LO:
+      *value = (uint16_t)FreqControl_GetSchedule(axis)->lastTick;
+      break;
+    case MODBUS_REG_SCHED_LATENESS:
+      *value = (uint16_t)FreqControl_GetSchedule(axis)->lastLateness;
+      break;
+    default:
+      return MODBUS_EX_ILLEGAL_ADDRESS;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Validates or applies a write to one holding register
+ * @param address Register address
+ * @param value Value to write
+ * @param apply 0=only validate, 1=apply
+ * @retval 0=success, exception code otherwise
+ */
+static uint8_t WriteRegister(uint16_t address, uint16_t value, uint8_t apply)
+{
+  FreqControl_t* axis = FreqControl_GetAxis(FREQ_AXIS_DEFAULT);
+  uint32_t freqMilliHz = (uint32_t)value * MHZ_PER_UNIT;
+
+  switch (address)
+  {
+    case MODBUS_REG_FREQ_SETPOINT:
+      if (freqMilliHz < FREQ_MIN_MHZ || freqMilliHz > FREQ_MAX_MHZ)
+        return MODBUS_EX_ILLEGAL_VALUE;
+      if (apply)
+        SpeedControl_Disable();   /* Before the post: the loop tick would overwrite it */
+      if (apply && FreqControl_SetFrequencyMilliHz(axis, freqMilliHz) != 0)
+        return MODBUS_EX_DEVICE_FAILURE;
+      if (apply)
+        Sequencer_Stop();   /* A manual setpoint takes over from a profile */
+      break;
+    case MODBUS_REG_RUN_COMMAND:
+      if (value > 1)
+        return MODBUS_EX_ILLEGAL_VALUE;
+      if (apply && (value ? FreqControl_Start(axis) : FreqControl_Stop(axis)) != 0)
+        return MODBUS_EX_DEVICE_FAILURE;
+      break;
+    case MODBUS_REG_FAULT_CODE:
+      if (value != 0)
+        return MODBUS_EX_ILLEGAL_VALUE;
+      if (apply)
+        FreqControl_ClearFault(axis);
+      break;
+    case MODBUS_REG_PROTOCOL:
+      if (value > 1)
+        return MODBUS_EX_ILLEGAL_VALUE;
+      if (apply && value == 0)
+        exitRequested = 1;
+      break;
+    case MODBUS_REG_TIMEBASE_HI:
+      if (apply)
+        timebaseHigh = value;
+      break;
+    case MODBUS_REG_TIMEBASE_LO:
+      if (apply)
+        FreqControl_AlignTimebase(((uint32_t)timebaseHigh << 16) | value, frameTick);
+      break;
+    case MODBUS_REG_SCHED_FREQ:
+      if (freqMilliHz < FREQ_MIN_MHZ || freqMilliHz > FREQ_MAX_MHZ)
+        return MODBUS_EX_ILLEGAL_VALUE;
+      if (apply)
+        schedFreq = value;
+      break;
+    case MODBUS_REG_SCHED_TICK_HI:
+      checkTickHigh = value;
+      if (apply)
+        schedTickHigh = value;
+      break;
+    case MODBUS_REG_SCHED_TICK_LO:
+      /* Validate pass: the high word of this frame or the latched one; a
+         full queue or an earlier tick rejects the frame before any write */
+      if (!apply && !FreqControl_CanSchedule(axis, ((uint32_t)checkTickHigh << 16) | value))
+        return MODBUS_EX_DEVICE_FAILURE;
+      if (apply && FreqControl_ScheduleFrequencyMilliHz(axis, (uint32_t)schedFreq * MHZ_PER_UNIT,
+                                                        ((uint32_t)schedTickHigh << 16) | value) != 0)
+        return MODBUS_EX_DEVICE_FAILURE;
+      if (apply)
+      {
+        /* Queued: it takes over from the speed loop and a profile */
+        SpeedControl_Disable();
+        Sequencer_Stop();
+      }
+      break;
+    case MODBUS_REG_STATUS_WORD:
+    case MODBUS_REG_ACTUAL_FREQ:
+    case MODBUS_REG_SCHED_LATENESS:
+    default:
+      return MODBUS_EX_ILLEGAL_ADDRESS;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Builds an exception response
+ * @retval Response length in bytes
+ */
+static uint16_t BuildException(uint8_t* response, uint8_t function, uint8_t code)
+{
+  response[0] = slaveAddress;
+  response[1] = function | 0x80;
+  response[2] = code;
+  return AppendCRC(response, 3);
+}
+
+/**
+ * @brief Appends the CRC to a frame
+ * @retval Frame length including the CRC
+ */
+static uint16_t AppendCRC(uint8_t* frame, uint16_t length)
+{
+  uint16_t crc = ModbusRTU_CRC16(frame, length);
+
+  frame[length++] = (uint8_t)(crc & 0xFF);
+  frame[length++] = (uint8_t)(crc >> 8);
+  return length;
+}
@@ -0,0 +1,68 @@
+/**
+ * @file modbus_rtu.h
+ * @brief Escravo Modbus RTU (camada de protocolo e mapa de registradores)
+ */
+
+#ifndef __MODBUS_RTU_H
+#define __MODBUS_RTU_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes */
+#include <stdint.h>
+
+/* Defines */
+#define MODBUS_DEFAULT_ADDRESS    1
+#define MODBUS_BROADCAST_ADDRESS  0
+#define MODBUS_MAX_ADDRESS        247
+#define MODBUS_MAX_ADU_SIZE       256     /* Address + PDU + CRC */
+
+/* Function codes */
+#define MODBUS_FC_READ_HOLDING    0x03
+#define MODBUS_FC_WRITE_SINGLE    0x06
+#define MODBUS_FC_WRITE_MULTIPLE  0x10
+
+/* Exception codes */
+#define MODBUS_EX_ILLEGAL_FUNCTION  0x01
+#define MODBUS_EX_ILLEGAL_ADDRESS   0x02
+#define MODBUS_EX_ILLEGAL_VALUE     0x03
+#define MODBUS_EX_DEVICE_FAILURE    0x04
+
+/* Holding register map */
+#define MODBUS_REG_FREQ_SETPOINT  0x0000  /* RW, 0.01 Hz */
+#define MODBUS_REG_RUN_COMMAND    0x0001  /* RW, 0=stop, 1=run */
+#define MODBUS_REG_STATUS_WORD    0x0002  /* R, MODBUS_STATUS_* bits */
+#define MODBUS_REG_ACTUAL_FREQ    0x0003  /* R, 0.01 Hz */
+#define MODBUS_REG_FAULT_CODE     0x0004  /* RW, write 0 to clear */
+#define MODBUS_REG_PROTOCOL       0x0005  /* RW, write 0 to return to ASCII */
+#define MODBUS_REG_TIMEBASE_HI    0x0006  /* RW, timebase tick, high word */
+#define MODBUS_REG_TIMEBASE_LO    0x0007  /* RW, low word; writing it aligns the timebase */
+#define MODBUS_REG_SCHED_FREQ     0x0008  /* RW, 0.01 Hz, frequency of the next scheduled commit */
+#define MODBUS_REG_SCHED_TICK_HI  0x0009  /* RW, commit tick, high word */
+#define MODBUS_REG_SCHED_TICK_LO  0x000A  /* RW, low word; writing it queues the commit */
+#define MODBUS_REG_SCHED_LATENESS 0x000B  /* R, ticks of the last commit (signed) */
+#define MODBUS_REG_COUNT          12
+
+/* Status word bits */
+#define MODBUS_STATUS_RUNNING     0x0001
+#define MODBUS_STATUS_AT_SPEED    0x0002
+#define MODBUS_STATUS_FAULT       0x0080
+
+/* Public functions */
+void ModbusRTU_Init(uint8_t address);
+uint8_t ModbusRTU_SetAddress(uint8_t address);
+uint8_t ModbusRTU_GetAddress(void);
+uint16_t ModbusRTU_CRC16(const uint8_t* data, uint16_t length);
+uint16_t ModbusRTU_HandleFrame(const uint8_t* request, uint16_t length, uint8_t* response,
+                               uint32_t rxTick);
+uint8_t ModbusRTU_TakeExitRequest(void);
+uint32_t ModbusRTU_GetFrameCount(void);
+uint32_t ModbusRTU_GetErrorCount(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MODBUS_RTU_H */
@@ -0,0 +1,193 @@
+/**
+ * @file motor_comp.c
+ * @brief Implementação da compensação de carga (boost IR e escorregamento)
+ *
+ * Both terms follow the active component of the phase current measured by
+ * the power meter, so an idle motor gets the nominal V/f and a loaded one
+ * gets what its load needs:
+ *
+ * - IR boost: the stator resistance drops Rs * Ia of the phase voltage. At
+ *   gain 1.0 the sine modulator applies BUS_MODULATION_MIN_DV / (2 * sqrt(2))
+ *   RMS per phase (the nominal index times the nominal bus; the bus
+ *   feed-forward covers the rest), so the gain is raised by
+ *   Rs * Ia * 2 * sqrt(2) / BUS_MODULATION_MIN_DV. The modulation headroom
+ *   holds the whole boost at the nominal bus. Only a motoring current boosts.
+ * - Slip compensation: the rotor lags the field by a slip proportional to
+ *   the torque, about the rated slip at the rated active current. Adding
+ *   it to the output frequency holds the speed under load; regenerating, it
+ *   lowers the frequency instead. Left to the PI while the speed loop runs.
+ *
+ * The control tick runs it every MOTOR_COMP_DIVIDER ticks, right after the
+ * power meter closes an active current window: a first-order filter and two
+ * multiplies by coefficients the main loop derives from the motor data. A
+ * window without a usable current sample leaves both terms as they were.
+ */
+
+#include "motor_comp.h"
+#include "speed_control.h"
+
+/* Private defines */
+#define COEFF_FRAC      16      /* Fractional bits of the per-mA coefficients */
+#define SQRT8_Q16       185364  /* 2 * sqrt(2), Q16 */
+
+#if (BUS_COMP_ONE_Q12 + MOTOR_COMP_BOOST_MAX) * BUS_MODULATION_INDEX_Q12 > \
+    BUS_COMP_ONE_Q12 * BUS_COMP_ONE_Q12
+#error "MOTOR_COMP_BOOST_MAX exceeds the modulation headroom at the nominal bus"
+#endif
+
+/* Private variables */
+static FreqControl_t* compAxis = NULL;
+static MotorComp_t motor;
+
+/* Set by the main loop, read by the control tick (one word each) */
+static volatile uint32_t boostPerMilliA;    /* Q12 gain per mA, Q16 */
+static volatile uint32_t slipPerMilliA;     /* mHz per mA, Q16 */
+
+/* Control tick only */
+static uint8_t compTicks;
+static int32_t filterState;                 /* activeMilliA << MOTOR_COMP_FILTER_SHIFT */
+
+/* Private function prototypes */
+static void ComputeCoefficients(void);
+static void Release(void);
+
+/**
+ * @brief Initializes the compensation with the build defaults
+ * @param axis Axis whose shunts the power meter samples
+ * @retval None
+ */
+void MotorComp_Init(FreqControl_t *axis)
+{
+  motor.rsMilliOhm = MOTOR_RS_MOHM;
+  motor.slipMilliHz = MOTOR_SLIP_MHZ;
+  motor.ratedMilliA = MOTOR_RATED_MA;
+  motor.activeMilliA = 0;
+  motor.boostQ12 = 0;
+  motor.compSlipMilliHz = 0;
+  ComputeCoefficients();
+
+  compTicks = 0;
+  filterState = 0;
+  compAxis = axis;
+}
+
+/**
+ * @brief Sets the motor data
+ * @param rsMilliOhm Stator resistance per phase, mOhm (0 = no IR boost)
+ * @param slipMilliHz Slip at rated current, mHz (0 = no slip compensation)
+ * @param ratedMilliA Rated current, mA
+ * @retval 0=success, 1=error (out of range)
+ */
+uint8_t MotorComp_SetParameters(uint32_t rsMilliOhm, uint32_t slipMilliHz, uint32_t ratedMilliA)
+{
+  if (rsMilliOhm > MOTOR_RS_MAX_MOHM || slipMilliHz > MOTOR_SLIP_MAX_MHZ ||
+      ratedMilliA < MOTOR_RATED_MIN_MA || ratedMilliA > MOTOR_RATED_MAX_MA)
+  {
+    return 1;
+  }
+  motor.rsMilliOhm = rsMilliOhm;
+  motor.slipMilliHz = slipMilliHz;
+  motor.ratedMilliA = ratedMilliA;
+  ComputeCoefficients();
+  return 0;
+}
+
+/**
+ * @brief Gets the motor data and the applied compensation
+ * @retval Pointer to the state
+ */
+const MotorComp_t* MotorComp_GetState(void)
+{
+  return &motor;
+}
+
+/**
+ * @brief Updates the IR boost and the slip compensation of the axis
+ * @note Called once per control tick from the TIM1 update interrupt, before
+ *       FreqControl_Update(); works every MOTOR_COMP_DIVIDER ticks
+ * @retval None
+ */
+void MotorComp_Tick(void)
+{
+  int32_t active, slip, slipLimit;
+  uint32_t boost;
+
+  if (compAxis == NULL || ++compTicks < MOTOR_COMP_DIVIDER)
+  {
+    return;
+  }
+  compTicks = 0;
+
+  if (!FreqControl_IsRunning(compAxis) || FreqControl_IsStopping(compAxis))
+  {
+    Release();
+    return;
+  }
+
+  /* No current measured in this window: the terms hold */
+  if (!PowerMeter_IsActiveCurrentValid())
+  {
+    return;
+  }
+
+  filterState += PowerMeter_GetActiveCurrentMilliA() - (filterState >> MOTOR_COMP_FILTER_SHIFT);
+  active = filterState >> MOTOR_COMP_FILTER_SHIFT;
+
+  /* IR boost: motoring current only */
+  boost = 0;
+  if (active > 0)
+  {
+    boost = (uint32_t)(((uint64_t)active * boostPerMilliA) >> COEFF_FRAC);
+    if (boost > MOTOR_COMP_BOOST_MAX)
+    {
+      boost = MOTOR_COMP_BOOST_MAX;
+    }
+  }
+
+  /* Slip: proportional to the active current, up to twice the rated slip */
+  slip = 0;
+  if (!SpeedControl_GetState()->enabled)
+  {
+    slipLimit = 2 * (int32_t)motor.slipMilliHz;
+    slip = (int32_t)(((int64_t)active * slipPerMilliA) / (1L << COEFF_FRAC));
+    if (slip > slipLimit)
+    {
+      slip = slipLimit;
+    }
+    else if (slip < -slipLimit)
+    {
+      slip = -slipLimit;
+    }
+  }
+
+  motor.activeMilliA = active;
+  motor.boostQ12 = (uint16_t)boost;
+  motor.compSlipMilliHz = slip;
+  FreqControl_SetCompensation(compAxis, slip, (uint16_t)boost);
+}
+
+/**
+ * @brief Derives the per-mA coefficients from the motor data
+ * @note Called from the main loop
+ * @retval None
+ */
+static void ComputeCoefficients(void)
+{
+  /* Boost, Q12 = Rs[mOhm] * Ia[mA] * 1e-6 * 2 * sqrt(2) * 4096 / (Vmin[0.1 V] / 10) */
+  boostPerMilliA = (uint32_t)(((uint64_t)motor.rsMilliOhm * SQRT8_Q16 * BUS_COMP_ONE_Q12) /
+                              (100000ULL * BUS_MODULATION_MIN_DV));
+  slipPerMilliA = (uint32_t)(((uint64_t)motor.slipMilliHz << COEFF_FRAC) / motor.ratedMilliA);
+}
+
+/**
+ * @brief Clears the compensation (axis stopped or braking)
+ * @retval None
+ */
+static void Release(void)
+{
+  filterState = 0;
+  motor.activeMilliA = 0;
+  motor.boostQ12 = 0;
+  motor.compSlipMilliHz = 0;
+  FreqControl_SetCompensation(compAxis, 0, 0);
+}
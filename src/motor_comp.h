@@ -0,0 +1,61 @@
+/**
+ * @file motor_comp.h
+ * @brief Compensação automática de carga (boost IR e escorregamento)
+ */
+
+#ifndef __MOTOR_COMP_H
+#define __MOTOR_COMP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes */
+#include "freq_control.h"
+#include "adc_sense.h"
+#include "power_meter.h"
+#include <stdint.h>
+
+/* Defines */
+/* Motor data (override with build_flags, or MOTOR over serial) */
+#ifndef MOTOR_RS_MOHM
+#define MOTOR_RS_MOHM           2000    /* Stator resistance per phase (star), mOhm */
+#endif
+#ifndef MOTOR_SLIP_MHZ
+#define MOTOR_SLIP_MHZ          2000    /* Slip at rated current, mHz */
+#endif
+#ifndef MOTOR_RATED_MA
+#define MOTOR_RATED_MA          4000    /* Rated current (RMS), mA */
+#endif
+#define MOTOR_COMP_DIVIDER      POWER_METER_ACTIVE_TICKS  /* Control ticks per update */
+#define MOTOR_COMP_FILTER_SHIFT 3       /* IIR weight 1/8 per update (~30 ms) */
+#define MOTOR_COMP_BOOST_MAX    (BUS_COMP_ONE_Q12 / 4)    /* IR boost limit, Q12 (+25%) */
+#define MOTOR_RS_MAX_MOHM       50000   /* Parameter limits */
+#define MOTOR_SLIP_MAX_MHZ      5000
+#define MOTOR_RATED_MIN_MA      100
+#define MOTOR_RATED_MAX_MA      (2L * PHASE_CURRENT_FULL_SCALE_MA)
+
+/* Types */
+/**
+ * @brief Motor data (set by the main loop) and compensation (control tick)
+ */
+typedef struct {
+  uint32_t rsMilliOhm;                /* 0 = no IR boost */
+  uint32_t slipMilliHz;               /* 0 = no slip compensation */
+  uint32_t ratedMilliA;
+  volatile int32_t activeMilliA;      /* Filtered active current */
+  volatile uint16_t boostQ12;         /* Applied IR boost, Q12 */
+  volatile int32_t compSlipMilliHz;   /* Applied slip compensation */
+} MotorComp_t;
+
+/* Public functions */
+void MotorComp_Init(FreqControl_t *axis);
+uint8_t MotorComp_SetParameters(uint32_t rsMilliOhm, uint32_t slipMilliHz, uint32_t ratedMilliA);
+const MotorComp_t* MotorComp_GetState(void);
+void MotorComp_Tick(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MOTOR_COMP_H */
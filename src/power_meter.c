@@ -0,0 +1,460 @@
+/**
+ * @file power_meter.c
+ * @brief Implementação da medição de corrente, potência e energia
+ *
+ * Every ADC sequence (one per carrier period) adds to running sums, in the
+ * ADC interrupt: the square of each phase current and, for the active power,
+ * each current times the centered duty of its phase (the phase voltage over
+ * Vbus, with the common mode removed since the currents add up to zero).
+ * Only multiplies and adds per sample. The duty is the one on the outputs,
+ * latched by the control tick.
+ *
+ * A low-side shunt only carries its phase current while that low side
+ * conducts. A phase whose compare is within SHUNT_BLANKING_TICKS of the
+ * period still has its low side off (dead time included) when the
+ * conversions start, so it reads 0 A: with three shunts that phase is
+ * rebuilt from the other two (the currents add up to zero); with fewer
+ * conducting shunts than that the sample is skipped, left out of every sum.
+ *
+ * The control tick marks each electrical cycle (wrap of the phase U angle);
+ * the next sample closes the window into a small queue, and the main loop
+ * turns it into RMS currents, power and energy: a few divides and one
+ * square root per phase, once per cycle.
+ *
+ * The active current, for the load compensation, cannot wait for a whole
+ * cycle at low frequency. A short window of POWER_METER_ACTIVE_TICKS also
+ * sums the squares of the centered duties: over the three phases,
+ * sum(d * i) = 3/2 * D * I * cos(phi) and sum(d^2) = 3/2 * D^2 at any
+ * angle, so the RMS active current is sum(d * i) / sqrt(3 * n * sum(d^2))
+ * over n samples, without the bus voltage and without waiting for the
+ * cycle. The ADC interrupt closes it: one 32-bit divide and one square root,
+ * 250 times a second.
+ */
+
+#include "power_meter.h"
+#include "adc_sense.h"
+#include <string.h>
+
+/* Private defines */
+#define OFFSET_FRAC     4       /* Fractional bits of the zero-current offsets */
+#define OFFSET_SHIFT    6       /* IIR weight 1/64 per sample while the outputs are off */
+#define RMS_FRAC        3       /* Fractional bits of the RMS before scaling */
+#define ACTIVE_FRAC     3       /* Fractional bits of the active current before scaling */
+#define SHUNT_BLANKING_TICKS  (PWM_ADC_TRIGGER_LEAD + PWM_DEAD_TIME_TICKS)  /* Low side off at the sample */
+
+/* Private types */
+typedef struct {
+  uint16_t compare[PWM_PHASE_COUNT];
+  uint16_t period;
+} OutputLatch_t;
+
+typedef struct {
+  uint64_t squares[PWM_PHASE_COUNT];    /* Sum of current^2, counts^2 */
+  int64_t power;                        /* Sum of centered compare * current */
+  uint32_t samples;
+  uint32_t skipped;                     /* Sequences without enough conducting shunts */
+  uint32_t ticks;                       /* Control ticks spanned */
+  uint16_t period;                      /* Carrier period (duty = compare / period) */
+} MeterWindow_t;
+
+/* Private variables */
+static FreqControl_t* meterAxis = NULL;
+static PowerReading_t reading;
+
+/* Control tick only (latches read by the ADC interrupt) */
+static OutputLatch_t latches[2];
+static volatile uint8_t latchIndex;
+static volatile uint32_t cycleMark;
+static uint32_t lastPhase;
+
+/* ADC interrupt only */
+static int32_t offsets[PWM_PHASE_COUNT];  /* Zero-current counts << OFFSET_FRAC */
+static MeterWindow_t window;
+static uint32_t seenMark;
+static uint32_t windowStart;
+static volatile uint32_t droppedWindows;
+static int64_t activePower;             /* Sum of centered compare * current */
+static uint32_t activeSquares;          /* Sum of centered compare^2 */
+static uint32_t activeSamples;
+static uint32_t activeStart;
+static volatile int32_t activeMilliA;
+static volatile uint8_t activeValid;    /* Last window had usable samples */
+
+/* Closed windows: written by the ADC interrupt, drained by the main loop */
+static MeterWindow_t closedWindows[POWER_METER_QUEUE_SIZE];
+static volatile uint8_t closedHead = 0;
+static volatile uint8_t closedTail = 0;
+
+/* Main loop only */
+static int32_t energyRemainder;         /* mW * ticks below one mJ */
+
+/* Private function prototypes */
+static void CloseWindow(uint32_t now);
+static void CloseActiveWindow(uint32_t now);
+static void ProcessWindow(const MeterWindow_t* closed);
+static uint32_t SquareRoot(uint32_t value);
+
+/**
+ * @brief Initializes the meter on an axis (the one whose shunts are sampled)
+ * @param axis Axis driven by TIM1
+ * @retval None
+ */
+void PowerMeter_Init(FreqControl_t *axis)
+{
+  uint8_t i;
+
+  for (i = 0; i < PWM_PHASE_COUNT; i++)
+  {
+    offsets[i] = (int32_t)ADC_SENSE_MID_SCALE << OFFSET_FRAC;
+  }
+  memset(&window, 0, sizeof(window));
+  memset(&reading, 0, sizeof(reading));
+  memset(latches, 0, sizeof(latches));
+  latchIndex = 0;
+  cycleMark = 0;
+  seenMark = 0;
+  lastPhase = axis->phase;
+  windowStart = FreqControl_GetTick();
+  activePower = 0;
+  activeSquares = 0;
+  activeSamples = 0;
+  activeStart = windowStart;
+  activeMilliA = 0;
+  activeValid = 0;
+  energyRemainder = 0;
+  droppedWindows = 0;
+  closedHead = 0;
+  closedTail = 0;
+
+  __DMB();
+  meterAxis = axis;
+}
+
+/**
+ * @brief Latches the duty on the outputs and marks electrical cycles
+ * @note Called at the start of the control tick, before the modulator
+ *       commits the next frame
+ * @retval None
+ */
+void PowerMeter_Tick(void)
+{
+  const uint16_t* compare;
+  uint16_t period;
+  uint8_t next, i;
+
+  if (meterAxis == NULL)
+  {
+    return;
+  }
+
+  /* Fill the latch the ADC interrupt is not reading, then switch (the
+     modulator keeps every compare within the period) */
+  compare = PWMControl_GetOutputCompares(&meterAxis->pwm);
+  period = PWMControl_GetActiveFrame(&meterAxis->pwm)->period;
+  next = latchIndex ^ 1;
+  for (i = 0; i < PWM_PHASE_COUNT; i++)
+  {
+    latches[next].compare[i] = compare[i];
+  }
+  latches[next].period = period;
+  latchIndex = next;
+
+  /* Phase U angle wrapped: one electrical cycle */
+  if (meterAxis->phase < lastPhase)
+  {
+    cycleMark++;
+  }
+  lastPhase = meterAxis->phase;
+}
+
+/**
+ * @brief Adds one ADC sequence to the running sums
+ * @note Called from the ADC DMA interrupt, once per carrier period
+ * @param samples ADC sequence (ADC_SENSE_RANK_* positions)
+ * @retval None
+ */
+void PowerMeter_Sample(const volatile uint16_t *samples)
+{
+  const OutputLatch_t* latch;
+  int32_t current[PWM_PHASE_COUNT];
+  int32_t half, power, duty;
+  uint32_t squares, now;
+  uint8_t i, blanked, missing;
+
+  if (meterAxis == NULL)
+  {
+    return;
+  }
+
+  current[0] = (int32_t)samples[ADC_SENSE_RANK_IU] << OFFSET_FRAC;
+  current[1] = (int32_t)samples[ADC_SENSE_RANK_IV] << OFFSET_FRAC;
+#if ADC_SENSE_CURRENT_PHASES > 2
+  current[2] = (int32_t)samples[ADC_SENSE_RANK_IW] << OFFSET_FRAC;
+#else
+  current[2] = offsets[2];
+#endif
+
+  /* Outputs off: no current flows, track the amplifier offsets */
+  if (!meterAxis->pwm.enabled)
+  {
+    for (i = 0; i < PWM_PHASE_COUNT; i++)
+    {
+      offsets[i] += (current[i] - offsets[i]) >> OFFSET_SHIFT;
+    }
+  }
+
+  for (i = 0; i < PWM_PHASE_COUNT; i++)
+  {
+    current[i] = (current[i] - offsets[i]) >> OFFSET_FRAC;
+  }
+
+  /* Sampled shunts whose low side is still off */
+  latch = &latches[latchIndex];
+  blanked = 0;
+  missing = PWM_PHASE_COUNT - 1;    /* W when it has no shunt */
+  for (i = 0; i < ADC_SENSE_CURRENT_PHASES; i++)
+  {
+    if (latch->compare[i] + SHUNT_BLANKING_TICKS > latch->period)
+    {
+      blanked++;
+      missing = i;
+    }
+  }
+
+  if (blanked > ADC_SENSE_CURRENT_PHASES - 2)
+  {
+    /* Fewer than two conducting shunts: nothing to rebuild from */
+    window.skipped++;
+  }
+  else
+  {
+    /* The currents add up to zero: the phase not measured is rebuilt */
+    if (blanked != 0 || ADC_SENSE_CURRENT_PHASES < 3)
+    {
+      current[missing] -= current[0] + current[1] + current[2];
+    }
+
+    half = latch->period >> 1;
+    power = 0;
+    squares = 0;
+    for (i = 0; i < PWM_PHASE_COUNT; i++)
+    {
+      duty = (int32_t)latch->compare[i] - half;
+      window.squares[i] += (uint32_t)(current[i] * current[i]);
+      power += duty * current[i];
+      squares += (uint32_t)(duty * duty);
+    }
+    window.power += power;
+    window.period = latch->period;
+    window.samples++;
+    activePower += power;
+    activeSquares += squares;
+    activeSamples++;
+  }
+
+  now = FreqControl_GetTick();
+  if (now - activeStart >= POWER_METER_ACTIVE_TICKS)
+  {
+    CloseActiveWindow(now);
+  }
+  if (cycleMark != seenMark || now - windowStart >= POWER_METER_MAX_TICKS)
+  {
+    seenMark = cycleMark;
+    CloseWindow(now);
+  }
+}
+
+/**
+ * @brief Turns the closed windows into readings
+ * @note Called from the main loop
+ * @retval None
+ */
+void PowerMeter_Process(void)
+{
+  while (closedTail != closedHead)
+  {
+    __DMB();
+    ProcessWindow(&closedWindows[closedTail & (POWER_METER_QUEUE_SIZE - 1)]);
+    closedTail++;
+  }
+  reading.dropped = droppedWindows;
+}
+
+/**
+ * @brief Gets the readings of the last electrical cycle
+ * @retval Pointer to the readings
+ */
+const PowerReading_t* PowerMeter_GetReading(void)
+{
+  return &reading;
+}
+
+/**
+ * @brief Clears the energy and cycle counters
+ * @note Called from the main loop
+ * @retval None
+ */
+void PowerMeter_ResetEnergy(void)
+{
+  reading.energyMilliJ = 0;
+  reading.cycles = 0;
+  energyRemainder = 0;
+}
+
+/**
+ * @brief Gets the active component of the phase current
+ * @note Updated by the ADC interrupt every POWER_METER_ACTIVE_TICKS
+ * @retval RMS active current per phase, mA (< 0 when regenerating)
+ */
+int32_t PowerMeter_GetActiveCurrentMilliA(void)
+{
+  return activeMilliA;
+}
+
+/**
+ * @brief Checks if the last active current window measured anything
+ * @note Every sample of a window can be skipped (low sides off at the
+ *       conversions); the active current then holds its last value
+ * @retval 1 if the active current is fresh
+ */
+uint8_t PowerMeter_IsActiveCurrentValid(void)
+{
+  return activeValid;
+}
+
+/**
+ * @brief Active current of the short window, then starts a new one
+ * @param now Control tick of the close
+ * @retval None
+ */
+static void CloseActiveWindow(uint32_t now)
+{
+  uint64_t radicand = 3ULL * activeSquares * activeSamples;
+  int64_t power = activePower;
+  uint32_t root;
+  int32_t counts;
+
+  /* Fit the radicand in 32 bits (a fast carrier gives more samples);
+     |power| <= root * full-scale counts, so it then fits as well */
+  while (radicand > 0xFFFFFFFFULL)
+  {
+    radicand >>= 2;
+    power /= 2;
+  }
+  root = SquareRoot((uint32_t)radicand);
+
+  /* Every sample skipped: no measurement, the last value stands */
+  activeValid = activeSamples != 0;
+
+  /* All phases at 50% duty: no voltage applied, no active current */
+  if (root == 0)
+  {
+    if (activeValid)
+    {
+      activeMilliA = 0;
+    }
+  }
+  else
+  {
+    counts = ((int32_t)power * (1 << ACTIVE_FRAC)) / (int32_t)root;
+    activeMilliA = (counts * PHASE_CURRENT_FULL_SCALE_MA) / (ADC_SENSE_MID_SCALE << ACTIVE_FRAC);
+  }
+  activePower = 0;
+  activeSquares = 0;
+  activeSamples = 0;
+  activeStart = now;
+}
+
+/**
+ * @brief Queues the running sums and starts a new window
+ * @param now Control tick of the close
+ * @retval None
+ */
+static void CloseWindow(uint32_t now)
+{
+  window.ticks = now - windowStart;
+  windowStart = now;
+
+  if ((uint8_t)(closedHead - closedTail) < POWER_METER_QUEUE_SIZE)
+  {
+    closedWindows[closedHead & (POWER_METER_QUEUE_SIZE - 1)] = window;
+    __DMB();
+    closedHead++;
+  }
+  else
+  {
+    droppedWindows++;
+  }
+  memset(&window, 0, sizeof(window));
+}
+
+/**
+ * @brief RMS currents, active power and energy of one window
+ * @param closed Closed window
+ * @retval None
+ */
+static void ProcessWindow(const MeterWindow_t* closed)
+{
+  int64_t power, energy;
+  uint32_t meanSquare;
+  uint8_t i;
+
+  if (closed->samples == 0 || closed->period == 0)
+  {
+    return;
+  }
+
+  /* RMS = sqrt(sum / n), with RMS_FRAC extra bits (12-bit counts: fits) */
+  for (i = 0; i < PWM_PHASE_COUNT; i++)
+  {
+    meanSquare = (uint32_t)(closed->squares[i] / closed->samples);
+    reading.currentMilliA[i] = (SquareRoot(meanSquare << (2 * RMS_FRAC)) *
+                                PHASE_CURRENT_FULL_SCALE_MA) /
+                               ((uint32_t)ADC_SENSE_MID_SCALE << RMS_FRAC);
+  }
+
+  /* P = Vbus * mean(sum of duty * current): duty = compare / period */
+  power = (closed->power / (int32_t)closed->samples) * AdcSense_GetBusVoltage() *
+          PHASE_CURRENT_FULL_SCALE_MA;
+  reading.powerMilliW = (int32_t)(power / (10LL * closed->period * ADC_SENSE_MID_SCALE));
+
+  /* E += P * t, the part below one mJ carried to the next window */
+  energy = (int64_t)reading.powerMilliW * closed->ticks + energyRemainder;
+  reading.energyMilliJ += energy / PWM_CONTROL_TICK_HZ;
+  energyRemainder = (int32_t)(energy % PWM_CONTROL_TICK_HZ);
+
+  reading.windowMs = (closed->ticks * 1000UL) / PWM_CONTROL_TICK_HZ;
+  reading.samples = closed->samples;
+  reading.skipped = closed->skipped;
+  reading.cycles++;
+}
+
+/**
+ * @brief Integer square root (bit by bit, no divides)
+ * @param value Radicand
+ * @retval floor(sqrt(value))
+ */
+static uint32_t SquareRoot(uint32_t value)
+{
+  uint32_t root = 0;
+  uint32_t bit = 1UL << 30;
+
+  while (bit > value)
+  {
+    bit >>= 2;
+  }
+  while (bit != 0)
+  {
+    if (value >= root + bit)
+    {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    }
+    else
+    {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return root;
+}
@@ -0,0 +1,55 @@
+/**
+ * @file power_meter.h
+ * @brief Medição de corrente RMS, potência ativa e energia por ciclo elétrico
+ */
+
+#ifndef __POWER_METER_H
+#define __POWER_METER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes */
+#include "freq_control.h"
+#include <stdint.h>
+
+/* Defines */
+/* Phase current scaling (override with build_flags to match shunt and gain) */
+#ifndef PHASE_CURRENT_FULL_SCALE_MA
+#define PHASE_CURRENT_FULL_SCALE_MA  10000  /* Current at ADC_SENSE_MID_SCALE counts from zero, mA */
+#endif
+#define POWER_METER_QUEUE_SIZE       4      /* Closed windows waiting for the main loop (power of 2) */
+#define POWER_METER_MAX_TICKS        10000  /* Window limit without a cycle (one turn at 0.1 Hz) */
+#define POWER_METER_ACTIVE_TICKS     4      /* Active current window (250 Hz at 1 kHz ticks) */
+
+/* Types */
+/**
+ * @brief Results of the last closed window (one electrical cycle)
+ */
+typedef struct {
+  uint32_t currentMilliA[PWM_PHASE_COUNT];  /* RMS current of U, V, W */
+  int32_t powerMilliW;                      /* Active power, < 0 when regenerating */
+  int64_t energyMilliJ;                     /* Net energy since the last reset */
+  uint32_t windowMs;                        /* Length of the window */
+  uint32_t samples;                         /* ADC sequences in the window */
+  uint32_t skipped;                         /* Sequences left out (shunts not conducting) */
+  uint32_t cycles;                          /* Windows closed since the last reset */
+  uint32_t dropped;                         /* Windows lost with the queue full */
+} PowerReading_t;
+
+/* Public functions */
+void PowerMeter_Init(FreqControl_t *axis);
+void PowerMeter_Tick(void);
+void PowerMeter_Sample(const volatile uint16_t *samples);
+void PowerMeter_Process(void);
+const PowerReading_t* PowerMeter_GetReading(void);
+void PowerMeter_ResetEnergy(void);
+int32_t PowerMeter_GetActiveCurrentMilliA(void);
+uint8_t PowerMeter_IsActiveCurrentValid(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __POWER_METER_H */
@@ -1,107 +1,508 @@
 /**
  * @file pwm_control.c
  * @brief Implementação do controle PWM para o inversor de frequência trifásico
+ *
+ * Compare values (CCR1..CCR3) and the carrier period (ARR) are written as one
+ * "modulation frame". CCRx and ARR are preloaded registers: the values written
+ * by software only reach the shadow registers at an update event (UEV). The
+ * update event is never disabled while a frame is written: on TIM1 it is the
+ * control tick, the ADC and replay DMA pacing and the timebase, and CR1.UDIS
+ * would drop it rather than defer it. A commit from the control tick lands
+ * well before the next UEV; a commit that an UEV does interrupt is counted as
+ * a missed deadline (that frame is applied over two updates). The output
+ * enables are also preloaded (CR2.CCPC) and applied together by a software
+ * COM event.
+ *
+ * The repetition counter divides the update event down to a fixed
+ * PWM_CONTROL_TICK_HZ whatever the carrier: the update interrupt is the
+ * control timebase, and frames committed from it land at the next tick.
+ *
+ * Channel 4 has no pin: its reference (OC4REF, routed to TRGO) rises at the
+ * carrier peak to trigger the ADC, so CCR4 follows ARR in every frame.
+ *
+ * Each phase drives a complementary pair (CHx high side, CHxN low side); the
+ * timer's dead-time generator inserts the blanking between them.
+ *
+ * Every output is a PWMControl_t, so a second three-phase output can run on
+ * a general-purpose timer (TIM3). Such a timer has no repetition counter, no
+ * complementary outputs and no MOE: its frames take effect at its next
+ * update event, and its channels are simply switched on and off.
+ *
+ * Outputs are switched by their enable bits in CCER, never by stopping the
+ * timer: the TIM1 counter is the control tick, the ADC trigger and the
+ * timebase, and must keep running while the motor is stopped.
+ *
+ * Replay (synchronous PWM): when a DMA channel is linked to the CC1 request
+ * of the timer, a table of CCR1..CCR3 triplets can be played in a loop with
+ * no CPU. CR2.CCDS moves the CC1 DMA request to the update event and the DMA
+ * burst (DCR/DMAR) writes the three compare preloads per request, so each
+ * triplet takes effect at the following update event, like a committed frame.
  */
 
 #include "pwm_control.h"
 
-/* Private variables */
-static TIM_HandleTypeDef* pwmTimer;
-static uint8_t pwmEnabled = 0;
+/* Private defines */
+#define PHASE_ENABLES     (TIM_CCER_CC1E | TIM_CCER_CC2E | TIM_CCER_CC3E)
+#define PHASE_N_ENABLES   (TIM_CCER_CC1NE | TIM_CCER_CC2NE | TIM_CCER_CC3NE)
+
+/* Private function prototypes */
+static uint8_t CrossedTurningPoint(uint32_t cnt0, uint32_t down0,
+                                   uint32_t cnt1, uint32_t down1);
+static void GenerateComEvent(PWMControl_t *pwm);
+static void SetChannelEnables(PWMControl_t *pwm, uint8_t enable);
+static void SetOutputMode(PWMControl_t *pwm, uint32_t forceInactive);
 
 /**
- * @brief Initializes the PWM control module
- * @param htim Pointer to PWM timer handle
+ * @brief Initializes a PWM output
+ * @param pwm PWM output object
+ * @param htim Pointer to PWM timer handle (center-aligned, already configured)
  * @retval None
  */
-void PWMControl_Init(TIM_HandleTypeDef *htim)
+void PWMControl_Init(PWMControl_t *pwm, TIM_HandleTypeDef *htim)
 {
-  pwmTimer = htim;
-  pwmEnabled = 0;
-  
+  pwm->htim = htim;
+  pwm->enabled = 0;
+  pwm->advanced = IS_TIM_BREAK_INSTANCE(htim->Instance) ? 1 : 0;
+  pwm->replaying = 0;
+  pwm->replayCompares = NULL;
+  pwm->replayFrames = 0;
+  pwm->commitCount = 0;
+  pwm->missedCommits = 0;
+  pwm->updateEvents = 0;
+
+  /* Compare preload on all phases (ARR preload is set by the timer init) */
+  htim->Instance->CCMR1 |= TIM_CCMR1_OC1PE | TIM_CCMR1_OC2PE;
+  htim->Instance->CCMR2 |= TIM_CCMR2_OC3PE | TIM_CCMR2_OC4PE;
+
+  /* Preloaded output enables, applied only on a software COM event */
+  if (pwm->advanced)
+  {
+    HAL_TIMEx_ConfigCommutEvent(htim, TIM_TS_NONE, TIM_COMMUTATION_SOFTWARE);
+  }
+
+  /* Both buffers start from the current carrier with zero duty */
+  pwm->frames[0].compare[0] = 0;
+  pwm->frames[0].compare[1] = 0;
+  pwm->frames[0].compare[2] = 0;
+  pwm->frames[0].period = (uint16_t)__HAL_TIM_GET_AUTORELOAD(htim);
+  pwm->frames[0].repetition = pwm->advanced ? (uint8_t)htim->Instance->RCR : 0;
+  pwm->frames[1] = pwm->frames[0];
+  pwm->stagingIndex = 0;
+
   /* Ensure PWM outputs are at zero */
-  PWMControl_SetOutputs(0, 0, 0);
+  PWMControl_SetOutputs(pwm, 0, 0, 0);
 }
 
 /**
  * @brief Sets the PWM duty cycle for all three phases
- * @param phaseU Phase U duty cycle value (0-1000)
- * @param phaseV Phase V duty cycle value (0-1000)
- * @param phaseW Phase W duty cycle value (0-1000)
+ * @note Stages the values and commits them as one frame
+ * @param pwm PWM output object
+ * @param phaseU Phase U compare value (0 to the period: 0-100% duty)
+ * @param phaseV Phase V compare value
+ * @param phaseW Phase W compare value
  * @retval None
  */
-void PWMControl_SetOutputs(uint16_t phaseU, uint16_t phaseV, uint16_t phaseW)
+void PWMControl_SetOutputs(PWMControl_t *pwm, uint16_t phaseU, uint16_t phaseV, uint16_t phaseW)
 {
-  /* Set PWM values for each phase */
-  __HAL_TIM_SET_COMPARE(pwmTimer, TIM_CHANNEL_1, phaseU);
-  __HAL_TIM_SET_COMPARE(pwmTimer, TIM_CHANNEL_2, phaseV);
-  __HAL_TIM_SET_COMPARE(pwmTimer, TIM_CHANNEL_3, phaseW);
+  PWMControl_StageOutputs(pwm, phaseU, phaseV, phaseW);
+  PWMControl_CommitFrame(pwm);
 }
 
 /**
  * @brief Sets the PWM carrier frequency
+ * @note Stages the new period and commits it as one frame
+ * @param pwm PWM output object
  * @param freqHz PWM carrier frequency in Hz
  * @retval None
  */
-void PWMControl_SetCarrierFreq(uint32_t freqHz)
+void PWMControl_SetCarrierFreq(PWMControl_t *pwm, uint32_t freqHz)
+{
+  PWMControl_StageCarrierFreq(pwm, freqHz);
+  PWMControl_CommitFrame(pwm);
+}
+
+/**
+ * @brief Stages the compare values of the next frame
+ * @param pwm PWM output object
+ * @param phaseU Phase U compare value
+ * @param phaseV Phase V compare value
+ * @param phaseW Phase W compare value
+ * @retval None
+ */
+void PWMControl_StageOutputs(PWMControl_t *pwm, uint16_t phaseU, uint16_t phaseV, uint16_t phaseW)
+{
+  PWMFrame_t* frame = &pwm->frames[pwm->stagingIndex];
+
+  frame->compare[0] = phaseU;
+  frame->compare[1] = phaseV;
+  frame->compare[2] = phaseW;
+}
+
+/**
+ * @brief Stages the carrier period of the next frame
+ * @note The carrier is rounded down to a multiple of PWM_CONTROL_TICK_HZ / 2
+ *       so that a whole number of half periods fits in one control tick
+ * @param pwm PWM output object
+ * @param freqHz PWM carrier frequency in Hz
+ * @retval None
+ */
+void PWMControl_StageCarrierFreq(PWMControl_t *pwm, uint32_t freqHz)
 {
   uint32_t timerClock;
   uint32_t period;
-  
+
   /* Limit the frequency to valid range */
   if (freqHz < PWM_MIN_CARRIER_FREQ)
     freqHz = PWM_MIN_CARRIER_FREQ;
-  
+
   if (freqHz > PWM_MAX_CARRIER_FREQ)
     freqHz = PWM_MAX_CARRIER_FREQ;
-  
+
+  freqHz -= freqHz % (PWM_CONTROL_TICK_HZ / 2);
+
   /* Get timer clock */
   timerClock = HAL_RCC_GetPCLK1Freq();
-  
+
   /* Calculate timer period for desired frequency */
   /* In center-aligned mode, the frequency is timer_clock / (2 * period) */
   period = timerClock / (2 * freqHz);
-  
-  /* Update timer period */
-  __HAL_TIM_SET_AUTORELOAD(pwmTimer, period);
+  if (period > 0xFFFF)
+    period = 0xFFFF;
+
+  pwm->frames[pwm->stagingIndex].period = (uint16_t)period;
+  pwm->frames[pwm->stagingIndex].repetition = (uint8_t)((2 * freqHz) / PWM_CONTROL_TICK_HZ - 1);
+}
+
+/**
+ * @brief Commits the staged frame so it takes effect at the next update event
+ * @note A commit whose write window contains an update event is counted as
+ *       a missed deadline. On TIM1 that is an update that actually happened
+ *       (UIF raised inside the window, or the update interrupt ran in it);
+ *       on a timer without repetition counter every turning point is one.
+ * @param pwm PWM output object
+ * @retval 0=on time, 1=missed deadline
+ */
+uint8_t PWMControl_CommitFrame(PWMControl_t *pwm)
+{
+  TIM_TypeDef* tim = pwm->htim->Instance;
+  const PWMFrame_t* frame = &pwm->frames[pwm->stagingIndex];
+  uint32_t cnt0, down0, cnt1, down1, flag0, events0;
+  uint8_t missed;
+
+  events0 = pwm->updateEvents;
+  flag0 = tim->SR & TIM_SR_UIF;
+  cnt0 = tim->CNT;
+  down0 = tim->CR1 & TIM_CR1_DIR;
+
+  /* Compares first, the period last: an update landing in between leaves
+     the old period with the new compares for one update at most */
+  tim->CCR1 = frame->compare[0];
+  tim->CCR2 = frame->compare[1];
+  tim->CCR3 = frame->compare[2];
+  if (pwm->advanced)
+  {
+    tim->CCR4 = frame->period - PWM_ADC_TRIGGER_LEAD;
+    tim->RCR = frame->repetition;
+  }
+  tim->ARR = frame->period;
+
+  if (pwm->advanced)
+  {
+    /* The repetition counter hides most turning points: only trust an
+       update that happened (the interrupt clears UIF, so count it too) */
+    missed = (!flag0 && (tim->SR & TIM_SR_UIF)) || pwm->updateEvents != events0;
+  }
+  else
+  {
+    cnt1 = tim->CNT;
+    down1 = tim->CR1 & TIM_CR1_DIR;
+    missed = CrossedTurningPoint(cnt0, down0, cnt1, down1);
+  }
+  pwm->commitCount++;
+  if (missed)
+  {
+    pwm->missedCommits++;
+  }
+
+  /* Swap buffers; the new staging frame starts as a copy of the active one */
+  pwm->stagingIndex ^= 1;
+  pwm->frames[pwm->stagingIndex] = pwm->frames[pwm->stagingIndex ^ 1];
+
+  return missed;
+}
+
+/**
+ * @brief Counts an update event of a timer with repetition counter
+ * @note Called from the update interrupt (the control tick), so a commit
+ *       interrupted by it sees the update even though UIF is cleared
+ * @param pwm PWM output object
+ * @retval None
+ */
+void PWMControl_CountUpdateEvent(PWMControl_t *pwm)
+{
+  pwm->updateEvents++;
+}
+
+/**
+ * @brief Gets the last committed frame
+ * @param pwm PWM output object
+ * @retval Pointer to the active frame
+ */
+const PWMFrame_t* PWMControl_GetActiveFrame(const PWMControl_t *pwm)
+{
+  return &pwm->frames[pwm->stagingIndex ^ 1];
+}
+
+/**
+ * @brief Gets the compares driving the outputs until the next update event
+ * @note Call at the start of the control tick, before this tick's commit:
+ *       the last committed frame is then the one on the outputs. While
+ *       replaying, the DMA has just written the next triplet, so the one on
+ *       the outputs is the triplet before it.
+ * @param pwm PWM output object
+ * @retval Pointer to CCR1..CCR3
+ */
+const uint16_t* PWMControl_GetOutputCompares(const PWMControl_t *pwm)
+{
+  DMA_HandleTypeDef* hdma;
+  uint32_t written;
+
+  if (!pwm->replaying)
+  {
+    return PWMControl_GetActiveFrame(pwm)->compare;
+  }
+
+  /* Triplets written in this lap of the table; 0 means a whole lap */
+  hdma = pwm->htim->hdma[TIM_DMA_ID_CC1];
+  written = ((uint32_t)pwm->replayFrames * PWM_PHASE_COUNT - __HAL_DMA_GET_COUNTER(hdma)) /
+            PWM_PHASE_COUNT;
+  if (written == 0)
+  {
+    written = pwm->replayFrames;
+  }
+  return &pwm->replayCompares[((written + pwm->replayFrames - 2) % pwm->replayFrames) *
+                              PWM_PHASE_COUNT];
+}
+
+/**
+ * @brief Gets the number of committed frames
+ * @param pwm PWM output object
+ * @retval Commit count since initialization
+ */
+uint32_t PWMControl_GetCommitCount(const PWMControl_t *pwm)
+{
+  return pwm->commitCount;
+}
+
+/**
+ * @brief Gets the number of frames that missed their update event
+ * @param pwm PWM output object
+ * @retval Missed deadline count since initialization
+ */
+uint32_t PWMControl_GetMissedCommits(const PWMControl_t *pwm)
+{
+  return pwm->missedCommits;
 }
 
 /**
  * @brief Enables the PWM outputs
+ * @note Starts from zero duty: every low side conducts first (zero voltage
+ *       vector, charges bootstrap capacitors), then modulation takes over
+ * @param pwm PWM output object
  * @retval None
  */
-void PWMControl_Enable(void)
+void PWMControl_Enable(PWMControl_t *pwm)
 {
-  if (!pwmEnabled)
+  if (!pwm->enabled)
   {
-    /* Enable PWM outputs */
-    HAL_TIM_PWM_Start(pwmTimer, TIM_CHANNEL_1);
-    HAL_TIM_PWM_Start(pwmTimer, TIM_CHANNEL_2);
-    HAL_TIM_PWM_Start(pwmTimer, TIM_CHANNEL_3);
-    
-    /* Enable timer main output */
-    __HAL_TIM_MOE_ENABLE(pwmTimer);
-    
-    pwmEnabled = 1;
+    PWMControl_SetOutputs(pwm, 0, 0, 0);
+
+    /* Enable both sides of every leg (preloaded until the COM event) */
+    SetOutputMode(pwm, 0);
+    SetChannelEnables(pwm, 1);
+
+    if (pwm->advanced)
+    {
+      GenerateComEvent(pwm);
+
+      /* Enable timer main output */
+      __HAL_TIM_MOE_ENABLE(pwm->htim);
+    }
+
+    pwm->enabled = 1;
   }
 }
 
 /**
  * @brief Disables the PWM outputs
+ * @note Clearing MOE puts all six gates in their idle (off) level at once,
+ *       after the dead time; the channels are then switched off at leisure.
+ *       The counter keeps running, so this is safe in the control tick.
+ * @param pwm PWM output object
  * @retval None
  */
-void PWMControl_Disable(void)
+void PWMControl_Disable(PWMControl_t *pwm)
 {
-  if (pwmEnabled)
+  if (pwm->enabled)
   {
+    /* The next start begins with computed frames */
+    PWMControl_StopReplay(pwm);
+
+    /* Disable timer main output first: all gates go idle at once
+       (no MOE on a general-purpose timer: force the references low) */
+    if (pwm->advanced)
+    {
+      __HAL_TIM_MOE_DISABLE_UNCONDITIONALLY(pwm->htim);
+    }
+    else
+    {
+      SetOutputMode(pwm, 1);
+    }
+
     /* Disable PWM outputs */
-    HAL_TIM_PWM_Stop(pwmTimer, TIM_CHANNEL_1);
-    HAL_TIM_PWM_Stop(pwmTimer, TIM_CHANNEL_2);
-    HAL_TIM_PWM_Stop(pwmTimer, TIM_CHANNEL_3);
-    
-    /* Disable timer main output */
-    __HAL_TIM_MOE_DISABLE(pwmTimer);
-    
-    pwmEnabled = 0;
+    SetChannelEnables(pwm, 0);
+    if (pwm->advanced)
+    {
+      GenerateComEvent(pwm);
+    }
+
+    /* Next start begins from zero duty */
+    PWMControl_SetOutputs(pwm, 0, 0, 0);
+
+    pwm->enabled = 0;
   }
 }
+
+/**
+ * @brief Checks if the output can replay a compare table by DMA
+ * @param pwm PWM output object
+ * @retval 1 if a DMA channel is linked to the CC1 request
+ */
+uint8_t PWMControl_CanReplay(const PWMControl_t *pwm)
+{
+  return pwm->htim->hdma[TIM_DMA_ID_CC1] != NULL;
+}
+
+/**
+ * @brief Starts replaying a compare table, one triplet per update event
+ * @note The first triplet is written at the next update event and takes
+ *       effect at the one after, as a frame committed now would. The table
+ *       must stay untouched until PWMControl_StopReplay().
+ * @param pwm PWM output object
+ * @param compares CCR1, CCR2, CCR3 triplets
+ * @param frameCount Number of triplets (the loop length)
+ * @retval 0=success, 1=error (no DMA channel or DMA busy)
+ */
+uint8_t PWMControl_StartReplay(PWMControl_t *pwm, const uint16_t* compares, uint16_t frameCount)
+{
+  DMA_HandleTypeDef* hdma = pwm->htim->hdma[TIM_DMA_ID_CC1];
+  TIM_TypeDef* tim = pwm->htim->Instance;
+
+  if (hdma == NULL || frameCount == 0 || pwm->replaying)
+  {
+    return 1;
+  }
+
+  /* Burst of three transfers into CCR1..CCR3 per DMA request */
+  tim->DCR = TIM_DMABURSTLENGTH_3TRANSFERS | TIM_DMABASE_CCR1;
+  if (HAL_DMA_Start(hdma, (uint32_t)(uintptr_t)compares, (uint32_t)(uintptr_t)&tim->DMAR,
+                    (uint32_t)frameCount * PWM_PHASE_COUNT) != HAL_OK)
+  {
+    return 1;
+  }
+  pwm->replayCompares = compares;
+  pwm->replayFrames = frameCount;
+  tim->CR2 |= TIM_CR2_CCDS;
+  tim->DIER |= TIM_DIER_CC1DE;
+  pwm->replaying = 1;
+
+  return 0;
+}
+
+/**
+ * @brief Stops the compare table replay
+ * @note Frames committed after this call replace the last replayed triplet
+ * @param pwm PWM output object
+ * @retval None
+ */
+void PWMControl_StopReplay(PWMControl_t *pwm)
+{
+  TIM_TypeDef* tim = pwm->htim->Instance;
+
+  if (pwm->replaying)
+  {
+    tim->DIER &= ~TIM_DIER_CC1DE;
+    HAL_DMA_Abort(pwm->htim->hdma[TIM_DMA_ID_CC1]);
+    tim->CR2 &= ~TIM_CR2_CCDS;
+    pwm->replaying = 0;
+  }
+}
+
+/**
+ * @brief Checks whether the counter passed a turning point
+ * @note In center-aligned mode the counter direction flips at every
+ *       overflow/underflow; without repetition counter each one is an
+ *       update event
+ * @retval 1 if a turning point fell between the two samples
+ */
+static uint8_t CrossedTurningPoint(uint32_t cnt0, uint32_t down0,
+                                   uint32_t cnt1, uint32_t down1)
+{
+  if (down0 != down1)
+  {
+    return 1;
+  }
+
+  /* Same direction but moved backwards: two turning points were crossed */
+  return down0 ? (cnt1 > cnt0) : (cnt1 < cnt0);
+}
+
+/**
+ * @brief Applies the preloaded output enables on all channels at once
+ * @retval None
+ */
+static void GenerateComEvent(PWMControl_t *pwm)
+{
+  pwm->htim->Instance->EGR = TIM_EGR_COMG;
+}
+
+/**
+ * @brief Sets or clears the enables of the three phases: both sides on TIM1
+ *        (preloaded until the COM event), the single output otherwise
+ * @retval None
+ */
+static void SetChannelEnables(PWMControl_t *pwm, uint8_t enable)
+{
+  TIM_TypeDef* tim = pwm->htim->Instance;
+  uint32_t mask = pwm->advanced ? (PHASE_ENABLES | PHASE_N_ENABLES) : PHASE_ENABLES;
+
+  if (enable)
+  {
+    tim->CCER |= mask;
+  }
+  else
+  {
+    tim->CCER &= ~mask;
+  }
+}
+
+/**
+ * @brief Switches the three phase references between PWM mode 1 and
+ *        "force inactive" on a general-purpose timer (not preloaded)
+ * @retval None
+ */
+static void SetOutputMode(PWMControl_t *pwm, uint32_t forceInactive)
+{
+  TIM_TypeDef* tim = pwm->htim->Instance;
+  uint32_t mode1 = forceInactive ? TIM_CCMR1_OC1M_2 : (TIM_CCMR1_OC1M_2 | TIM_CCMR1_OC1M_1);
+  uint32_t mode2 = forceInactive ? TIM_CCMR1_OC2M_2 : (TIM_CCMR1_OC2M_2 | TIM_CCMR1_OC2M_1);
+  uint32_t mode3 = forceInactive ? TIM_CCMR2_OC3M_2 : (TIM_CCMR2_OC3M_2 | TIM_CCMR2_OC3M_1);
+
+  if (pwm->advanced)
+  {
+    return;
+  }
+
+  tim->CCMR1 = (tim->CCMR1 & ~(TIM_CCMR1_OC1M | TIM_CCMR1_OC2M)) | mode1 | mode2;
+  tim->CCMR2 = (tim->CCMR2 & ~TIM_CCMR2_OC3M) | mode3;
+}
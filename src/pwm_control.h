@@ -12,18 +12,82 @@ extern "C" {
 
 /* Includes */
 #include "stm32f0xx_hal.h"
+#include "adc_sense.h"
 #include <stdint.h>
 
 /* Defines */
 #define PWM_MAX_CARRIER_FREQ  20000  /* 20kHz */
 #define PWM_MIN_CARRIER_FREQ  4000   /* 4kHz */
+#define PWM_PHASE_COUNT       3
+#define PWM_CONTROL_TICK_HZ   1000   /* Update events per second: the control timebase */
+/* CH4 (ADC trigger) fires this many ticks before the carrier peak, so the
+   current samples straddle it: 79 ticks (9.9 us at 8 MHz) with 3 shunts */
+#define PWM_ADC_TRIGGER_LEAD  (((ADC_SENSE_CURRENT_PHASES - 1) * ADC_SENSE_CONVERSION_TICKS) / 2 + \
+                               ADC_SENSE_SAMPLE_TICKS)
+#define PWM_DEAD_TIME_TICKS   100    /* TIM1 dead time inserted before each low/high side turn-on */
+
+/* Gate signal polarity (override with build_flags to match the driver) */
+#ifndef PWM_HIGH_SIDE_ACTIVE_LOW
+#define PWM_HIGH_SIDE_ACTIVE_LOW  0   /* CH1-CH3: 0=active high, 1=active low */
+#endif
+#ifndef PWM_LOW_SIDE_ACTIVE_LOW
+#define PWM_LOW_SIDE_ACTIVE_LOW   0   /* CH1N-CH3N: 0=active high, 1=active low */
+#endif
+
+#define PWM_OC_POLARITY     (PWM_HIGH_SIDE_ACTIVE_LOW ? TIM_OCPOLARITY_LOW : TIM_OCPOLARITY_HIGH)
+#define PWM_OCN_POLARITY    (PWM_LOW_SIDE_ACTIVE_LOW ? TIM_OCNPOLARITY_LOW : TIM_OCNPOLARITY_HIGH)
+/* Idle (MOE=0) levels keep both transistors of every leg switched off */
+#define PWM_OC_IDLE_STATE   (PWM_HIGH_SIDE_ACTIVE_LOW ? TIM_OCIDLESTATE_SET : TIM_OCIDLESTATE_RESET)
+#define PWM_OCN_IDLE_STATE  (PWM_LOW_SIDE_ACTIVE_LOW ? TIM_OCNIDLESTATE_SET : TIM_OCNIDLESTATE_RESET)
+
+/* Types */
+/**
+ * @brief Modulation frame: compare values and carrier period that must reach
+ *        the timer together, at the same update event
+ */
+typedef struct {
+  uint16_t compare[PWM_PHASE_COUNT];  /* CCR1..CCR3 */
+  uint16_t period;                    /* ARR (carrier period in timer ticks) */
+  uint8_t repetition;                 /* RCR (half carrier periods per update - 1) */
+} PWMFrame_t;
+
+/**
+ * @brief One three-phase PWM output (one timer)
+ * @note TIM1 drives complementary pairs with dead time; a general-purpose
+ *       timer (TIM3) drives the three high-side inputs only, for gate
+ *       drivers that generate the low side and the dead time themselves
+ */
+typedef struct {
+  TIM_HandleTypeDef* htim;
+  PWMFrame_t frames[2];               /* Double buffer: staging / active */
+  uint8_t stagingIndex;
+  uint8_t enabled;
+  uint8_t advanced;                   /* Complementary outputs, RCR and MOE */
+  volatile uint8_t replaying;         /* CCR1..CCR3 fed by circular DMA */
+  const uint16_t* replayCompares;     /* Table being replayed */
+  uint16_t replayFrames;
+  uint32_t commitCount;
+  uint32_t missedCommits;
+  volatile uint32_t updateEvents;     /* Update interrupts seen (TIM1: control ticks) */
+} PWMControl_t;
 
 /* Public functions */
-void PWMControl_Init(TIM_HandleTypeDef *htim);
-void PWMControl_SetOutputs(uint16_t phaseU, uint16_t phaseV, uint16_t phaseW);
-void PWMControl_SetCarrierFreq(uint32_t freqHz);
-void PWMControl_Enable(void);
-void PWMControl_Disable(void);
+void PWMControl_Init(PWMControl_t *pwm, TIM_HandleTypeDef *htim);
+void PWMControl_SetOutputs(PWMControl_t *pwm, uint16_t phaseU, uint16_t phaseV, uint16_t phaseW);
+void PWMControl_SetCarrierFreq(PWMControl_t *pwm, uint32_t freqHz);
+void PWMControl_StageOutputs(PWMControl_t *pwm, uint16_t phaseU, uint16_t phaseV, uint16_t phaseW);
+void PWMControl_StageCarrierFreq(PWMControl_t *pwm, uint32_t freqHz);
+uint8_t PWMControl_CommitFrame(PWMControl_t *pwm);
+void PWMControl_CountUpdateEvent(PWMControl_t *pwm);
+const PWMFrame_t* PWMControl_GetActiveFrame(const PWMControl_t *pwm);
+const uint16_t* PWMControl_GetOutputCompares(const PWMControl_t *pwm);
+uint32_t PWMControl_GetCommitCount(const PWMControl_t *pwm);
+uint32_t PWMControl_GetMissedCommits(const PWMControl_t *pwm);
+void PWMControl_Enable(PWMControl_t *pwm);
+void PWMControl_Disable(PWMControl_t *pwm);
+uint8_t PWMControl_CanReplay(const PWMControl_t *pwm);
+uint8_t PWMControl_StartReplay(PWMControl_t *pwm, const uint16_t* compares, uint16_t frameCount);
+void PWMControl_StopReplay(PWMControl_t *pwm);
 
 #ifdef __cplusplus
 }
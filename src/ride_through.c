@@ -0,0 +1,308 @@
+/**
+ * @file ride_through.c
+ * @brief Implementação da travessia de afundamentos da rede (KEB)
+ *
+ * When the rectified supply drops out, the bus capacitors alone feed the
+ * motor and the bus collapses within tens of milliseconds. The control tick
+ * watches the filtered bus voltage; below the dip level it caps the output
+ * frequency of the axis and regulates the bus back to that level: a PI
+ * whose output is the frequency. Pulling the frequency below the rotor speed
+ * makes the motor a generator, so the load's kinetic energy refills the
+ * capacitors while the motor slows down.
+ *
+ * The PI is in velocity form (each tick adds Kp * change of error plus
+ * Ki * error to the frequency), so clamping the frequency between the
+ * minimum and the setpoint is all the anti-windup it needs. It lowers the
+ * frequency as fast as it likes but raises it no faster than the return
+ * ramp, so the supply coming back does not kick the motor. When the bus
+ * stays above the return level for RIDE_RETURN_MS the supply is back: the
+ * dip is logged and the cap ramps up to the setpoint at RIDE_ACCEL_MHZ_S.
+ * A new dip during the ramp restarts the regulation from where it is.
+ */
+
+#include "ride_through.h"
+
+/* Private defines */
+#define RETURN_TICKS    ((RIDE_RETURN_MS * PWM_CONTROL_TICK_HZ) / 1000)
+#define ACCEL_STEP_UHZ  ((RIDE_ACCEL_MHZ_S * 1000L) / PWM_CONTROL_TICK_HZ)
+#define KP_STEP_UHZ     (RIDE_KP_MHZ * 100L)                        /* Per 0.1 V of change */
+#define KI_STEP_UHZ     ((RIDE_KI_MHZ * 100L) / PWM_CONTROL_TICK_HZ)  /* Per 0.1 V, per tick */
+
+/* Private variables */
+static FreqControl_t* rideAxis = NULL;
+static RideThrough_t ride;
+
+/* Control tick only */
+static int32_t freqMicroHz;             /* Capped output frequency, uHz */
+static int32_t lastError;               /* Bus error of the previous tick, 0.1 V */
+static uint32_t dipTicks;
+static uint32_t returnTicks;
+static uint8_t reachedMinimum;
+
+/* Private function prototypes */
+static void StartDip(uint16_t busDv);
+static void Regulate(uint16_t busDv, uint32_t setpointMilliHz);
+static void Recover(uint16_t busDv, uint32_t setpointMilliHz);
+static void EndDip(uint32_t ticks);
+static void Release(void);
+
+/**
+ * @brief Initializes the ride-through on an axis (the one whose bus is sensed)
+ * @param axis Axis driven by TIM1
+ * @retval None
+ */
+void RideThrough_Init(FreqControl_t *axis)
+{
+  ride.enabled = RIDE_THROUGH_ENABLE;
+  ride.dipDv = RIDE_DIP_DV;
+  ride.returnDv = RIDE_RETURN_DV;
+  ride.state = RIDE_STATE_IDLE;
+  ride.limitMilliHz = 0;
+  RideThrough_ClearLog();
+
+  freqMicroHz = 0;
+  lastError = 0;
+  dipTicks = 0;
+  returnTicks = 0;
+  reachedMinimum = 0;
+  rideAxis = axis;
+}
+
+/**
+ * @brief Enables or disables the ride-through
+ * @note Disabling during a dip returns to the setpoint at the next tick
+ * @param enable 1 = on, 0 = off
+ * @retval None
+ */
+void RideThrough_SetEnabled(uint8_t enable)
+{
+  ride.enabled = enable ? 1 : 0;
+}
+
+/**
+ * @brief Sets the dip and return levels
+ * @param dipDv Dip detection level, also the bus reference while riding, 0.1 V
+ * @param returnDv Level above which the supply is back, 0.1 V
+ * @retval 0=success, 1=error (out of range or return not above dip)
+ */
+uint8_t RideThrough_SetLevels(uint16_t dipDv, uint16_t returnDv)
+{
+  if (dipDv < BUS_SENSE_VALID_DV || returnDv <= dipDv || returnDv > BUS_FULL_SCALE_DV)
+  {
+    return 1;
+  }
+  ride.dipDv = dipDv;
+  ride.returnDv = returnDv;
+  return 0;
+}
+
+/**
+ * @brief Clears the dip log
+ * @retval None
+ */
+void RideThrough_ClearLog(void)
+{
+  ride.dips = 0;
+  ride.exhausted = 0;
+  ride.lastDipMs = 0;
+  ride.longestDipMs = 0;
+  ride.lastMinBusDv = 0;
+  ride.lastMinMilliHz = 0;
+}
+
+/**
+ * @brief Gets the settings, the state and the dip log
+ * @retval Pointer to the state
+ */
+const RideThrough_t* RideThrough_GetState(void)
+{
+  return &ride;
+}
+
+/**
+ * @brief Watches the bus and rides through dips
+ * @note Called once per control tick from the TIM1 update interrupt, after
+ *       the frequency reference is set and before FreqControl_Update()
+ * @retval None
+ */
+void RideThrough_Tick(void)
+{
+  uint16_t busDv;
+  uint32_t setpointMilliHz;
+
+  if (rideAxis == NULL)
+  {
+    return;
+  }
+  if (!FreqControl_IsRunning(rideAxis))
+  {
+    Release();
+    return;
+  }
+  if (FreqControl_IsStopping(rideAxis))
+  {
+    /* The ramp stop starts from the capped frequency and clears the cap */
+    if (ride.state == RIDE_STATE_DIP)
+    {
+      EndDip(dipTicks);
+    }
+    ride.state = RIDE_STATE_IDLE;
+    return;
+  }
+
+  busDv = AdcSense_GetBusVoltage();
+  setpointMilliHz = rideAxis->setpoint.milliHz;
+  if (!ride.enabled)
+  {
+    if (ride.state == RIDE_STATE_DIP)
+    {
+      EndDip(dipTicks);
+    }
+    Release();
+    return;
+  }
+
+  switch (ride.state)
+  {
+    case RIDE_STATE_DIP:
+      Regulate(busDv, setpointMilliHz);
+      break;
+
+    case RIDE_STATE_RECOVER:
+      Recover(busDv, setpointMilliHz);
+      break;
+
+    default:
+      /* Below the sensing floor there is no bus measurement to act on */
+      if (busDv < ride.dipDv && busDv >= BUS_SENSE_VALID_DV)
+      {
+        freqMicroHz = (int32_t)setpointMilliHz * 1000;
+        StartDip(busDv);
+        Regulate(busDv, setpointMilliHz);
+      }
+      else
+      {
+        FreqControl_SetFrequencyLimit(rideAxis, 0);
+      }
+      break;
+  }
+}
+
+/**
+ * @brief Enters the regulation (new dip), from the current frequency
+ * @param busDv Bus voltage, 0.1 V
+ * @retval None
+ */
+static void StartDip(uint16_t busDv)
+{
+  ride.state = RIDE_STATE_DIP;
+  ride.dips++;
+  ride.lastMinBusDv = busDv;
+  ride.lastMinMilliHz = (uint32_t)freqMicroHz / 1000;
+  lastError = (int32_t)busDv - ride.dipDv;
+  dipTicks = 0;
+  returnTicks = 0;
+  reachedMinimum = 0;
+}
+
+/**
+ * @brief One step of the bus voltage loop
+ * @param busDv Bus voltage, 0.1 V
+ * @param setpointMilliHz Frequency reference of the axis (upper limit)
+ * @retval None
+ */
+static void Regulate(uint16_t busDv, uint32_t setpointMilliHz)
+{
+  int32_t error = (int32_t)busDv - ride.dipDv;
+  int32_t ceiling = (int32_t)setpointMilliHz * 1000;
+  int32_t step = KP_STEP_UHZ * (error - lastError) + KI_STEP_UHZ * error;
+
+  /* Down as fast as the loop asks, up no faster than the return ramp */
+  lastError = error;
+  freqMicroHz += (step < ACCEL_STEP_UHZ) ? step : ACCEL_STEP_UHZ;
+  if (freqMicroHz > ceiling)
+  {
+    freqMicroHz = ceiling;
+  }
+  if (freqMicroHz <= (int32_t)FREQ_MIN_MHZ * 1000)
+  {
+    /* Out of kinetic energy: the bus falls from here */
+    freqMicroHz = FREQ_MIN_MHZ * 1000;
+    if (!reachedMinimum)
+    {
+      reachedMinimum = 1;
+      ride.exhausted++;
+    }
+  }
+
+  dipTicks++;
+  if (busDv < ride.lastMinBusDv)
+  {
+    ride.lastMinBusDv = busDv;
+  }
+  if ((uint32_t)freqMicroHz / 1000 < ride.lastMinMilliHz)
+  {
+    ride.lastMinMilliHz = (uint32_t)freqMicroHz / 1000;
+  }
+
+  /* Supply back once the bus holds above the return level */
+  returnTicks = (busDv >= ride.returnDv) ? returnTicks + 1 : 0;
+  if (returnTicks >= RETURN_TICKS)
+  {
+    EndDip(dipTicks - returnTicks);
+    ride.state = RIDE_STATE_RECOVER;
+  }
+
+  ride.limitMilliHz = (uint32_t)freqMicroHz / 1000;
+  FreqControl_SetFrequencyLimit(rideAxis, ride.limitMilliHz);
+}
+
+/**
+ * @brief One step of the ramp back to the setpoint
+ * @param busDv Bus voltage, 0.1 V
+ * @param setpointMilliHz Frequency reference of the axis
+ * @retval None
+ */
+static void Recover(uint16_t busDv, uint32_t setpointMilliHz)
+{
+  if (busDv < ride.dipDv)
+  {
+    StartDip(busDv);
+    Regulate(busDv, setpointMilliHz);
+    return;
+  }
+
+  freqMicroHz += ACCEL_STEP_UHZ;
+  if (freqMicroHz >= (int32_t)setpointMilliHz * 1000)
+  {
+    Release();
+    return;
+  }
+  ride.limitMilliHz = (uint32_t)freqMicroHz / 1000;
+  FreqControl_SetFrequencyLimit(rideAxis, ride.limitMilliHz);
+}
+
+/**
+ * @brief Logs the duration of a dip
+ * @param ticks Control ticks from detection to supply return
+ * @retval None
+ */
+static void EndDip(uint32_t ticks)
+{
+  ride.lastDipMs = (ticks * 1000UL) / PWM_CONTROL_TICK_HZ;
+  if (ride.lastDipMs > ride.longestDipMs)
+  {
+    ride.longestDipMs = ride.lastDipMs;
+  }
+}
+
+/**
+ * @brief Back to watching, without a cap
+ * @retval None
+ */
+static void Release(void)
+{
+  ride.state = RIDE_STATE_IDLE;
+  ride.limitMilliHz = 0;
+  FreqControl_SetFrequencyLimit(rideAxis, 0);
+}
@@ -0,0 +1,74 @@
+/**
+ * @file ride_through.h
+ * @brief Travessia de afundamentos da rede pela energia cinética da carga
+ */
+
+#ifndef __RIDE_THROUGH_H
+#define __RIDE_THROUGH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes */
+#include "freq_control.h"
+#include "adc_sense.h"
+#include <stdint.h>
+
+/* Defines */
+#ifndef RIDE_THROUGH_ENABLE
+#define RIDE_THROUGH_ENABLE     1       /* Active from reset (RIDE OFF disables) */
+#endif
+#ifndef RIDE_DIP_DV
+#define RIDE_DIP_DV             ((BUS_NOMINAL_DV * 85UL) / 100)  /* Dip level, held by the loop, 0.1 V */
+#endif
+#ifndef RIDE_RETURN_DV
+#define RIDE_RETURN_DV          ((BUS_NOMINAL_DV * 92UL) / 100)  /* Supply back above this, 0.1 V */
+#endif
+#define RIDE_RETURN_MS          20      /* Bus above the return level this long: supply back */
+#ifndef RIDE_KP_MHZ
+#define RIDE_KP_MHZ             200     /* Bus loop gains: mHz per V of bus error */
+#endif
+#ifndef RIDE_KI_MHZ
+#define RIDE_KI_MHZ             20000   /* mHz/s per V of bus error */
+#endif
+#ifndef RIDE_ACCEL_MHZ_S
+#define RIDE_ACCEL_MHZ_S        10000   /* Return to the setpoint after the dip */
+#endif
+
+/* States (RideThrough_t.state) */
+#define RIDE_STATE_IDLE         0       /* Watching the bus */
+#define RIDE_STATE_DIP          1       /* Holding the bus with the regenerated energy */
+#define RIDE_STATE_RECOVER      2       /* Supply back, ramping to the setpoint */
+
+/* Types */
+/**
+ * @brief Ride-through settings (main loop) and dip log (control tick)
+ */
+typedef struct {
+  volatile uint8_t enabled;
+  volatile uint16_t dipDv;            /* Detection level and bus reference, 0.1 V */
+  volatile uint16_t returnDv;         /* Supply considered back above this, 0.1 V */
+  volatile uint8_t state;             /* RIDE_STATE_* */
+  volatile uint32_t limitMilliHz;     /* Frequency cap while not idle */
+  volatile uint32_t dips;             /* Dips ridden through since the last reset */
+  volatile uint32_t exhausted;        /* Dips that reached the minimum frequency */
+  volatile uint32_t lastDipMs;        /* Duration of the last dip */
+  volatile uint32_t longestDipMs;
+  volatile uint16_t lastMinBusDv;     /* Lowest bus voltage in the last dip */
+  volatile uint32_t lastMinMilliHz;   /* Lowest frequency in the last dip */
+} RideThrough_t;
+
+/* Public functions */
+void RideThrough_Init(FreqControl_t *axis);
+void RideThrough_SetEnabled(uint8_t enable);
+uint8_t RideThrough_SetLevels(uint16_t dipDv, uint16_t returnDv);
+void RideThrough_ClearLog(void);
+const RideThrough_t* RideThrough_GetState(void);
+void RideThrough_Tick(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RIDE_THROUGH_H */
@@ -0,0 +1,282 @@
+/**
+ * @file sequencer.c
+ * @brief Implementação do sequenciador de perfis de frequência
+ *
+ * The profile is played from the control timebase (TIM1 update interrupt,
+ * PWM_CONTROL_TICK_HZ): every tick advances ramps and dwells by exactly one
+ * sample, so timing does not depend on the main loop load. Ramps are
+ * generated incrementally (quotient plus Bresenham-style remainder), which
+ * needs one division per segment and none per tick.
+ *
+ * Profiles drive axis FREQ_AXIS_DEFAULT. Every frequency change is made
+ * from the tick, so the sequencer applies setpoints directly instead of
+ * going through the main loop mailbox; Sequencer_Start() only arms a restart
+ * that the next tick performs.
+ */
+
+#include "sequencer.h"
+#include "freq_control.h"
+#include "pwm_control.h"
+
+/* Private variables */
+static FreqControl_t* targetAxis;
+static SeqSegment_t segments[SEQ_MAX_SEGMENTS];
+static uint8_t segmentCount = 0;
+static uint16_t loopCount = 0;
+static volatile SeqState_t state = SEQ_STATE_IDLE;
+static volatile uint8_t segmentIndex = 0;
+static volatile uint8_t inDwell = 0;
+static volatile uint16_t loopsDone = 0;
+static volatile uint32_t elapsedTicks = 0;
+static volatile uint8_t restartPending = 0;
+
+/* Current segment, in ticks */
+static uint32_t rampTicks;
+static uint32_t dwellTicks;
+static uint32_t phaseTicks;
+static int32_t currentMilliHz;
+static int32_t stepMilliHz;      /* Integer part of the per-tick step */
+static int32_t stepRemainder;    /* Fractional part, in 1/rampTicks */
+static int32_t remainderAcc;
+
+/* Private function prototypes */
+static uint32_t MsToTicks(uint32_t ms);
+static void StartSegment(void);
+static void NextSegment(void);
+
+/**
+ * @brief Initializes the sequencer (empty profile)
+ * @retval None
+ */
+void Sequencer_Init(void)
+{
+  targetAxis = FreqControl_GetAxis(FREQ_AXIS_DEFAULT);
+  state = SEQ_STATE_IDLE;
+  Sequencer_Clear();
+  loopCount = 1;
+}
+
+/**
+ * @brief Removes all segments (only while stopped)
+ * @retval None
+ */
+void Sequencer_Clear(void)
+{
+  if (state != SEQ_STATE_RUNNING)
+  {
+    segmentCount = 0;
+    state = SEQ_STATE_IDLE;
+  }
+}
+
+/**
+ * @brief Appends a segment to the profile (only while stopped)
+ * @param targetMilliHz Target frequency in mHz
+ * @param rampMs Ramp time in ms
+ * @param dwellMs Dwell time in ms
+ * @retval 0=success, 1=error (invalid value, table full or running)
+ */
+uint8_t Sequencer_AddSegment(uint32_t targetMilliHz, uint32_t rampMs, uint32_t dwellMs)
+{
+  if (state == SEQ_STATE_RUNNING || segmentCount >= SEQ_MAX_SEGMENTS ||
+      targetMilliHz < FREQ_MIN_MHZ || targetMilliHz > FREQ_MAX_MHZ ||
+      rampMs > SEQ_MAX_TIME_MS || dwellMs > SEQ_MAX_TIME_MS)
+  {
+    return 1;
+  }
+
+  segments[segmentCount].targetMilliHz = targetMilliHz;
+  segments[segmentCount].rampMs = rampMs;
+  segments[segmentCount].dwellMs = dwellMs;
+  segmentCount++;
+  return 0;
+}
+
+/**
+ * @brief Sets how many times the table is played
+ * @param loops Number of passes (0=repeat forever)
+ * @retval None
+ */
+void Sequencer_SetLoopCount(uint16_t loops)
+{
+  loopCount = loops;
+}
+
+/**
+ * @brief Starts playback from the first segment
+ * @note The first ramp starts from the current frequency setpoint
+ * @retval 0=success, 1=error (empty profile)
+ */
+uint8_t Sequencer_Start(void)
+{
+  if (segmentCount == 0)
+  {
+    return 1;
+  }
+
+  state = SEQ_STATE_IDLE;  /* Keep the tick out while the state is rebuilt */
+  segmentIndex = 0;
+  loopsDone = 0;
+  elapsedTicks = 0;
+  restartPending = 1;      /* The first segment is prepared by the tick */
+  state = SEQ_STATE_RUNNING;
+  return 0;
+}
+
+/**
+ * @brief Stops playback, holding the current frequency
+ * @retval None
+ */
+void Sequencer_Stop(void)
+{
+  if (state == SEQ_STATE_RUNNING)
+  {
+    state = SEQ_STATE_IDLE;
+  }
+}
+
+/**
+ * @brief Checks if a profile is playing
+ * @retval 1 if running
+ */
+uint8_t Sequencer_IsRunning(void)
+{
+  return state == SEQ_STATE_RUNNING;
+}
+
+/**
+ * @brief Gets the playback progress
+ * @param progress Pointer to store the progress
+ * @retval None
+ */
+void Sequencer_GetProgress(SeqProgress_t* progress)
+{
+  progress->state = state;
+  progress->segment = segmentIndex;
+  progress->segmentCount = segmentCount;
+  progress->inDwell = inDwell;
+  progress->loop = loopsDone;
+  progress->loopCount = loopCount;
+  progress->elapsedMs = (elapsedTicks / PWM_CONTROL_TICK_HZ) * 1000 +
+                        ((elapsedTicks % PWM_CONTROL_TICK_HZ) * 1000) / PWM_CONTROL_TICK_HZ;
+}
+
+/**
+ * @brief Advances the profile by one control tick (call from the control ISR)
+ * @retval None
+ */
+void Sequencer_Tick(void)
+{
+  if (state != SEQ_STATE_RUNNING)
+  {
+    return;
+  }
+
+  if (restartPending)
+  {
+    restartPending = 0;
+    StartSegment();
+  }
+
+  elapsedTicks++;
+  phaseTicks++;
+
+  if (!inDwell)
+  {
+    if (phaseTicks >= rampTicks)
+    {
+      currentMilliHz = (int32_t)segments[segmentIndex].targetMilliHz;
+      inDwell = 1;
+      phaseTicks = 0;
+      FreqControl_ApplyFrequencyMilliHz(targetAxis, (uint32_t)currentMilliHz);
+      if (dwellTicks == 0)
+      {
+        NextSegment();
+      }
+      return;
+    }
+    else
+    {
+      currentMilliHz += stepMilliHz;
+      remainderAcc += stepRemainder;
+      if (remainderAcc >= (int32_t)rampTicks)
+      {
+        remainderAcc -= (int32_t)rampTicks;
+        currentMilliHz++;
+      }
+      else if (remainderAcc <= -(int32_t)rampTicks)
+      {
+        remainderAcc += (int32_t)rampTicks;
+        currentMilliHz--;
+      }
+    }
+    FreqControl_ApplyFrequencyMilliHz(targetAxis, (uint32_t)currentMilliHz);
+  }
+  else if (phaseTicks >= dwellTicks)
+  {
+    NextSegment();
+  }
+}
+
+/**
+ * @brief Converts milliseconds to control ticks
+ * @retval Number of ticks
+ */
+static uint32_t MsToTicks(uint32_t ms)
+{
+  return (ms / 1000) * PWM_CONTROL_TICK_HZ + ((ms % 1000) * PWM_CONTROL_TICK_HZ) / 1000;
+}
+
+/**
+ * @brief Prepares the ramp of the current segment
+ * @retval None
+ */
+static void StartSegment(void)
+{
+  const SeqSegment_t* segment = &segments[segmentIndex];
+  int32_t delta;
+
+  rampTicks = MsToTicks(segment->rampMs);
+  dwellTicks = MsToTicks(segment->dwellMs);
+  phaseTicks = 0;
+  remainderAcc = 0;
+  currentMilliHz = (int32_t)FreqControl_GetFrequencyMilliHz(targetAxis);
+
+  if (rampTicks == 0)
+  {
+    /* Step change */
+    currentMilliHz = (int32_t)segment->targetMilliHz;
+    FreqControl_ApplyFrequencyMilliHz(targetAxis, segment->targetMilliHz);
+    inDwell = 1;
+    return;
+  }
+
+  delta = (int32_t)segment->targetMilliHz - currentMilliHz;
+  stepMilliHz = delta / (int32_t)rampTicks;
+  stepRemainder = delta % (int32_t)rampTicks;
+  inDwell = 0;
+}
+
+/**
+ * @brief Moves to the next segment, wrapping or finishing at the table end
+ * @retval None
+ */
+static void NextSegment(void)
+{
+  if (segmentIndex + 1 < segmentCount)
+  {
+    segmentIndex++;
+  }
+  else
+  {
+    loopsDone++;
+    if (loopCount != 0 && loopsDone >= loopCount)
+    {
+      state = SEQ_STATE_DONE;
+      return;
+    }
+    segmentIndex = 0;
+  }
+
+  StartSegment();
+}
@@ -0,0 +1,58 @@
+/**
+ * @file sequencer.h
+ * @brief Sequenciador de perfis de frequência (tempo x frequência)
+ */
+
+#ifndef __SEQUENCER_H
+#define __SEQUENCER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes */
+#include <stdint.h>
+
+/* Defines */
+#define SEQ_MAX_SEGMENTS   16
+#define SEQ_MAX_TIME_MS    3600000UL   /* 1 hour per ramp or dwell */
+
+/* Types */
+typedef struct {
+  uint32_t targetMilliHz;   /* Frequency reached at the end of the ramp */
+  uint32_t rampMs;          /* Linear ramp from the previous frequency */
+  uint32_t dwellMs;         /* Time held at the target */
+} SeqSegment_t;
+
+typedef enum {
+  SEQ_STATE_IDLE = 0,
+  SEQ_STATE_RUNNING,
+  SEQ_STATE_DONE
+} SeqState_t;
+
+typedef struct {
+  SeqState_t state;
+  uint8_t segment;          /* Current segment (0-based) */
+  uint8_t segmentCount;
+  uint8_t inDwell;          /* 0=ramping, 1=dwelling */
+  uint16_t loop;            /* Completed passes through the table */
+  uint16_t loopCount;       /* Requested passes (0=forever) */
+  uint32_t elapsedMs;       /* Since Sequencer_Start() */
+} SeqProgress_t;
+
+/* Public functions */
+void Sequencer_Init(void);
+void Sequencer_Clear(void);
+uint8_t Sequencer_AddSegment(uint32_t targetMilliHz, uint32_t rampMs, uint32_t dwellMs);
+void Sequencer_SetLoopCount(uint16_t loops);
+uint8_t Sequencer_Start(void);
+void Sequencer_Stop(void);
+uint8_t Sequencer_IsRunning(void);
+void Sequencer_GetProgress(SeqProgress_t* progress);
+void Sequencer_Tick(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SEQUENCER_H */
@@ -5,33 +5,240 @@
 
 #include "serial_comm.h"
 #include "freq_control.h"
+#include "pwm_control.h"
+#include "modbus_rtu.h"
+#include "adc_sense.h"
+#include "sequencer.h"
+#include "speed_control.h"
+#include "power_meter.h"
+#include "motor_comp.h"
+#include "ride_through.h"
+#include "fixed_text.h"
 #include <string.h>
-#include <stdlib.h>
-#include <stdio.h> // Para função sprintf
-#include <ctype.h> // Para funções toupper/tolower
+
+/* Private defines */
+#define GAP_TIMER_TICK_HZ      1000000UL  /* Gap timer counts microseconds */
+#define MODBUS_GAP_FIXED_US    1750UL     /* t3.5 for baud rates > 19200 */
+#define MODBUS_BITS_PER_CHAR   10UL       /* 8N1 */
+#define UPPER(c)               (((c) >= 'a' && (c) <= 'z') ? (c) - 'a' + 'A' : (c))
+
+/* A full ring holds two max-size frames, so one can be parsed while the next
+   arrives; the byte offsets wrap with the ring only for a power of 2 */
+#if SERIAL_RX_DMA_SIZE < 2 * MODBUS_MAX_ADU_SIZE || (SERIAL_RX_DMA_SIZE & (SERIAL_RX_DMA_SIZE - 1)) != 0
+#error "SERIAL_RX_DMA_SIZE must be a power of 2 of at least twice MODBUS_MAX_ADU_SIZE"
+#endif
+
+/* Private types */
+typedef struct {
+  uint16_t start;
+  uint16_t end;
+  uint32_t offset;                      /* Bytes received before the frame */
+  uint32_t rxTick;                      /* Control tick at the end of the frame */
+} FrameSpan_t;
+
+typedef struct {
+  const char* name;                     /* Upper case keyword */
+  uint8_t length;
+  void (*handler)(const char* args);    /* args: text after the keyword */
+} Command_t;
+
+typedef struct {
+  const Command_t* entries;
+  uint8_t count;
+  uint8_t* hashes;                      /* Filled by SerialComm_Init() */
+} CommandTable_t;
 
 /* Private variables */
+static const char* const stopModeNames[] = { "COAST", "RAMP", "DC", "RAMPDC" };
 static UART_HandleTypeDef* uartHandle;
+static TIM_HandleTypeDef* gapTimer;
+static SerialMode_t serialMode = SERIAL_MODE_ASCII;
 static uint8_t rxBuffer[SERIAL_BUFFER_SIZE];
-static uint8_t cmdBuffer[SERIAL_BUFFER_SIZE];
-static uint8_t rxIndex = 0;
-static uint8_t rxComplete = 0;
+
+/* ASCII mode: the UART ISR assembles each line in place in lineQueue[lineHead]
+   and publishes it by advancing lineHead; the main loop releases it by
+   advancing lineTail. A line is never written while the main loop reads it. */
+static uint8_t lineQueue[SERIAL_LINE_QUEUE_SIZE][SERIAL_BUFFER_SIZE];
+static volatile uint8_t lineHead = 0;     /* Written by the UART ISR */
+static volatile uint8_t lineTail = 0;     /* Written by the main loop */
+static uint32_t lineTicks[SERIAL_LINE_QUEUE_SIZE];  /* Control tick at each line end */
+static uint8_t lineLength = 0;            /* UART ISR only */
+static uint32_t commandTick;              /* Reception tick of the line being executed */
+static uint32_t droppedLines = 0;
+
+/* Modbus RTU framing */
+static uint8_t rxDmaBuffer[SERIAL_RX_DMA_SIZE];
+static uint8_t frameBuffer[MODBUS_MAX_ADU_SIZE];
+static uint8_t txBuffer[MODBUS_MAX_ADU_SIZE];
+static FrameSpan_t frameQueue[SERIAL_FRAME_QUEUE_SIZE];
+static volatile uint8_t queueHead = 0;    /* Written by the gap timer ISR */
+static volatile uint8_t queueTail = 0;    /* Written by the main loop */
+static volatile uint16_t idlePosition = 0;
+static volatile uint32_t rxOffset = 0;    /* Bytes up to the end of the last frame (gap timer ISR) */
+static uint32_t droppedFrames = 0;
+static uint32_t overrunFrames = 0;        /* Queued frames overwritten before they were read */
+static uint8_t exitPending = 0;
 
 /* Private function prototypes */
-static void ProcessCommand(void);
-static int str_case_compare(const char* s1, const char* s2);
+static void ProcessCommand(const char* line);
+static void ProcessModbusFrames(void);
+static uint16_t RxDmaPosition(void);
+static uint32_t RxBytesSince(uint32_t offset);
+static void ConfigureGapTimer(void);
+static uint8_t KeywordHash(const char* text, uint8_t length);
+static uint8_t KeywordEquals(const char* text, const char* name, uint8_t length);
+static uint8_t CountWords(const char* text);
+static FreqControl_t* ParseAxis(const char** args, uint8_t valueCount);
+static void SendAxisStatus(const FreqControl_t* axis);
+static void CmdFreq(const char* args);
+static void CmdStart(const char* args);
+static void CmdStop(const char* args);
+static void CmdStatus(const char* args);
+static void CmdStopMode(const char* args);
+static void CmdDecel(const char* args);
+static void CmdDcBrake(const char* args);
+static void CmdSync(const char* args);
+static void CmdTime(const char* args);
+static void CmdSpeed(const char* args);
+static void CmdSpeedPi(const char* args);
+static void SendSpeedStatus(void);
+static void CmdMeter(const char* args);
+static void CmdMotor(const char* args);
+static void CmdRide(const char* args);
+static void SendRideLog(void);
+static char* AppendSignedFixed(char* dst, int32_t value, uint8_t decimals);
+static char* AppendSigned(char* dst, int32_t value);
+static void SendSyncStatus(const FreqControl_t* axis);
+static const char* RunStateName(const FreqControl_t* axis);
+static void CmdModbus(const char* args);
+static void CmdHelp(const char* args);
+static void CmdProfile(const char* args);
+static void CmdProfileClear(const char* args);
+static void CmdProfileAdd(const char* args);
+static void CmdProfileLoop(const char* args);
+static void CmdProfileRun(const char* args);
+static void CmdProfileStop(const char* args);
+static void CmdProfileStatus(const char* args);
+static void HashCommandTable(const CommandTable_t* table);
+static uint8_t DispatchCommand(const CommandTable_t* table, const char* text);
+
+/* Command tables: matched by length and hash, then confirmed by comparison */
+#define COMMAND(name, handler)  { name, sizeof(name) - 1, handler }
+#define TABLE_SIZE(table)       (sizeof(table) / sizeof(table[0]))
+
+static const Command_t commandEntries[] = {
+  COMMAND("FREQ",     CmdFreq),
+  COMMAND("START",    CmdStart),
+  COMMAND("STOP",     CmdStop),
+  COMMAND("STATUS",   CmdStatus),
+  COMMAND("STOPMODE", CmdStopMode),
+  COMMAND("DECEL",    CmdDecel),
+  COMMAND("DCBRAKE",  CmdDcBrake),
+  COMMAND("SYNC",     CmdSync),
+  COMMAND("TIME",     CmdTime),
+  COMMAND("SPEED",    CmdSpeed),
+  COMMAND("SPEEDPI",  CmdSpeedPi),
+  COMMAND("METER",    CmdMeter),
+  COMMAND("MOTOR",    CmdMotor),
+  COMMAND("RIDE",     CmdRide),
+  COMMAND("PROFILE",  CmdProfile),
+  COMMAND("MODBUS",   CmdModbus),
+  COMMAND("HELP",     CmdHelp),
+};
+static uint8_t commandHashes[TABLE_SIZE(commandEntries)];
+static const CommandTable_t commandTable = {
+  commandEntries, TABLE_SIZE(commandEntries), commandHashes
+};
+
+static const Command_t profileEntries[] = {
+  COMMAND("CLEAR",  CmdProfileClear),
+  COMMAND("ADD",    CmdProfileAdd),
+  COMMAND("LOOP",   CmdProfileLoop),
+  COMMAND("RUN",    CmdProfileRun),
+  COMMAND("STOP",   CmdProfileStop),
+  COMMAND("STATUS", CmdProfileStatus),
+};
+static uint8_t profileHashes[TABLE_SIZE(profileEntries)];
+static const CommandTable_t profileTable = {
+  profileEntries, TABLE_SIZE(profileEntries), profileHashes
+};
 
 /**
  * @brief Initializes the serial communication module
  * @param huart Pointer to UART handle
+ * @param htimGap Pointer to the one-pulse timer used for the Modbus t3.5 gap
  * @retval None
  */
-void SerialComm_Init(UART_HandleTypeDef *huart)
+void SerialComm_Init(UART_HandleTypeDef *huart, TIM_HandleTypeDef *htimGap)
 {
   uartHandle = huart;
-  
+  gapTimer = htimGap;
+
+  HashCommandTable(&commandTable);
+  HashCommandTable(&profileTable);
+
+  ModbusRTU_Init(MODBUS_DEFAULT_ADDRESS);
+
   /* Start receiving data */
-  HAL_UART_Receive_IT(uartHandle, &rxBuffer[0], 1);
+  SerialComm_SetMode(SERIAL_MODE_ASCII);
+}
+
+/**
+ * @brief Selects the serial protocol
+ * @note ASCII mode receives byte by byte by interrupt; Modbus mode receives
+ *       into a circular DMA buffer and delimits frames by line silence
+ * @param mode SERIAL_MODE_ASCII or SERIAL_MODE_MODBUS
+ * @retval 0=success, 1=error
+ */
+uint8_t SerialComm_SetMode(SerialMode_t mode)
+{
+  /* Stop the current reception */
+  __HAL_UART_DISABLE_IT(uartHandle, UART_IT_IDLE);
+  HAL_UART_AbortReceive(uartHandle);
+  __HAL_TIM_DISABLE_IT(gapTimer, TIM_IT_UPDATE);
+  gapTimer->Instance->CR1 &= ~TIM_CR1_CEN;
+
+  lineHead = 0;
+  lineTail = 0;
+  lineLength = 0;
+  serialMode = mode;
+
+  if (mode == SERIAL_MODE_MODBUS)
+  {
+    queueHead = 0;
+    queueTail = 0;
+    rxOffset = 0;
+    idlePosition = 0;
+    exitPending = 0;
+
+    ConfigureGapTimer();
+    __HAL_TIM_CLEAR_FLAG(gapTimer, TIM_FLAG_UPDATE);
+    __HAL_TIM_ENABLE_IT(gapTimer, TIM_IT_UPDATE);
+    if (HAL_UART_Receive_DMA(uartHandle, rxDmaBuffer, SERIAL_RX_DMA_SIZE) != HAL_OK)
+    {
+      return 1;
+    }
+    __HAL_UART_CLEAR_IDLEFLAG(uartHandle);
+    __HAL_UART_ENABLE_IT(uartHandle, UART_IT_IDLE);
+  }
+  else
+  {
+    if (HAL_UART_Receive_IT(uartHandle, &rxBuffer[0], 1) != HAL_OK)
+    {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Gets the active serial protocol
+ * @retval Current mode
+ */
+SerialMode_t SerialComm_GetMode(void)
+{
+  return serialMode;
 }
 
 /**
@@ -40,12 +247,24 @@ void SerialComm_Init(UART_HandleTypeDef *huart)
  */
 void SerialComm_Process(void)
 {
-  /* Check if a complete command was received */
-  if (rxComplete)
+  if (serialMode == SERIAL_MODE_MODBUS)
+  {
+    ProcessModbusFrames();
+    return;
+  }
+
+  /* Execute the complete lines, oldest first; reception goes on meanwhile */
+  while (lineTail != lineHead)
   {
-    ProcessCommand();
-    rxComplete = 0;
-    rxIndex = 0;
+    __DMB();  /* Read the line only after seeing it published */
+    commandTick = lineTicks[lineTail];
+    ProcessCommand((const char*)lineQueue[lineTail]);
+    if (serialMode != SERIAL_MODE_ASCII)
+    {
+      return;  /* MODBUS command: the queue was reset by SerialComm_SetMode() */
+    }
+    __DMB();  /* Done with the line before handing the slot back */
+    lineTail = (lineTail + 1) % SERIAL_LINE_QUEUE_SIZE;
   }
 }
 
@@ -67,21 +286,39 @@ void SerialComm_SendResponse(const char* message)
  */
 void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
 {
-  if (huart->Instance == uartHandle->Instance)
+  /* In Modbus mode this is the circular DMA wrapping: nothing to do */
+  if (huart->Instance == uartHandle->Instance && serialMode == SERIAL_MODE_ASCII)
   {
-    /* Check for newline character */
+    uint8_t* line = lineQueue[lineHead];
+    uint8_t next;
+
+    /* Check for newline character (empty lines, e.g. CR LF, are skipped) */
     if (rxBuffer[0] == '\r' || rxBuffer[0] == '\n')
     {
-      /* Null-terminate the command string */
-      cmdBuffer[rxIndex] = 0;
-      rxComplete = 1;
+      if (lineLength > 0)
+      {
+        /* Null-terminate the command string, time-stamp and publish it */
+        line[lineLength] = 0;
+        lineTicks[lineHead] = FreqControl_GetTick();
+        lineLength = 0;
+        next = (lineHead + 1) % SERIAL_LINE_QUEUE_SIZE;
+        if (next == lineTail)
+        {
+          droppedLines++;  /* Queue full: the slot is reused for the next line */
+        }
+        else
+        {
+          __DMB();
+          lineHead = next;
+        }
+      }
     }
     else
     {
       /* Add character to command buffer */
-      if (rxIndex < SERIAL_BUFFER_SIZE - 1)
+      if (lineLength < SERIAL_BUFFER_SIZE - 1)
       {
-        cmdBuffer[rxIndex++] = rxBuffer[0];
+        line[lineLength++] = rxBuffer[0];
       }
     }
     
@@ -91,110 +328,1225 @@ void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
 }
 
 /**
- * @brief Compara duas strings sem diferenciar maiúsculas e minúsculas
- * @param s1 Primeira string
- * @param s2 Segunda string
- * @retval 0 se iguais, <0 se s1<s2, >0 se s1>s2
+ * @brief USART idle-line handling (call from the USART IRQ handler)
+ * @note One idle character time has elapsed: the gap timer measures the rest
+ *       of the 3.5 character inter-frame silence
+ * @retval None
  */
-static int str_case_compare(const char* s1, const char* s2)
+void SerialComm_UART_IRQHandler(void)
 {
-  if (s1 == NULL || s2 == NULL)
-    return s1 == s2 ? 0 : (s1 == NULL ? -1 : 1);
-    
-  while(*s1 && *s2) {
-    int c1 = tolower((unsigned char)*s1);
-    int c2 = tolower((unsigned char)*s2);
-    if (c1 != c2)
-      return c1 - c2;
-    s1++;
-    s2++;
+  if (__HAL_UART_GET_FLAG(uartHandle, UART_FLAG_IDLE))
+  {
+    __HAL_UART_CLEAR_IDLEFLAG(uartHandle);
+
+    if (serialMode == SERIAL_MODE_MODBUS)
+    {
+      idlePosition = RxDmaPosition();
+
+      /* (Re)start the one-pulse gap timer */
+      gapTimer->Instance->CNT = 0;
+      gapTimer->Instance->CR1 |= TIM_CR1_CEN;
+    }
+  }
+}
+
+/**
+ * @brief End of the inter-frame gap (call from the gap timer update callback)
+ * @retval None
+ */
+void SerialComm_GapTimerElapsed(void)
+{
+  uint16_t position = RxDmaPosition();
+  uint16_t frameStart = rxOffset % SERIAL_RX_DMA_SIZE;
+  uint8_t next;
+
+  /* Data arrived during the gap: the next idle line restarts the timer */
+  if (serialMode != SERIAL_MODE_MODBUS || position != idlePosition ||
+      position == frameStart)
+  {
+    return;
   }
-  
-  return tolower((unsigned char)*s1) - tolower((unsigned char)*s2);
+
+  next = (queueHead + 1) % SERIAL_FRAME_QUEUE_SIZE;
+  if (next == queueTail)
+  {
+    droppedFrames++;
+  }
+  else
+  {
+    frameQueue[queueHead].start = frameStart;
+    frameQueue[queueHead].end = position;
+    frameQueue[queueHead].offset = rxOffset;
+    frameQueue[queueHead].rxTick = FreqControl_GetTick();
+    queueHead = next;
+  }
+  rxOffset += (uint16_t)(position - frameStart) % SERIAL_RX_DMA_SIZE;
 }
 
-static void ProcessCommand(void)
+/**
+ * @brief Executes the queued Modbus frames and sends the responses
+ * @retval None
+ */
+static void ProcessModbusFrames(void)
 {
-  char* token;
-  char* rest = (char*)cmdBuffer;
-    /* Get the command type */  token = strtok(rest, " ");
-  
-  if (token != NULL)
+  uint16_t index, length, respLength;
+  uint32_t rxTick;
+
+  while (queueTail != queueHead)
   {
-    /* FREQ command - Set frequency */
-    if (str_case_compare(token, "FREQ") == 0)
+    /* Only one response can be in flight */
+    if (uartHandle->gState != HAL_UART_STATE_READY)
     {
-      token = strtok(NULL, " ");
-      if (token != NULL)
-      {
-        float frequency = atof(token);
-        if (FreqControl_SetFrequency(frequency) == 0)
-        {
-          SerialComm_SendResponse("OK");
-        }
-        else
-        {
-          SerialComm_SendResponse("ERROR: Invalid frequency value");
-        }
-      }
-      else
-      {
-        SerialComm_SendResponse("ERROR: Missing frequency value");
-      }
+      return;
     }
-    /* START command - Start inverter */
-    else if (str_case_compare(token, "START") == 0)
+
+    /* Copy the frame out of the ring (it may wrap around) */
+    index = frameQueue[queueTail].start;
+    length = 0;
+    while (index != frameQueue[queueTail].end && length < MODBUS_MAX_ADU_SIZE)
     {
-      if (FreqControl_Start() == 0)
-      {
-        SerialComm_SendResponse("Inverter started");
-      }
-      else
-      {
-        SerialComm_SendResponse("ERROR: Cannot start inverter");
-      }
+      frameBuffer[length++] = rxDmaBuffer[index];
+      index = (index + 1) % SERIAL_RX_DMA_SIZE;
     }
-    /* STOP command - Stop inverter */
-    else if (str_case_compare(token, "STOP") == 0)
+    rxTick = frameQueue[queueTail].rxTick;
+
+    /* The DMA keeps writing: drop the frame if it wrapped onto it */
+    if (RxBytesSince(frameQueue[queueTail].offset) > SERIAL_RX_DMA_SIZE)
     {
-      if (FreqControl_Stop() == 0)
-      {
-        SerialComm_SendResponse("Inverter stopped");
-      }
-      else
-      {
-        SerialComm_SendResponse("ERROR: Cannot stop inverter");
-      }
+      overrunFrames++;
+      queueTail = (queueTail + 1) % SERIAL_FRAME_QUEUE_SIZE;
+      continue;
     }
-    /* STATUS command - Get inverter status */
-    else if (str_case_compare(token, "STATUS") == 0)
+    queueTail = (queueTail + 1) % SERIAL_FRAME_QUEUE_SIZE;
+
+    respLength = ModbusRTU_HandleFrame(frameBuffer, length, txBuffer, rxTick);
+    if (respLength > 0)
     {
-      char statusMsg[64];
-      float currFreq = FreqControl_GetFrequency();
-      uint8_t isRunning = FreqControl_IsRunning();
-      
-      sprintf(statusMsg, "Status: %s, Frequency: %.1f Hz", 
-              isRunning ? "Running" : "Stopped", currFreq);
-      SerialComm_SendResponse(statusMsg);
+      HAL_UART_Transmit_DMA(uartHandle, txBuffer, respLength);
     }
-    /* HELP command - Show available commands */
-    else if (str_case_compare(token, "HELP") == 0)
+    if (ModbusRTU_TakeExitRequest())
     {
-      SerialComm_SendResponse("Available commands:");
-      SerialComm_SendResponse("  FREQ <value> - Set frequency in Hz (0.1-50.0)");
-      SerialComm_SendResponse("  START - Start inverter");
-      SerialComm_SendResponse("  STOP - Stop inverter");
-      SerialComm_SendResponse("  STATUS - Get inverter status");
-      SerialComm_SendResponse("  HELP - Show this help");
+      exitPending = 1;
     }
-    else
+  }
+
+  /* Return to ASCII only after the acknowledge has left the UART */
+  if (exitPending && uartHandle->gState == HAL_UART_STATE_READY)
+  {
+    SerialComm_SetMode(SERIAL_MODE_ASCII);
+  }
+}
+
+/**
+ * @brief Gets the write position of the circular reception DMA
+ * @retval Index of the next byte to be written in rxDmaBuffer
+ */
+static uint16_t RxDmaPosition(void)
+{
+  uint16_t position = SERIAL_RX_DMA_SIZE - __HAL_DMA_GET_COUNTER(uartHandle->hdmarx);
+
+  return position % SERIAL_RX_DMA_SIZE;
+}
+
+/**
+ * @brief Counts the bytes the reception DMA has written since an offset
+ * @note The bytes after the last frame are fewer than the ring size unless
+ *       the line carries no gap for a whole ring, which no valid frame does
+ * @param offset Byte offset of a queued frame (FrameSpan_t.offset)
+ * @retval Bytes written from the offset up to the DMA write position
+ */
+static uint32_t RxBytesSince(uint32_t offset)
+{
+  uint32_t lastEnd = rxOffset;
+  uint16_t pending = (uint16_t)(RxDmaPosition() - lastEnd) % SERIAL_RX_DMA_SIZE;
+
+  return lastEnd + pending - offset;
+}
+
+/**
+ * @brief Loads the gap timer with t3.5 minus the idle character
+ * @retval None
+ */
+static void ConfigureGapTimer(void)
+{
+  uint32_t baud = uartHandle->Init.BaudRate;
+  uint32_t charUs = (MODBUS_BITS_PER_CHAR * GAP_TIMER_TICK_HZ) / baud;
+  uint32_t gapUs = (baud > 19200) ? MODBUS_GAP_FIXED_US : (charUs * 7) / 2;
+
+  __HAL_TIM_SET_AUTORELOAD(gapTimer, gapUs - charUs);
+}
+
+/**
+ * @brief Hashes a keyword, case-insensitively
+ * @param text Pointer to the keyword
+ * @param length Number of characters
+ * @retval 8-bit hash
+ */
+static uint8_t KeywordHash(const char* text, uint8_t length)
+{
+  uint8_t hash = 0;
+
+  while (length--)
+  {
+    hash = (uint8_t)(hash * 31 + UPPER(*text));
+    text++;
+  }
+  return hash;
+}
+
+/**
+ * @brief Compares a keyword with a table entry, case-insensitively
+ * @retval 1 if equal
+ */
+static uint8_t KeywordEquals(const char* text, const char* name, uint8_t length)
+{
+  while (length--)
+  {
+    if (UPPER(*text) != *name)
+    {
+      return 0;
+    }
+    text++;
+    name++;
+  }
+  return 1;
+}
+
+/**
+ * @brief Computes the keyword hashes of a command table
+ * @retval None
+ */
+static void HashCommandTable(const CommandTable_t* table)
+{
+  uint8_t i;
+
+  for (i = 0; i < table->count; i++)
+  {
+    table->hashes[i] = KeywordHash(table->entries[i].name, table->entries[i].length);
+  }
+}
+
+/**
+ * @brief Runs the handler whose keyword starts the text
+ * @param table Command table
+ * @param text Keyword followed by its arguments
+ * @retval 0=handled, 1=unknown or empty keyword
+ */
+static uint8_t DispatchCommand(const CommandTable_t* table, const char* text)
+{
+  const char* keyword = FixedText_SkipSpaces(text);
+  const char* args = keyword;
+  uint8_t length;
+  uint8_t hash;
+  uint8_t i;
+
+  /* Keyword ends at the first blank; the arguments are parsed in place */
+  while (*args != '\0' && *args != ' ' && *args != '\t')
+  {
+    args++;
+  }
+  length = (uint8_t)(args - keyword);
+  if (length == 0)
+  {
+    return 1;
+  }
+
+  hash = KeywordHash(keyword, length);
+  for (i = 0; i < table->count; i++)
+  {
+    if (table->hashes[i] == hash && table->entries[i].length == length &&
+        KeywordEquals(keyword, table->entries[i].name, length))
+    {
+      table->entries[i].handler(FixedText_SkipSpaces(args));
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+/**
+ * @brief Counts blank-separated words
+ * @param text Pointer to text
+ * @retval Number of words
+ */
+static uint8_t CountWords(const char* text)
+{
+  uint8_t count = 0;
+
+  text = FixedText_SkipSpaces(text);
+  while (*text != '\0')
+  {
+    count++;
+    while (*text != '\0' && *text != ' ' && *text != '\t')
+    {
+      text++;
+    }
+    text = FixedText_SkipSpaces(text);
+  }
+  return count;
+}
+
+/**
+ * @brief Optional leading axis number ("[axis] <values>")
+ * @note The first word is taken as the axis only when the command has more
+ *       words than the values it expects, so "FREQ 30" keeps addressing
+ *       FREQ_AXIS_DEFAULT while "FREQ 2 30" addresses axis 2.
+ * @param args Pointer to the text pointer (advanced past the axis)
+ * @param valueCount Number of values the command expects after the axis
+ * @retval Axis, or NULL if the axis number is invalid
+ */
+static FreqControl_t* ParseAxis(const char** args, uint8_t valueCount)
+{
+  int32_t number;
+
+  if (CountWords(*args) <= valueCount)
+  {
+    return FreqControl_GetAxis(FREQ_AXIS_DEFAULT);
+  }
+  if (FixedText_ParseFixed(args, &number, 0) != 0 || number < 1 || number > FREQ_AXIS_COUNT)
+  {
+    return NULL;
+  }
+  return FreqControl_GetAxis((uint8_t)number);
+}
+
+static void ProcessCommand(const char* line)
+{
+  const char* text = FixedText_SkipSpaces(line);
+
+  if (*text != '\0' && DispatchCommand(&commandTable, text) != 0)
+  {
+    SerialComm_SendResponse("Unknown command. Type HELP for available commands");
+  }
+}
+
+/**
+ * @brief FREQ command - Set frequency
+ */
+static void CmdFreq(const char* args)
+{
+  /* "FREQ [axis] <Hz> AT <tick>": three words after the axis */
+  uint8_t scheduled = (CountWords(args) >= 3);
+  FreqControl_t* axis = ParseAxis(&args, scheduled ? 3 : 1);
+  int32_t freqMilliHz;
+  int32_t atTick = 0;
+
+  if (axis == NULL)
+  {
+    SerialComm_SendResponse("ERROR: Invalid axis");
+    return;
+  }
+  if (*FixedText_SkipSpaces(args) == '\0')
+  {
+    SerialComm_SendResponse("ERROR: Missing frequency value");
+    return;
+  }
+  if (FixedText_ParseFixed(&args, &freqMilliHz, 3) != 0 ||
+      freqMilliHz < (int32_t)FREQ_MIN_MHZ || freqMilliHz > (int32_t)FREQ_MAX_MHZ)
+  {
+    SerialComm_SendResponse("ERROR: Invalid frequency value");
+    return;
+  }
+  if (scheduled)
+  {
+    args = FixedText_SkipSpaces(args);
+    if (!KeywordEquals(args, "AT", 2) || (args[2] != ' ' && args[2] != '\t'))
+    {
+      SerialComm_SendResponse("ERROR: Use FREQ [axis] <Hz> AT <tick>");
+      return;
+    }
+    args += 2;
+    if (FixedText_ParseFixed(&args, &atTick, 0) != 0 || atTick < 0)
     {
-      SerialComm_SendResponse("Unknown command. Type HELP for available commands");
+      SerialComm_SendResponse("ERROR: Invalid tick");
+      return;
     }
   }
+
+  if (scheduled && !FreqControl_CanSchedule(axis, (uint32_t)atTick))
+  {
+    SerialComm_SendResponse("ERROR: Schedule full or out of order");
+    return;
+  }
+
+  /* A manual setpoint takes over from a profile or the speed loop driving
+     this axis; stop them first so their next tick cannot overwrite it */
+  if (axis->number == FREQ_AXIS_DEFAULT)
+  {
+    Sequencer_Stop();
+    SpeedControl_Disable();
+  }
+  if (!scheduled)
+  {
+    FreqControl_SetFrequencyMilliHz(axis, (uint32_t)freqMilliHz);
+  }
+  else
+  {
+    FreqControl_ScheduleFrequencyMilliHz(axis, (uint32_t)freqMilliHz, (uint32_t)atTick);
+  }
+  SerialComm_SendResponse("OK");
+}
+
+/**
+ * @brief START command - Start inverter
+ */
+static void CmdStart(const char* args)
+{
+  FreqControl_t* axis = ParseAxis(&args, 0);
+
+  if (axis == NULL)
+  {
+    SerialComm_SendResponse("ERROR: Invalid axis");
+  }
+  else if (FreqControl_Start(axis) == 0)
+  {
+    SerialComm_SendResponse("Inverter started");
+  }
+  else
+  {
+    SerialComm_SendResponse("ERROR: Cannot start inverter");
+  }
+}
+
+/**
+ * @brief STOP command - Stop inverter
+ */
+static void CmdStop(const char* args)
+{
+  FreqControl_t* axis = ParseAxis(&args, 0);
+
+  if (axis == NULL)
+  {
+    SerialComm_SendResponse("ERROR: Invalid axis");
+  }
+  else if (FreqControl_Stop(axis) == 0)
+  {
+    SerialComm_SendResponse(FreqControl_IsRunning(axis) ? "Inverter stopping" : "Inverter stopped");
+  }
+  else
+  {
+    SerialComm_SendResponse("ERROR: Cannot stop inverter");
+  }
+}
+
+/**
+ * @brief STATUS command - Get inverter status
+ * @note Without an axis: axis 1, PWM frames and bus lines, then one line per
+ *       additional axis. "STATUS <axis>" reports that axis only.
+ */
+static void CmdStatus(const char* args)
+{
+  FreqControl_t* axis = ParseAxis(&args, 0);
+  const FreqStopConfig_t* stop;
+  char statusMsg[80];
+  char* p;
+  uint8_t number;
+
+  if (axis == NULL)
+  {
+    SerialComm_SendResponse("ERROR: Invalid axis");
+    return;
+  }
+  if (axis->number != FREQ_AXIS_DEFAULT)
+  {
+    SendAxisStatus(axis);
+    return;
+  }
+
+  p = FixedText_AppendText(statusMsg, "Status: ");
+  p = FixedText_AppendText(p, RunStateName(axis));
+  p = FixedText_AppendText(p, ", Frequency: ");
+  p = FixedText_AppendFixed(p, (int32_t)((FreqControl_GetFrequencyMilliHz(axis) + 50) / 100), 1);
+  FixedText_AppendText(p, " Hz");
+  SerialComm_SendResponse(statusMsg);
+
+  stop = FreqControl_GetStopConfig(axis);
+  p = FixedText_AppendText(statusMsg, "Stop: ");
+  p = FixedText_AppendText(p, stopModeNames[stop->mode]);
+  p = FixedText_AppendText(p, ", Decel: ");
+  p = FixedText_AppendFixed(p, (int32_t)((stop->decelMilliHzPerS + 50) / 100), 1);
+  p = FixedText_AppendText(p, " Hz/s, DC: ");
+  p = FixedText_AppendFixed(p, stop->dcDutyPermille, 1);
+  p = FixedText_AppendText(p, "% ");
+  p = FixedText_AppendUint(p, stop->dcTimeMs);
+  p = FixedText_AppendText(p, " ms, Last: ");
+  p = FixedText_AppendUint(p, FreqControl_GetLastStopTimeMs(axis));
+  FixedText_AppendText(p, " ms");
+  SerialComm_SendResponse(statusMsg);
+
+  p = FixedText_AppendText(statusMsg, "PWM frames: ");
+  p = FixedText_AppendUint(p, PWMControl_GetCommitCount(&axis->pwm));
+  p = FixedText_AppendText(p, ", Late: ");
+  p = FixedText_AppendUint(p, PWMControl_GetMissedCommits(&axis->pwm));
+  p = FixedText_AppendText(p, ", Clipped: ");
+  FixedText_AppendUint(p, FreqControl_GetClippedTicks(axis));
+  SerialComm_SendResponse(statusMsg);
+
+  if (FreqControl_GetSync(axis)->compares != NULL)
+  {
+    SendSyncStatus(axis);
+  }
+
+  if (SpeedControl_IsAvailable())
+  {
+    SendSpeedStatus();
+  }
+
+  p = FixedText_AppendText(statusMsg, "Bus: ");
+  p = FixedText_AppendFixed(p, AdcSense_GetBusVoltage(), 1);
+  p = FixedText_AppendText(p, " V, Comp: ");
+  p = FixedText_AppendFixed(p, (int32_t)(((uint32_t)AdcSense_GetBusCompensation() * 1000 +
+                                          BUS_COMP_ONE_Q12 / 2) / BUS_COMP_ONE_Q12), 3);
+  SerialComm_SendResponse(statusMsg);
+
+  for (number = FREQ_AXIS_DEFAULT + 1; number <= FREQ_AXIS_COUNT; number++)
+  {
+    axis = FreqControl_GetAxis(number);
+    if (axis != NULL)
+    {
+      SendAxisStatus(axis);
+    }
+  }
+}
+
+/**
+ * @brief One-line status of an axis
+ * @param axis Axis to report
+ * @retval None
+ */
+static void SendAxisStatus(const FreqControl_t* axis)
+{
+  char statusMsg[80];
+  char* p;
+
+  p = FixedText_AppendText(statusMsg, "Axis ");
+  p = FixedText_AppendUint(p, axis->number);
+  p = FixedText_AppendText(p, ": ");
+  p = FixedText_AppendText(p, RunStateName(axis));
+  p = FixedText_AppendText(p, ", Frequency: ");
+  p = FixedText_AppendFixed(p, (int32_t)((FreqControl_GetFrequencyMilliHz(axis) + 50) / 100), 1);
+  p = FixedText_AppendText(p, " Hz, Late: ");
+  p = FixedText_AppendUint(p, PWMControl_GetMissedCommits(&axis->pwm));
+  p = FixedText_AppendText(p, ", Clip: ");
+  p = FixedText_AppendUint(p, FreqControl_GetClippedTicks(axis));
+  p = FixedText_AppendText(p, ", Last stop: ");
+  p = FixedText_AppendUint(p, FreqControl_GetLastStopTimeMs(axis));
+  FixedText_AppendText(p, " ms");
+  SerialComm_SendResponse(statusMsg);
+}
+
+/**
+ * @brief Synchronous PWM line of STATUS: cache size and hit state
+ * @note Hit = the DMA replays the cache, Ready = cache rendered, waiting for
+ *       the next zero crossing, Live = frames computed by the control tick
+ * @param axis Axis to report (with a cache)
+ * @retval None
+ */
+static void SendSyncStatus(const FreqControl_t* axis)
+{
+  const FreqSync_t* sync = FreqControl_GetSync(axis);
+  char statusMsg[80];
+  char* p;
+
+  p = FixedText_AppendText(statusMsg, "Sync: ");
+  p = FixedText_AppendText(p, sync->enabled ? "On" : "Off");
+  p = FixedText_AppendText(p, ", Cache: ");
+  if (sync->valid)
+  {
+    p = FixedText_AppendUint(p, sync->frames);
+    p = FixedText_AppendText(p, " frames/");
+    p = FixedText_AppendUint(p, sync->periods);
+    p = FixedText_AppendText(p, " turns");
+  }
+  else if (sync->enabled && sync->frames == 0 && sync->milliHz == axis->setpoint.milliHz)
+  {
+    p = FixedText_AppendText(p, "no fit");
+  }
+  else
+  {
+    p = FixedText_AppendText(p, "empty");
+  }
+  p = FixedText_AppendText(p, ", ");
+  if (FreqControl_IsSyncActive(axis))
+  {
+    p = FixedText_AppendText(p, "Hit");
+  }
+  else
+  {
+    p = FixedText_AppendText(p, sync->valid ? "Ready" : "Live");
+  }
+  p = FixedText_AppendText(p, ", Replayed: ");
+  FixedText_AppendUint(p, sync->replayedTicks);
+  SerialComm_SendResponse(statusMsg);
+}
+
+/**
+ * @brief Run state shown by STATUS
+ * @param axis Axis to report
+ * @retval "Running", "Stopping" or "Stopped"
+ */
+static const char* RunStateName(const FreqControl_t* axis)
+{
+  if (FreqControl_IsStopping(axis))
+  {
+    return "Stopping";
+  }
+  return FreqControl_IsRunning(axis) ? "Running" : "Stopped";
+}
+
+/**
+ * @brief STOPMODE command - Select how STOP stops the motor
+ */
+static void CmdStopMode(const char* args)
+{
+  FreqControl_t* axis = ParseAxis(&args, 1);
+  const char* word = FixedText_SkipSpaces(args);
+  uint8_t length = 0;
+  uint8_t mode;
+
+  if (axis == NULL)
+  {
+    SerialComm_SendResponse("ERROR: Invalid axis");
+    return;
+  }
+  while (word[length] != '\0' && word[length] != ' ' && word[length] != '\t')
+  {
+    length++;
+  }
+  for (mode = 0; mode < TABLE_SIZE(stopModeNames); mode++)
+  {
+    if (strlen(stopModeNames[mode]) == length && KeywordEquals(word, stopModeNames[mode], length))
+    {
+      FreqControl_SetStopMode(axis, (FreqStopMode_t)mode);
+      SerialComm_SendResponse("OK");
+      return;
+    }
+  }
+  SerialComm_SendResponse("ERROR: Use STOPMODE [axis] COAST|RAMP|DC|RAMPDC");
+}
+
+/**
+ * @brief DECEL command - Ramp-to-stop deceleration in Hz/s
+ */
+static void CmdDecel(const char* args)
+{
+  FreqControl_t* axis = ParseAxis(&args, 1);
+  int32_t milliHzPerS;
+
+  if (axis == NULL)
+  {
+    SerialComm_SendResponse("ERROR: Invalid axis");
+  }
+  else if (FixedText_ParseFixed(&args, &milliHzPerS, 3) == 0 && milliHzPerS > 0 &&
+           FreqControl_SetDecelRate(axis, (uint32_t)milliHzPerS) == 0)
+  {
+    SerialComm_SendResponse("OK");
+  }
+  else
+  {
+    SerialComm_SendResponse("ERROR: Use DECEL [axis] <Hz/s> (0.1-1000)");
+  }
+}
+
+/**
+ * @brief DCBRAKE command - DC injection level (% of bus) and time
+ */
+static void CmdDcBrake(const char* args)
+{
+  FreqControl_t* axis = ParseAxis(&args, 2);
+  int32_t dutyPermille, timeMs;
+
+  if (axis == NULL)
+  {
+    SerialComm_SendResponse("ERROR: Invalid axis");
+  }
+  else if (FixedText_ParseFixed(&args, &dutyPermille, 1) == 0 &&
+           FixedText_ParseFixed(&args, &timeMs, 0) == 0 &&
+           dutyPermille >= 0 && timeMs >= 0 && timeMs <= 0xFFFF &&
+           FreqControl_SetDcBrake(axis, (uint16_t)dutyPermille, (uint16_t)timeMs) == 0)
+  {
+    SerialComm_SendResponse("OK");
+  }
+  else
+  {
+    SerialComm_SendResponse("ERROR: Use DCBRAKE [axis] <duty %> <ms> (0-20.0, 0-10000)");
+  }
+}
+
+/**
+ * @brief SYNC command - Synchronous PWM (cached periods replayed by DMA)
+ */
+static void CmdSync(const char* args)
+{
+  FreqControl_t* axis = ParseAxis(&args, 1);
+  const char* word = FixedText_SkipSpaces(args);
+  uint8_t enable;
+
+  if (axis == NULL)
+  {
+    SerialComm_SendResponse("ERROR: Invalid axis");
+    return;
+  }
+  if (KeywordEquals(word, "ON", 2) && FixedText_SkipSpaces(word + 2)[0] == '\0')
+  {
+    enable = 1;
+  }
+  else if (KeywordEquals(word, "OFF", 3) && FixedText_SkipSpaces(word + 3)[0] == '\0')
+  {
+    enable = 0;
+  }
+  else
+  {
+    SerialComm_SendResponse("ERROR: Use SYNC [axis] ON|OFF");
+    return;
+  }
+
+  if (FreqControl_SetSync(axis, enable) == 0)
+  {
+    SerialComm_SendResponse("OK");
+  }
+  else
+  {
+    SerialComm_SendResponse("ERROR: No replay DMA on this axis");
+  }
+}
+
+/**
+ * @brief TIME command - Timebase report, or alignment on the master's tick
+ * @note "TIME <tick>" takes the tick as the timebase at the reception of the
+ *       line; "TIME" reports the timebase and the scheduled commits
+ */
+static void CmdTime(const char* args)
+{
+  const FreqSchedule_t* schedule;
+  const FreqControl_t* axis;
+  char statusMsg[80];
+  char* p;
+  int32_t tick;
+  uint8_t number;
+
+  if (*FixedText_SkipSpaces(args) != '\0')
+  {
+    if (FixedText_ParseFixed(&args, &tick, 0) != 0 || tick < 0)
+    {
+      SerialComm_SendResponse("ERROR: Use TIME [tick]");
+      return;
+    }
+    FreqControl_AlignTimebase((uint32_t)tick, commandTick);
+    SerialComm_SendResponse("OK");
+    return;
+  }
+
+  p = FixedText_AppendText(statusMsg, "Time: ");
+  p = FixedText_AppendUint(p, FreqControl_GetTimebase());
+  p = FixedText_AppendText(p, " ticks, Last align: ");
+  p = AppendSigned(p, FreqControl_GetLastAlignment());
+  SerialComm_SendResponse(statusMsg);
+
+  for (number = 1; number <= FREQ_AXIS_COUNT; number++)
+  {
+    axis = FreqControl_GetAxis(number);
+    if (axis == NULL)
+    {
+      continue;
+    }
+    schedule = FreqControl_GetSchedule(axis);
+    p = FixedText_AppendText(statusMsg, "Axis ");
+    p = FixedText_AppendUint(p, number);
+    p = FixedText_AppendText(p, " queued: ");
+    p = FixedText_AppendUint(p, FreqControl_GetScheduledCount(axis));
+    p = FixedText_AppendText(p, ", Commits: ");
+    p = FixedText_AppendUint(p, schedule->commits);
+    p = FixedText_AppendText(p, ", Last: ");
+    p = AppendSigned(p, schedule->lastLateness);
+    p = FixedText_AppendText(p, ", Worst: ");
+    AppendSigned(p, schedule->worstLateness);
+    SerialComm_SendResponse(statusMsg);
+  }
+}
+
+/**
+ * @brief SPEED command - Closed-loop speed from the encoder, or OFF
+ * @note Encoder builds only (SPEED_ENCODER_ENABLE); the loop drives axis 1
+ */
+static void CmdSpeed(const char* args)
+{
+  const char* word = FixedText_SkipSpaces(args);
+  int32_t setpointDrpm;
+
+  if (!SpeedControl_IsAvailable())
+  {
+    SerialComm_SendResponse("ERROR: No encoder in this build");
+    return;
+  }
+  if (KeywordEquals(word, "OFF", 3) && FixedText_SkipSpaces(word + 3)[0] == '\0')
+  {
+    SpeedControl_Disable();
+    SerialComm_SendResponse("OK");
+    return;
+  }
+  if (FixedText_ParseFixed(&args, &setpointDrpm, 1) != 0 ||
+      *FixedText_SkipSpaces(args) != '\0' || setpointDrpm < 1 || setpointDrpm > SPEED_MAX_DRPM)
+  {
+    SerialComm_SendResponse("ERROR: Use SPEED <rpm>|OFF (0.1-3000)");
+    return;
+  }
+
+  /* The loop takes over the frequency reference from a running profile */
+  Sequencer_Stop();
+  SpeedControl_SetSpeed(setpointDrpm);
+  SerialComm_SendResponse("OK");
+}
+
+/**
+ * @brief SPEEDPI command - Speed loop gains, reported without arguments
+ */
+static void CmdSpeedPi(const char* args)
+{
+  const SpeedLoop_t* loop = SpeedControl_GetState();
+  int32_t kp, ki;
+  char statusMsg[48];
+  char* p;
+
+  if (*FixedText_SkipSpaces(args) == '\0')
+  {
+    p = FixedText_AppendText(statusMsg, "Kp: ");
+    p = FixedText_AppendFixed(p, loop->kpMilliHz, 3);
+    p = FixedText_AppendText(p, " Hz/rpm, Ki: ");
+    p = FixedText_AppendFixed(p, loop->kiMilliHz, 3);
+    FixedText_AppendText(p, " Hz/s/rpm");
+    SerialComm_SendResponse(statusMsg);
+    return;
+  }
+  if (FixedText_ParseFixed(&args, &kp, 3) == 0 && FixedText_ParseFixed(&args, &ki, 3) == 0 &&
+      *FixedText_SkipSpaces(args) == '\0' && kp >= 0 && ki >= 0 &&
+      SpeedControl_SetGains((uint16_t)(kp > 0xFFFF ? 0xFFFF : kp),
+                            (uint16_t)(ki > 0xFFFF ? 0xFFFF : ki)) == 0)
+  {
+    SerialComm_SendResponse("OK");
+  }
+  else
+  {
+    SerialComm_SendResponse("ERROR: Use SPEEDPI <Kp> <Ki> (0-10.000)");
+  }
+}
+
+/**
+ * @brief Speed line of STATUS: requested and measured speed, PI correction
+ * @retval None
+ */
+static void SendSpeedStatus(void)
+{
+  const SpeedLoop_t* loop = SpeedControl_GetState();
+  char statusMsg[80];
+  char* p;
+
+  p = FixedText_AppendText(statusMsg, "Speed: ");
+  p = FixedText_AppendText(p, loop->enabled ? "On" : "Off");
+  p = FixedText_AppendText(p, ", Set ");
+  p = FixedText_AppendFixed(p, loop->setpointDrpm, 1);
+  p = FixedText_AppendText(p, ", Meas ");
+  p = FixedText_AppendFixed(p, loop->measuredDrpm, 1);
+  p = FixedText_AppendText(p, " rpm, Trim ");
+  p = AppendSignedFixed(p, loop->trimMilliHz, 3);
+  p = FixedText_AppendText(p, " Hz");
+  if (loop->saturated)
+  {
+    FixedText_AppendText(p, ", Sat");
+  }
+  SerialComm_SendResponse(statusMsg);
+}
+
+/**
+ * @brief METER command - Phase currents, power and energy of the last
+ *        electrical cycles; "METER RESET" clears the energy
+ */
+static void CmdMeter(const char* args)
+{
+  const PowerReading_t* meter = PowerMeter_GetReading();
+  const char* word = FixedText_SkipSpaces(args);
+  char statusMsg[96];
+  char* p;
+
+  if (KeywordEquals(word, "RESET", 5) && FixedText_SkipSpaces(word + 5)[0] == '\0')
+  {
+    PowerMeter_ResetEnergy();
+    SerialComm_SendResponse("OK");
+    return;
+  }
+  if (*word != '\0')
+  {
+    SerialComm_SendResponse("ERROR: Use METER [RESET]");
+    return;
+  }
+
+  p = FixedText_AppendText(statusMsg, "Current: U ");
+  p = FixedText_AppendFixed(p, (int32_t)meter->currentMilliA[0], 3);
+  p = FixedText_AppendText(p, ", V ");
+  p = FixedText_AppendFixed(p, (int32_t)meter->currentMilliA[1], 3);
+  p = FixedText_AppendText(p, ", W ");
+  p = FixedText_AppendFixed(p, (int32_t)meter->currentMilliA[2], 3);
+  FixedText_AppendText(p, " A rms");
+  SerialComm_SendResponse(statusMsg);
+
+  /* mW to 0.1 W, mJ to mWh */
+  p = FixedText_AppendText(statusMsg, "Power: ");
+  p = AppendSignedFixed(p, meter->powerMilliW / 100, 1);
+  p = FixedText_AppendText(p, " W, Energy: ");
+  p = AppendSignedFixed(p, (int32_t)(meter->energyMilliJ / 3600), 3);
+  FixedText_AppendText(p, " Wh");
+  SerialComm_SendResponse(statusMsg);
+
+  p = FixedText_AppendText(statusMsg, "Window: ");
+  p = FixedText_AppendUint(p, meter->windowMs);
+  p = FixedText_AppendText(p, " ms, ");
+  p = FixedText_AppendUint(p, meter->samples);
+  p = FixedText_AppendText(p, " samples, ");
+  p = FixedText_AppendUint(p, meter->skipped);
+  p = FixedText_AppendText(p, " skipped, Cycles: ");
+  p = FixedText_AppendUint(p, meter->cycles);
+  p = FixedText_AppendText(p, ", Dropped: ");
+  FixedText_AppendUint(p, meter->dropped);
+  SerialComm_SendResponse(statusMsg);
+}
+
+/**
+ * @brief MOTOR command - Motor data for the load compensation (Rs, rated
+ *        slip and current); without arguments, the applied compensation
+ */
+static void CmdMotor(const char* args)
+{
+  const MotorComp_t* motor = MotorComp_GetState();
+  int32_t rs, slip, rated;
+  char statusMsg[80];
+  char* p;
+
+  if (*FixedText_SkipSpaces(args) == '\0')
+  {
+    p = FixedText_AppendText(statusMsg, "Motor: Rs ");
+    p = FixedText_AppendFixed(p, (int32_t)motor->rsMilliOhm, 3);
+    p = FixedText_AppendText(p, " ohm, Slip ");
+    p = FixedText_AppendFixed(p, (int32_t)motor->slipMilliHz, 3);
+    p = FixedText_AppendText(p, " Hz at ");
+    p = FixedText_AppendFixed(p, (int32_t)motor->ratedMilliA, 3);
+    FixedText_AppendText(p, " A");
+    SerialComm_SendResponse(statusMsg);
+
+    /* Boost Q12 to 0.1 % */
+    p = FixedText_AppendText(statusMsg, "Comp: Active ");
+    p = AppendSignedFixed(p, motor->activeMilliA, 3);
+    p = FixedText_AppendText(p, " A, Boost +");
+    p = FixedText_AppendFixed(p, ((int32_t)motor->boostQ12 * 1000) / BUS_COMP_ONE_Q12, 1);
+    p = FixedText_AppendText(p, "%, Slip ");
+    p = AppendSignedFixed(p, motor->compSlipMilliHz, 3);
+    FixedText_AppendText(p, " Hz");
+    SerialComm_SendResponse(statusMsg);
+    return;
+  }
+  if (FixedText_ParseFixed(&args, &rs, 3) == 0 && FixedText_ParseFixed(&args, &slip, 3) == 0 &&
+      FixedText_ParseFixed(&args, &rated, 3) == 0 && *FixedText_SkipSpaces(args) == '\0' &&
+      rs >= 0 && slip >= 0 && rated >= 0 &&
+      MotorComp_SetParameters((uint32_t)rs, (uint32_t)slip, (uint32_t)rated) == 0)
+  {
+    SerialComm_SendResponse("OK");
+  }
+  else
+  {
+    SerialComm_SendResponse("ERROR: Use MOTOR <Rs ohm> <slip Hz> <rated A>");
+  }
+}
+
+/**
+ * @brief RIDE command - Mains dip ride-through: on/off, levels, log reset;
+ *        without arguments, the state and the dip log
+ */
+static void CmdRide(const char* args)
+{
+  static const char* const stateNames[] = { "Idle", "Dip", "Recover" };
+  const RideThrough_t* ride = RideThrough_GetState();
+  const char* word = FixedText_SkipSpaces(args);
+  int32_t dipDv, returnDv;
+  char statusMsg[80];
+  char* p;
+
+  if (KeywordEquals(word, "ON", 2) && FixedText_SkipSpaces(word + 2)[0] == '\0')
+  {
+    RideThrough_SetEnabled(1);
+    SerialComm_SendResponse("OK");
+    return;
+  }
+  if (KeywordEquals(word, "OFF", 3) && FixedText_SkipSpaces(word + 3)[0] == '\0')
+  {
+    RideThrough_SetEnabled(0);
+    SerialComm_SendResponse("OK");
+    return;
+  }
+  if (KeywordEquals(word, "RESET", 5) && FixedText_SkipSpaces(word + 5)[0] == '\0')
+  {
+    RideThrough_ClearLog();
+    SerialComm_SendResponse("OK");
+    return;
+  }
+  if (*word != '\0')
+  {
+    if (FixedText_ParseFixed(&args, &dipDv, 1) == 0 && FixedText_ParseFixed(&args, &returnDv, 1) == 0 &&
+        *FixedText_SkipSpaces(args) == '\0' && dipDv >= 0 && dipDv <= 0xFFFF &&
+        returnDv >= 0 && returnDv <= 0xFFFF &&
+        RideThrough_SetLevels((uint16_t)dipDv, (uint16_t)returnDv) == 0)
+    {
+      SerialComm_SendResponse("OK");
+    }
+    else
+    {
+      SerialComm_SendResponse("ERROR: Use RIDE ON|OFF|RESET|<dip V> <return V>");
+    }
+    return;
+  }
+
+  p = FixedText_AppendText(statusMsg, "Ride: ");
+  p = FixedText_AppendText(p, ride->enabled ? "On" : "Off");
+  p = FixedText_AppendText(p, ", Dip ");
+  p = FixedText_AppendFixed(p, ride->dipDv, 1);
+  p = FixedText_AppendText(p, " V, Return ");
+  p = FixedText_AppendFixed(p, ride->returnDv, 1);
+  p = FixedText_AppendText(p, " V, ");
+  p = FixedText_AppendText(p, stateNames[ride->state]);
+  if (ride->state != RIDE_STATE_IDLE)
+  {
+    p = FixedText_AppendText(p, " at ");
+    p = FixedText_AppendFixed(p, (int32_t)ride->limitMilliHz, 3);
+    FixedText_AppendText(p, " Hz");
+  }
+  SerialComm_SendResponse(statusMsg);
+  SendRideLog();
+}
+
+/**
+ * @brief Dip log line of RIDE: count, last and longest dip, minimums
+ * @retval None
+ */
+static void SendRideLog(void)
+{
+  const RideThrough_t* ride = RideThrough_GetState();
+  char statusMsg[112];
+  char* p;
+
+  p = FixedText_AppendText(statusMsg, "Dips: ");
+  p = FixedText_AppendUint(p, ride->dips);
+  p = FixedText_AppendText(p, ", Last ");
+  p = FixedText_AppendUint(p, ride->lastDipMs);
+  p = FixedText_AppendText(p, " ms, Longest ");
+  p = FixedText_AppendUint(p, ride->longestDipMs);
+  p = FixedText_AppendText(p, " ms, Min ");
+  p = FixedText_AppendFixed(p, ride->lastMinBusDv, 1);
+  p = FixedText_AppendText(p, " V ");
+  p = FixedText_AppendFixed(p, (int32_t)ride->lastMinMilliHz, 3);
+  p = FixedText_AppendText(p, " Hz, Exhausted ");
+  FixedText_AppendUint(p, ride->exhausted);
+  SerialComm_SendResponse(statusMsg);
+}
+
+/**
+ * @brief Appends a fixed-point value with an explicit sign ("+0.250", "-1.5")
+ * @retval Pointer to the terminator
+ */
+static char* AppendSignedFixed(char* dst, int32_t value, uint8_t decimals)
+{
+  if (value >= 0)
+  {
+    *dst++ = '+';
+  }
+  return FixedText_AppendFixed(dst, value, decimals);
+}
+
+/**
+ * @brief Appends a tick count with an explicit sign ("+0", "+3", "-2")
+ * @retval Pointer to the terminator
+ */
+static char* AppendSigned(char* dst, int32_t value)
+{
+  if (value >= 0)
+  {
+    *dst++ = '+';
+  }
+  return FixedText_AppendInt(dst, value);
+}
+
+/**
+ * @brief MODBUS command - Switch to Modbus RTU slave mode
+ */
+static void CmdModbus(const char* args)
+{
+  int32_t address;
+
+  if (FixedText_ParseFixed(&args, &address, 0) == 0 &&
+      address > 0 && address <= MODBUS_MAX_ADDRESS &&
+      ModbusRTU_SetAddress((uint8_t)address) == 0)
+  {
+    SerialComm_SendResponse("OK");
+    SerialComm_SetMode(SERIAL_MODE_MODBUS);
+  }
+  else
+  {
+    SerialComm_SendResponse("ERROR: Invalid Modbus address (1-247)");
+  }
+}
+
+/**
+ * @brief HELP command - Show available commands
+ */
+static void CmdHelp(const char* args)
+{
+  (void)args;
+  SerialComm_SendResponse("Available commands:");
+  SerialComm_SendResponse("  FREQ [axis] <value> [AT <tick>] - Set frequency in Hz (0.1-50.0)");
+  SerialComm_SendResponse("  START [axis] - Start inverter");
+  SerialComm_SendResponse("  STOP [axis] - Stop inverter");
+  SerialComm_SendResponse("  STATUS [axis] - Get inverter status");
+  SerialComm_SendResponse("  STOPMODE [axis] COAST|RAMP|DC|RAMPDC - Select stop mode");
+  SerialComm_SendResponse("  DECEL [axis] <Hz/s> - Ramp-to-stop deceleration");
+  SerialComm_SendResponse("  DCBRAKE [axis] <duty %> <ms> - DC injection braking");
+  SerialComm_SendResponse("  SYNC [axis] ON|OFF - Synchronous PWM from a cached period");
+  SerialComm_SendResponse("  TIME [tick] - Timebase and scheduled commits / align timebase");
+  SerialComm_SendResponse("  SPEED <rpm>|OFF - Closed-loop speed from the encoder");
+  SerialComm_SendResponse("  SPEEDPI [<Kp Hz/rpm> <Ki Hz/s/rpm>] - Speed loop gains");
+  SerialComm_SendResponse("  METER [RESET] - Phase currents, power and energy / clear energy");
+  SerialComm_SendResponse("  MOTOR [<Rs ohm> <slip Hz> <rated A>] - Load compensation (IR boost, slip)");
+  SerialComm_SendResponse("  RIDE [ON|OFF|RESET|<dip V> <return V>] - Mains dip ride-through and log");
+  SerialComm_SendResponse("  PROFILE CLEAR|ADD <Hz> <ramp ms> <dwell ms>|LOOP <n>|RUN|STOP|STATUS");
+  SerialComm_SendResponse("  MODBUS <addr> - Switch to Modbus RTU slave (1-247)");
+  SerialComm_SendResponse("  HELP - Show this help");
+}
+
+/**
+ * @brief PROFILE command - Frequency profile sequencer
+ */
+static void CmdProfile(const char* args)
+{
+  if (DispatchCommand(&profileTable, args) != 0)
+  {
+    SerialComm_SendResponse("ERROR: Use PROFILE CLEAR|ADD|LOOP|RUN|STOP|STATUS");
+  }
+}
+
+/**
+ * @brief PROFILE CLEAR - Remove all segments
+ */
+static void CmdProfileClear(const char* args)
+{
+  (void)args;
+  if (Sequencer_IsRunning())
+  {
+    SerialComm_SendResponse("ERROR: Profile running");
+    return;
+  }
+  Sequencer_Clear();
+  SerialComm_SendResponse("OK");
+}
+
+/**
+ * @brief PROFILE ADD <Hz> <ramp ms> <dwell ms> - Append a segment
+ */
+static void CmdProfileAdd(const char* args)
+{
+  int32_t freqMilliHz, rampMs, dwellMs;
+
+  if (FixedText_ParseFixed(&args, &freqMilliHz, 3) != 0 ||
+      FixedText_ParseFixed(&args, &rampMs, 0) != 0 ||
+      FixedText_ParseFixed(&args, &dwellMs, 0) != 0 ||
+      freqMilliHz < 0 || rampMs < 0 || dwellMs < 0)
+  {
+    SerialComm_SendResponse("ERROR: Use PROFILE ADD <Hz> <ramp ms> <dwell ms>");
+  }
+  else if (Sequencer_AddSegment((uint32_t)freqMilliHz, (uint32_t)rampMs, (uint32_t)dwellMs) != 0)
+  {
+    SerialComm_SendResponse("ERROR: Invalid segment, table full or profile running");
+  }
+  else
+  {
+    SerialComm_SendResponse("OK");
+  }
+}
+
+/**
+ * @brief PROFILE LOOP <n> - Number of passes (0 = forever)
+ */
+static void CmdProfileLoop(const char* args)
+{
+  int32_t loops;
+
+  if (FixedText_ParseFixed(&args, &loops, 0) != 0 || loops < 0 || loops > 0xFFFF)
+  {
+    SerialComm_SendResponse("ERROR: Use PROFILE LOOP <0-65535> (0 = forever)");
+    return;
+  }
+  Sequencer_SetLoopCount((uint16_t)loops);
+  SerialComm_SendResponse("OK");
+}
+
+/**
+ * @brief PROFILE RUN - Start playback (starts axis FREQ_AXIS_DEFAULT if stopped)
+ */
+static void CmdProfileRun(const char* args)
+{
+  (void)args;
+  SpeedControl_Disable();
+  if (Sequencer_Start() != 0)
+  {
+    SerialComm_SendResponse("ERROR: Empty profile");
+    return;
+  }
+  FreqControl_Start(FreqControl_GetAxis(FREQ_AXIS_DEFAULT));
+  SerialComm_SendResponse("OK");
+}
+
+/**
+ * @brief PROFILE STOP - Stop playback, holding the current frequency
+ */
+static void CmdProfileStop(const char* args)
+{
+  (void)args;
+  Sequencer_Stop();
+  SerialComm_SendResponse("OK");
+}
+
+/**
+ * @brief PROFILE STATUS - Report playback progress
+ */
+static void CmdProfileStatus(const char* args)
+{
+  static const char* const stateNames[] = { "Idle", "Running", "Done" };
+  SeqProgress_t progress;
+  char statusMsg[SERIAL_BUFFER_SIZE];
+  char* p;
+
+  (void)args;
+  Sequencer_GetProgress(&progress);
+
+  p = FixedText_AppendText(statusMsg, "Profile: ");
+  p = FixedText_AppendText(p, stateNames[progress.state]);
+  p = FixedText_AppendText(p, ", Segment ");
+  p = FixedText_AppendUint(p, progress.segmentCount ? progress.segment + 1u : 0u);
+  p = FixedText_AppendText(p, "/");
+  p = FixedText_AppendUint(p, progress.segmentCount);
+  p = FixedText_AppendText(p, progress.inDwell ? " dwell" : " ramp");
+  SerialComm_SendResponse(statusMsg);
+
+  p = FixedText_AppendText(statusMsg, "Loop ");
+  p = FixedText_AppendUint(p, progress.loop);
+  p = FixedText_AppendText(p, "/");
+  p = progress.loopCount ? FixedText_AppendUint(p, progress.loopCount)
+                         : FixedText_AppendText(p, "inf");
+  p = FixedText_AppendText(p, ", Elapsed: ");
+  p = FixedText_AppendUint(p, progress.elapsedMs);
+  p = FixedText_AppendText(p, " ms, Frequency: ");
+  p = FixedText_AppendFixed(p, (int32_t)FreqControl_GetFrequencyMilliHz(FreqControl_GetAxis(FREQ_AXIS_DEFAULT)), 3);
+  FixedText_AppendText(p, " Hz");
+  SerialComm_SendResponse(statusMsg);
 }
 
 // Função para checar se um comando foi recebido
 uint8_t SerialComm_HasReceivedCommand(void) {
-    return rxComplete;
+    return lineHead != lineTail;
 }
@@ -15,12 +15,25 @@ extern "C" {
 #include <stdint.h>
 
 /* Defines */
-#define SERIAL_BUFFER_SIZE 64
+#define SERIAL_BUFFER_SIZE      64
+#define SERIAL_RX_DMA_SIZE      512   /* Circular DMA buffer (Modbus mode), power of 2, >= 2 ADUs */
+#define SERIAL_FRAME_QUEUE_SIZE 4     /* Received frames awaiting processing */
+#define SERIAL_LINE_QUEUE_SIZE  4     /* Received command lines awaiting processing */
+
+/* Types */
+typedef enum {
+  SERIAL_MODE_ASCII = 0,   /* Text commands (FREQ, START, ...) */
+  SERIAL_MODE_MODBUS       /* Modbus RTU slave */
+} SerialMode_t;
 
 /* Public functions */
-void SerialComm_Init(UART_HandleTypeDef *huart);
+void SerialComm_Init(UART_HandleTypeDef *huart, TIM_HandleTypeDef *htimGap);
 void SerialComm_Process(void);
 void SerialComm_SendResponse(const char* message);
+uint8_t SerialComm_SetMode(SerialMode_t mode);
+SerialMode_t SerialComm_GetMode(void);
+void SerialComm_UART_IRQHandler(void);
+void SerialComm_GapTimerElapsed(void);
 // Função para checar se um comando foi recebido
 uint8_t SerialComm_HasReceivedCommand(void);
 
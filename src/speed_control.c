@@ -0,0 +1,284 @@
+/**
+ * @file speed_control.c
+ * @brief Implementação da malha de velocidade (encoder, estimador M/T e PI)
+ *
+ * The encoder timer (TIM3 in encoder mode, x4 decoding) counts by itself;
+ * the control tick reads it once per tick. Speed is estimated with an M/T
+ * window: the window ends on the last tick that saw an edge, so it spans a
+ * whole number of counts over a measured number of ticks. At speed the
+ * window is the PI period (pure M method); at low speed it stretches until
+ * SPEED_MT_MIN_COUNTS counts arrive (T method), up to SPEED_MT_MAX_TICKS.
+ * Edges are timed to the control tick: while TIM3 decodes the encoder the
+ * F030 has no capture path left for them.
+ *
+ * Every SPEED_LOOP_DIVIDER ticks the PI loop trims the frequency reference
+ * of the axis: synchronous frequency of the speed setpoint plus a correction
+ * limited to SPEED_TRIM_MAX_MHZ (the slip range). The integrator is held
+ * while the output is at a limit and the error pushes further (conditional
+ * integration). All integer, one 64-bit division per closed window.
+ */
+
+#include "speed_control.h"
+
+/* Private defines */
+#define ENCODER_COUNTS_PER_REV  (4UL * SPEED_ENCODER_PPR)
+#define SPEED_LOOP_HZ           (PWM_CONTROL_TICK_HZ / SPEED_LOOP_DIVIDER)
+#define INTEGRAL_SCALE          (10L * SPEED_LOOP_HZ)   /* 0.1 rpm error, per loop step */
+#define DEFAULT_KP_MHZ          20      /* 0.020 Hz per rpm */
+#define DEFAULT_KI_MHZ          200     /* 0.200 Hz/s per rpm */
+
+/* Private variables */
+static TIM_HandleTypeDef* encoderTimer = NULL;
+static FreqControl_t* targetAxis;
+static SpeedLoop_t speedLoop;
+
+/* Control tick only */
+static uint16_t lastCount;
+static int32_t windowCounts;            /* Counts since the window start */
+static uint32_t windowTicks;
+static int32_t edgeCounts;              /* windowCounts at the last tick with an edge */
+static uint32_t edgeTicks;
+static uint8_t loopTicks;
+static int32_t integral;                /* mHz * INTEGRAL_SCALE */
+
+/* Private function prototypes */
+static void EstimateSpeed(void);
+static int32_t CountsToDrpm(int32_t counts, uint32_t ticks);
+static void RunLoop(void);
+
+/**
+ * @brief Initializes the speed loop (open loop until a speed is set)
+ * @param encoder Timer in encoder mode, already started; NULL if the
+ *        build has no encoder (the loop is then unavailable)
+ * @param axis Axis whose frequency reference the loop trims
+ * @retval None
+ */
+void SpeedControl_Init(TIM_HandleTypeDef *encoder, FreqControl_t *axis)
+{
+  encoderTimer = encoder;
+  targetAxis = axis;
+
+  speedLoop.enabled = 0;
+  speedLoop.setpointDrpm = 0;
+  speedLoop.measuredDrpm = 0;
+  speedLoop.trimMilliHz = 0;
+  speedLoop.kpMilliHz = DEFAULT_KP_MHZ;
+  speedLoop.kiMilliHz = DEFAULT_KI_MHZ;
+  speedLoop.saturated = 0;
+
+  lastCount = (encoderTimer != NULL) ? (uint16_t)encoderTimer->Instance->CNT : 0;
+  windowCounts = 0;
+  windowTicks = 0;
+  edgeCounts = 0;
+  edgeTicks = 0;
+  loopTicks = 0;
+  integral = 0;
+}
+
+/**
+ * @brief Checks if the build has an encoder
+ * @retval 1 if the speed loop can be used
+ */
+uint8_t SpeedControl_IsAvailable(void)
+{
+  return encoderTimer != NULL && targetAxis != NULL;
+}
+
+/**
+ * @brief Sets the speed setpoint and closes the loop
+ * @note The loop takes over the frequency reference of the axis; FREQ,
+ *       Modbus and profiles hand it back with SpeedControl_Disable()
+ * @param setpointDrpm Speed in 0.1 rpm (1 to SPEED_MAX_DRPM)
+ * @retval 0=success, 1=error (no encoder or out of range)
+ */
+uint8_t SpeedControl_SetSpeed(int32_t setpointDrpm)
+{
+  if (!SpeedControl_IsAvailable() || setpointDrpm < 1 || setpointDrpm > SPEED_MAX_DRPM)
+  {
+    return 1;
+  }
+  speedLoop.setpointDrpm = setpointDrpm;
+  speedLoop.enabled = 1;
+  return 0;
+}
+
+/**
+ * @brief Opens the loop; the axis keeps its current frequency
+ * @retval None
+ */
+void SpeedControl_Disable(void)
+{
+  speedLoop.enabled = 0;
+}
+
+/**
+ * @brief Sets the PI gains
+ * @param kpMilliHz Proportional gain, mHz per rpm of error
+ * @param kiMilliHz Integral gain, mHz/s per rpm of error
+ * @retval 0=success, 1=error (out of range)
+ */
+uint8_t SpeedControl_SetGains(uint16_t kpMilliHz, uint16_t kiMilliHz)
+{
+  if (kpMilliHz > SPEED_GAIN_MAX || kiMilliHz > SPEED_GAIN_MAX)
+  {
+    return 1;
+  }
+  speedLoop.kpMilliHz = kpMilliHz;
+  speedLoop.kiMilliHz = kiMilliHz;
+  return 0;
+}
+
+/**
+ * @brief Gets the speed loop state
+ * @retval Pointer to the state
+ */
+const SpeedLoop_t* SpeedControl_GetState(void)
+{
+  return &speedLoop;
+}
+
+/**
+ * @brief Reads the encoder and runs the PI loop at its rate
+ * @note Called once per control tick from the TIM1 update interrupt, before
+ *       FreqControl_Update() so the new reference is modulated this tick
+ * @retval None
+ */
+void SpeedControl_Tick(void)
+{
+  if (!SpeedControl_IsAvailable())
+  {
+    return;
+  }
+
+  EstimateSpeed();
+
+  if (++loopTicks >= SPEED_LOOP_DIVIDER)
+  {
+    loopTicks = 0;
+    RunLoop();
+  }
+}
+
+/**
+ * @brief M/T speed estimate, one encoder read per tick
+ * @retval None
+ */
+static void EstimateSpeed(void)
+{
+  uint16_t count = (uint16_t)encoderTimer->Instance->CNT;
+  int32_t delta = (int16_t)(count - lastCount);
+
+  lastCount = count;
+#if SPEED_ENCODER_INVERT
+  delta = -delta;
+#endif
+
+  windowCounts += delta;
+  windowTicks++;
+  if (delta != 0)
+  {
+    edgeCounts = windowCounts;
+    edgeTicks = windowTicks;
+  }
+
+  if (edgeTicks >= SPEED_LOOP_DIVIDER &&
+      (edgeCounts >= SPEED_MT_MIN_COUNTS || edgeCounts <= -SPEED_MT_MIN_COUNTS))
+  {
+    /* Close the window on the last edge; the next one starts there */
+    speedLoop.measuredDrpm = CountsToDrpm(edgeCounts, edgeTicks);
+    windowCounts -= edgeCounts;
+    windowTicks -= edgeTicks;
+    edgeCounts = 0;
+    edgeTicks = 0;
+  }
+  else if (windowTicks >= SPEED_MT_MAX_TICKS)
+  {
+    /* Too few counts for a timed window: standstill or crawling */
+    speedLoop.measuredDrpm = CountsToDrpm(windowCounts, windowTicks);
+    windowCounts = 0;
+    windowTicks = 0;
+    edgeCounts = 0;
+    edgeTicks = 0;
+  }
+}
+
+/**
+ * @brief Converts encoder counts over control ticks to speed
+ * @retval Speed in 0.1 rpm
+ */
+static int32_t CountsToDrpm(int32_t counts, uint32_t ticks)
+{
+  return (int32_t)(((int64_t)counts * 600 * PWM_CONTROL_TICK_HZ) /
+                   ((int64_t)ENCODER_COUNTS_PER_REV * ticks));
+}
+
+/**
+ * @brief One PI step: frequency reference = synchronous frequency + trim
+ * @retval None
+ */
+static void RunLoop(void)
+{
+  int32_t feedForward, error, candidate, trim, request, freq;
+
+  /* Synchronous frequency of the setpoint: rpm * pole pairs / 60 */
+  feedForward = (speedLoop.setpointDrpm * SPEED_POLE_PAIRS * 5) / 3;
+
+  if (!speedLoop.enabled || !FreqControl_IsRunning(targetAxis) ||
+      FreqControl_IsStopping(targetAxis))
+  {
+    /* Bumpless start: the next run begins from the synchronous frequency */
+    integral = 0;
+    speedLoop.trimMilliHz = 0;
+    speedLoop.saturated = 0;
+    if (speedLoop.enabled && !FreqControl_IsRunning(targetAxis) &&
+        feedForward >= (int32_t)FREQ_MIN_MHZ && feedForward <= (int32_t)FREQ_MAX_MHZ)
+    {
+      FreqControl_ApplyFrequencyMilliHz(targetAxis, (uint32_t)feedForward);
+    }
+    return;
+  }
+
+  error = speedLoop.setpointDrpm - speedLoop.measuredDrpm;
+
+  candidate = integral + (int32_t)speedLoop.kiMilliHz * error;
+  if (candidate > SPEED_TRIM_MAX_MHZ * INTEGRAL_SCALE)
+  {
+    candidate = SPEED_TRIM_MAX_MHZ * INTEGRAL_SCALE;
+  }
+  else if (candidate < -SPEED_TRIM_MAX_MHZ * INTEGRAL_SCALE)
+  {
+    candidate = -SPEED_TRIM_MAX_MHZ * INTEGRAL_SCALE;
+  }
+  trim = ((int32_t)speedLoop.kpMilliHz * error) / 10 + candidate / INTEGRAL_SCALE;
+  request = feedForward + trim;
+
+  /* Trim limit, then the frequency range of the drive */
+  if (trim > SPEED_TRIM_MAX_MHZ)
+  {
+    trim = SPEED_TRIM_MAX_MHZ;
+  }
+  else if (trim < -SPEED_TRIM_MAX_MHZ)
+  {
+    trim = -SPEED_TRIM_MAX_MHZ;
+  }
+  freq = feedForward + trim;
+  if (freq > (int32_t)FREQ_MAX_MHZ)
+  {
+    freq = FREQ_MAX_MHZ;
+  }
+  else if (freq < (int32_t)FREQ_MIN_MHZ)
+  {
+    freq = FREQ_MIN_MHZ;
+  }
+
+  /* Anti-windup: hold the integrator while the output is stuck at the
+     limit the error pushes towards */
+  if (!((request > freq && error > 0) || (request < freq && error < 0)))
+  {
+    integral = candidate;
+  }
+
+  speedLoop.trimMilliHz = freq - feedForward;
+  speedLoop.saturated = (request != freq);
+  FreqControl_ApplyFrequencyMilliHz(targetAxis, (uint32_t)freq);
+}
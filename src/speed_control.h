@@ -0,0 +1,64 @@
+/**
+ * @file speed_control.h
+ * @brief Malha fechada de velocidade com encoder em quadratura
+ */
+
+#ifndef __SPEED_CONTROL_H
+#define __SPEED_CONTROL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes */
+#include "stm32f0xx_hal.h"
+#include "freq_control.h"
+#include <stdint.h>
+
+/* Defines */
+#ifndef SPEED_ENCODER_PPR
+#define SPEED_ENCODER_PPR       1024    /* Lines per revolution (4 counts per line) */
+#endif
+#ifndef SPEED_POLE_PAIRS
+#define SPEED_POLE_PAIRS        2       /* 4-pole motor: 1500 rpm at 50 Hz */
+#endif
+#ifndef SPEED_ENCODER_INVERT
+#define SPEED_ENCODER_INVERT    0       /* 1 = count down when the motor turns forward */
+#endif
+#define SPEED_LOOP_DIVIDER      10      /* Control ticks per PI step (100 Hz loop) */
+#define SPEED_MT_MIN_COUNTS     8       /* Counts before an estimate window may close */
+#define SPEED_MT_MAX_TICKS      500     /* Longest window; no edge in it = standstill */
+#define SPEED_MAX_DRPM          30000   /* Speed setpoint limit, 0.1 rpm */
+#ifndef SPEED_TRIM_MAX_MHZ
+#define SPEED_TRIM_MAX_MHZ      5000L   /* PI correction limit (slip range) */
+#endif
+#define SPEED_GAIN_MAX          10000   /* Gain limit, mHz per rpm (per second for Ki) */
+
+/* Types */
+/**
+ * @brief Speed loop state (set by the main loop, run by the control tick)
+ */
+typedef struct {
+  volatile uint8_t enabled;           /* Closed loop owns the axis setpoint */
+  volatile int32_t setpointDrpm;      /* Speed setpoint, 0.1 rpm */
+  volatile int32_t measuredDrpm;      /* Encoder speed, 0.1 rpm */
+  volatile int32_t trimMilliHz;       /* PI output added to the synchronous frequency */
+  volatile uint16_t kpMilliHz;        /* mHz per rpm of error */
+  volatile uint16_t kiMilliHz;        /* mHz/s per rpm of error */
+  volatile uint8_t saturated;         /* Trim or frequency at a limit (integrator held) */
+} SpeedLoop_t;
+
+/* Public functions */
+void SpeedControl_Init(TIM_HandleTypeDef *encoder, FreqControl_t *axis);
+uint8_t SpeedControl_IsAvailable(void);
+uint8_t SpeedControl_SetSpeed(int32_t setpointDrpm);
+void SpeedControl_Disable(void);
+uint8_t SpeedControl_SetGains(uint16_t kpMilliHz, uint16_t kiMilliHz);
+const SpeedLoop_t* SpeedControl_GetState(void);
+void SpeedControl_Tick(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SPEED_CONTROL_H */
@@ -0,0 +1,104 @@
+/**
+ * @file stm32f0xx_it.c
+ * @brief Tratadores de interrupção (exceções do Cortex-M0 e periféricos)
+ */
+
+#include "main.h"
+#include "stm32f0xx_it.h"
+#include "serial_comm.h"
+
+/* External variables (peripheral handles defined in main.c) */
+extern UART_HandleTypeDef huart2;
+extern DMA_HandleTypeDef hdma_usart2_rx;
+extern DMA_HandleTypeDef hdma_usart2_tx;
+extern TIM_HandleTypeDef htim1;
+extern TIM_HandleTypeDef htim16;
+extern DMA_HandleTypeDef hdma_adc;
+
+/******************************************************************************/
+/*           Cortex-M0 Processor Interruption and Exception Handlers          */
+/******************************************************************************/
+
+/**
+ * @brief This function handles Non maskable interrupt.
+ */
+void NMI_Handler(void)
+{
+}
+
+/**
+ * @brief This function handles Hard fault interrupt.
+ */
+void HardFault_Handler(void)
+{
+  Error_Handler();
+}
+
+/**
+ * @brief This function handles System service call via SWI instruction.
+ */
+void SVC_Handler(void)
+{
+}
+
+/**
+ * @brief This function handles Pendable request for system service.
+ */
+void PendSV_Handler(void)
+{
+}
+
+/**
+ * @brief This function handles System tick timer (HAL time base).
+ */
+void SysTick_Handler(void)
+{
+  HAL_IncTick();
+}
+
+/******************************************************************************/
+/*                      STM32F0xx Peripheral Interrupt Handlers               */
+/******************************************************************************/
+
+/**
+ * @brief This function handles DMA1 channel 1 (ADC, bus voltage).
+ */
+void DMA1_Channel1_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_adc);
+}
+
+/**
+ * @brief This function handles DMA1 channel 4 and 5 (USART2 TX/RX).
+ */
+void DMA1_Channel4_5_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_usart2_tx);
+  HAL_DMA_IRQHandler(&hdma_usart2_rx);
+}
+
+/**
+ * @brief This function handles TIM1 break, update, trigger and commutation
+ *        interrupts (update = control timebase).
+ */
+void TIM1_BRK_UP_TRG_COM_IRQHandler(void)
+{
+  HAL_TIM_IRQHandler(&htim1);
+}
+
+/**
+ * @brief This function handles TIM16 global interrupt (Modbus gap timer).
+ */
+void TIM16_IRQHandler(void)
+{
+  HAL_TIM_IRQHandler(&htim16);
+}
+
+/**
+ * @brief This function handles USART2 global interrupt.
+ */
+void USART2_IRQHandler(void)
+{
+  SerialComm_UART_IRQHandler();
+  HAL_UART_IRQHandler(&huart2);
+}
@@ -0,0 +1,29 @@
+/**
+ * @file stm32f0xx_it.h
+ * @brief Protótipos dos tratadores de interrupção
+ */
+
+#ifndef __STM32F0xx_IT_H
+#define __STM32F0xx_IT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Exported functions prototypes */
+void NMI_Handler(void);
+void HardFault_Handler(void);
+void SVC_Handler(void);
+void PendSV_Handler(void);
+void SysTick_Handler(void);
+void DMA1_Channel1_IRQHandler(void);
+void DMA1_Channel4_5_IRQHandler(void);
+void TIM1_BRK_UP_TRG_COM_IRQHandler(void);
+void TIM16_IRQHandler(void);
+void USART2_IRQHandler(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STM32F0xx_IT_H */
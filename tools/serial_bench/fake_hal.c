@@ -0,0 +1,506 @@
+/**
+ * @file fake_hal.c
+ * @brief HAL simulada no host: UART ligada a um pseudo-terminal, DMA e temporizadores
+ *
+ * The firmware modules run unmodified on top of this file. Bytes written by
+ * the client to the pty are put on a virtual line at the configured baud rate
+ * (one character every 10 bit times), so reception by interrupt, the circular
+ * DMA counter and the USART idle-line flag behave as on the target. Responses
+ * leave the virtual line at the same rate and reach the pty when their last
+ * character has been shifted out.
+ *
+ * "Interrupts" are delivered by the stand-in's hook, which is also called
+ * while a blocking HAL call waits, so the control tick and the reception keep
+ * preempting the main loop as they do on the target.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "fake_hal.h"
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Private defines */
+#define FAKE_PCLK_HZ        8000000UL   /* HSI, no PLL, as on the target */
+#define UART_BITS_PER_CHAR  10ULL       /* 8N1 */
+#define FAKE_TX_MAX         512
+
+/* Peripheral registers (RAM instead of the bus) */
+static TIM_TypeDef tim1Regs, tim3Regs, tim6Regs, tim14Regs, tim15Regs, tim16Regs, tim17Regs;
+static USART_TypeDef usart1Regs, usart2Regs;
+static ADC_TypeDef adc1Regs;
+static GPIO_TypeDef gpioaRegs, gpiobRegs, gpiocRegs;
+static DMA_Channel_TypeDef dmaRegs[5];
+
+TIM_TypeDef *TIM1 = &tim1Regs, *TIM3 = &tim3Regs, *TIM6 = &tim6Regs, *TIM14 = &tim14Regs,
+            *TIM15 = &tim15Regs, *TIM16 = &tim16Regs, *TIM17 = &tim17Regs;
+USART_TypeDef *USART1 = &usart1Regs, *USART2 = &usart2Regs;
+ADC_TypeDef *ADC1 = &adc1Regs;
+GPIO_TypeDef *GPIOA = &gpioaRegs, *GPIOB = &gpiobRegs, *GPIOC = &gpiocRegs;
+DMA_Channel_TypeDef *DMA1_Channel1 = &dmaRegs[0], *DMA1_Channel2 = &dmaRegs[1],
+                    *DMA1_Channel3 = &dmaRegs[2], *DMA1_Channel4 = &dmaRegs[3],
+                    *DMA1_Channel5 = &dmaRegs[4];
+
+/* Private variables */
+static struct timespec startTime;
+static void (*interruptHook)(void);
+static uint8_t inHook = 0;
+
+/* UART model */
+static UART_HandleTypeDef* uart;
+static int uartFd = -1;
+static uint64_t charNs;
+static uint8_t rxFifo[FAKE_UART_FIFO_SIZE];
+static uint32_t fifoHead, fifoTail, fifoCount;
+static uint64_t nextByteNs;         /* End of the character being received */
+static uint64_t lastByteNs;         /* End of the last received character */
+static uint8_t lineActive = 0;      /* Characters since the last idle flag */
+static uint8_t* itBuffer;           /* Armed 1-byte interrupt reception */
+
+/* ADC model: the circular DMA buffer of the converted sequence */
+static ADC_HandleTypeDef* adc;
+static uint16_t* adcBuffer;
+static uint32_t adcLength;
+static uint8_t* dmaBuffer;          /* Circular DMA reception */
+static uint16_t dmaSize;
+static uint8_t txPending[FAKE_TX_MAX];
+static uint16_t txPendingLength;
+static uint64_t txLineFreeNs;       /* End of the character being sent */
+static uint32_t overruns;
+
+/* Private function prototypes */
+static uint64_t NowNs(void);
+static void RunInterrupts(void);
+static void DeliverByte(uint8_t byte);
+static void WriteAll(const uint8_t* data, uint32_t length);
+static uint64_t ReserveTxLine(uint16_t length);
+
+/**
+ * @brief Resets the time base
+ * @retval None
+ */
+void FakeHal_Init(void)
+{
+  clock_gettime(CLOCK_MONOTONIC, &startTime);
+}
+
+/**
+ * @brief Microseconds since FakeHal_Init()
+ * @retval Time in us
+ */
+uint64_t FakeHal_Micros(void)
+{
+  return NowNs() / 1000ULL;
+}
+
+/**
+ * @brief Registers the function that services the simulated interrupts
+ * @param hook Called from idle loops and blocking HAL calls
+ * @retval None
+ */
+void FakeHal_SetInterruptHook(void (*hook)(void))
+{
+  interruptHook = hook;
+}
+
+/**
+ * @brief Connects a UART handle to a file descriptor (pty master)
+ * @param huart UART handle (Init.BaudRate already set)
+ * @param fd Non-blocking descriptor the responses are written to
+ * @retval None
+ */
+void FakeHal_UartAttach(UART_HandleTypeDef *huart, int fd)
+{
+  uart = huart;
+  uartFd = fd;
+  charNs = (UART_BITS_PER_CHAR * 1000000000ULL) / huart->Init.BaudRate;
+  uart->gState = HAL_UART_STATE_READY;
+}
+
+/**
+ * @brief Room left in the virtual line FIFO
+ * @retval Number of bytes FakeHal_UartFeed() can accept
+ */
+uint32_t FakeHal_UartFeedSpace(void)
+{
+  return FAKE_UART_FIFO_SIZE - fifoCount;
+}
+
+/**
+ * @brief Queues bytes received from the client for the virtual line
+ * @param data Bytes read from the pty
+ * @param length Number of bytes
+ * @retval Number of bytes accepted
+ */
+uint32_t FakeHal_UartFeed(const uint8_t* data, uint32_t length)
+{
+  uint64_t now = NowNs();
+  uint32_t i;
+
+  if (fifoCount == 0)
+  {
+    nextByteNs = ((now > lastByteNs) ? now : lastByteNs) + charNs;
+  }
+
+  for (i = 0; i < length && fifoCount < FAKE_UART_FIFO_SIZE; i++)
+  {
+    rxFifo[fifoHead] = data[i];
+    fifoHead = (fifoHead + 1) % FAKE_UART_FIFO_SIZE;
+    fifoCount++;
+  }
+  return i;
+}
+
+/**
+ * @brief Advances the UART model to the current time
+ * @note Received characters are handed to the armed reception (interrupt
+ *       callback or DMA ring); the idle flag rises one character time after
+ *       the last one
+ * @param nowUs Current time (FakeHal_Micros)
+ * @retval 1 when the USART interrupt fires for the idle line
+ */
+uint8_t FakeHal_UartService(uint64_t nowUs)
+{
+  uint64_t now = nowUs * 1000ULL;
+
+  while (fifoCount > 0 && now >= nextByteNs)
+  {
+    uint8_t byte = rxFifo[fifoTail];
+
+    fifoTail = (fifoTail + 1) % FAKE_UART_FIFO_SIZE;
+    fifoCount--;
+    lastByteNs = nextByteNs;
+    nextByteNs += charNs;
+    lineActive = 1;
+    DeliverByte(byte);
+  }
+
+  /* DMA transmission finished: the frame reaches the client */
+  if (uart->gState == HAL_UART_STATE_BUSY_TX && now >= txLineFreeNs)
+  {
+    WriteAll(txPending, txPendingLength);
+    uart->gState = HAL_UART_STATE_READY;
+  }
+
+  if (lineActive && fifoCount == 0 && now >= lastByteNs + charNs)
+  {
+    lineActive = 0;
+    uart->Instance->ISR |= USART_ISR_IDLE;
+    return (uart->Instance->CR1 & USART_CR1_IDLEIE) != 0;
+  }
+  return 0;
+}
+
+/**
+ * @brief Characters lost because no reception was armed
+ * @retval Overrun count
+ */
+uint32_t FakeHal_UartOverruns(void)
+{
+  return overruns;
+}
+
+/**
+ * @brief Advances a basic timer (up-counting, prescaler from PCLK)
+ * @param htim Timer handle
+ * @param elapsedUs Time since the previous call
+ * @retval 1 when the update interrupt fires
+ */
+uint8_t FakeHal_TimerAdvance(TIM_HandleTypeDef *htim, uint32_t elapsedUs)
+{
+  TIM_TypeDef* tim = htim->Instance;
+  uint64_t count;
+
+  if (!(tim->CR1 & TIM_CR1_CEN))
+  {
+    return 0;
+  }
+
+  count = tim->CNT + ((uint64_t)elapsedUs * (FAKE_PCLK_HZ / 1000000UL)) / (tim->PSC + 1);
+  if (count <= tim->ARR)
+  {
+    tim->CNT = (uint32_t)count;
+    return 0;
+  }
+
+  tim->CNT = 0;
+  if (tim->CR1 & TIM_CR1_OPM)
+  {
+    tim->CR1 &= ~TIM_CR1_CEN;
+  }
+  tim->SR |= TIM_SR_UIF;
+  return (tim->DIER & TIM_DIER_UIE) != 0;
+}
+
+/* HAL ---------------------------------------------------------------------- */
+
+uint32_t HAL_GetTick(void)
+{
+  return (uint32_t)(NowNs() / 1000000ULL);
+}
+
+void HAL_Delay(uint32_t Delay)
+{
+  uint32_t start = HAL_GetTick();
+
+  while (HAL_GetTick() - start < Delay)
+  {
+    RunInterrupts();
+  }
+}
+
+/* Interrupts are run synchronously by the hook: a compiler barrier is enough */
+void __DMB(void)
+{
+  __sync_synchronize();
+}
+
+uint32_t HAL_RCC_GetPCLK1Freq(void)
+{
+  return FAKE_PCLK_HZ;
+}
+
+uint32_t HAL_RCC_GetSysClockFreq(void)
+{
+  return FAKE_PCLK_HZ;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+  uint64_t done;
+
+  (void)Timeout;
+  if (huart != uart || huart->gState != HAL_UART_STATE_READY)
+  {
+    return HAL_BUSY;
+  }
+
+  /* Polling transmission: the caller waits for the last character */
+  done = ReserveTxLine(Size);
+  while (NowNs() < done)
+  {
+    RunInterrupts();
+  }
+  WriteAll(pData, Size);
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size)
+{
+  if (huart != uart || huart->gState != HAL_UART_STATE_READY || Size > FAKE_TX_MAX)
+  {
+    return HAL_BUSY;
+  }
+
+  memcpy(txPending, pData, Size);
+  txPendingLength = Size;
+  ReserveTxLine(Size);
+  huart->gState = HAL_UART_STATE_BUSY_TX;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive_IT(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size)
+{
+  (void)Size;
+  if (huart != uart)
+  {
+    return HAL_ERROR;
+  }
+  itBuffer = pData;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size)
+{
+  if (huart != uart || huart->hdmarx == NULL)
+  {
+    return HAL_ERROR;
+  }
+  dmaBuffer = pData;
+  dmaSize = Size;
+  huart->hdmarx->Instance->CNDTR = Size;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_AbortReceive(UART_HandleTypeDef *huart)
+{
+  (void)huart;
+  itBuffer = NULL;
+  dmaBuffer = NULL;
+  return HAL_OK;
+}
+
+/* Memory-to-peripheral channels are only armed: no timer events are simulated */
+HAL_StatusTypeDef HAL_DMA_Start(DMA_HandleTypeDef *hdma, uint32_t SrcAddress, uint32_t DstAddress, uint32_t DataLength)
+{
+  if (hdma == NULL || (hdma->Instance->CCR & DMA_CCR_EN) != 0)
+  {
+    return HAL_BUSY;
+  }
+  hdma->Instance->CMAR = SrcAddress;
+  hdma->Instance->CPAR = DstAddress;
+  hdma->Instance->CNDTR = DataLength;
+  hdma->Instance->CCR |= DMA_CCR_EN;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef *hdma)
+{
+  hdma->Instance->CCR &= ~DMA_CCR_EN;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef *htim, uint32_t Channel)
+{
+  htim->Instance->CCER |= TIM_CCER_CC1E << Channel;
+  htim->Instance->CR1 |= TIM_CR1_CEN;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Stop(TIM_HandleTypeDef *htim, uint32_t Channel)
+{
+  htim->Instance->CCER &= ~(TIM_CCER_CC1E << Channel);
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIMEx_PWMN_Start(TIM_HandleTypeDef *htim, uint32_t Channel)
+{
+  htim->Instance->CCER |= TIM_CCER_CC1NE << Channel;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIMEx_PWMN_Stop(TIM_HandleTypeDef *htim, uint32_t Channel)
+{
+  htim->Instance->CCER &= ~(TIM_CCER_CC1NE << Channel);
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIMEx_ConfigCommutEvent(TIM_HandleTypeDef *htim, uint32_t InputTrigger, uint32_t CommutationSource)
+{
+  (void)InputTrigger;
+  (void)CommutationSource;
+  htim->Instance->CR2 |= TIM_CR2_CCPC;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADCEx_Calibration_Start(ADC_HandleTypeDef *hadc)
+{
+  (void)hadc;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADC_Start_DMA(ADC_HandleTypeDef *hadc, uint32_t *pData, uint32_t Length)
+{
+  adc = hadc;
+  adcBuffer = (uint16_t*)pData;
+  adcLength = Length;
+  return HAL_OK;
+}
+
+/**
+ * @brief One triggered ADC sequence: DMA into the buffer, then the
+ *        transfer-complete callback
+ * @param values One value per converted channel, in sequence order
+ * @retval None
+ */
+void FakeHal_AdcConvert(const uint16_t* values)
+{
+  if (adcBuffer == NULL)
+  {
+    return;
+  }
+  memcpy(adcBuffer, values, adcLength * sizeof(uint16_t));
+  HAL_ADC_ConvCpltCallback(adc);
+}
+
+/* Private functions -------------------------------------------------------- */
+
+static uint64_t NowNs(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)(now.tv_sec - startTime.tv_sec) * 1000000000ULL +
+         (uint64_t)now.tv_nsec - (uint64_t)startTime.tv_nsec;
+}
+
+/**
+ * @brief Services the simulated interrupts (not re-entrant, like one NVIC level)
+ * @retval None
+ */
+static void RunInterrupts(void)
+{
+  if (interruptHook != NULL && !inHook)
+  {
+    inHook = 1;
+    interruptHook();
+    inHook = 0;
+  }
+}
+
+/**
+ * @brief Hands one received character to the armed reception
+ * @retval None
+ */
+static void DeliverByte(uint8_t byte)
+{
+  if (dmaBuffer != NULL)
+  {
+    DMA_Channel_TypeDef* channel = uart->hdmarx->Instance;
+
+    dmaBuffer[dmaSize - channel->CNDTR] = byte;
+    if (--channel->CNDTR == 0)
+    {
+      channel->CNDTR = dmaSize;
+      HAL_UART_RxCpltCallback(uart);
+    }
+  }
+  else if (itBuffer != NULL)
+  {
+    *itBuffer = byte;
+    itBuffer = NULL;
+    HAL_UART_RxCpltCallback(uart);
+  }
+  else
+  {
+    overruns++;
+  }
+}
+
+/**
+ * @brief Writes to the pty, waiting while the client does not drain it
+ * @retval None
+ */
+static void WriteAll(const uint8_t* data, uint32_t length)
+{
+  ssize_t written;
+
+  while (length > 0)
+  {
+    written = write(uartFd, data, length);
+    if (written > 0)
+    {
+      data += written;
+      length -= (uint32_t)written;
+    }
+    else if (written < 0 && errno != EAGAIN && errno != EINTR)
+    {
+      return;
+    }
+  }
+}
+
+/**
+ * @brief Books the transmit line for a number of characters
+ * @retval Time the last character has been shifted out
+ */
+static uint64_t ReserveTxLine(uint16_t length)
+{
+  uint64_t now = NowNs();
+  uint64_t start = (txLineFreeNs > now) ? txLineFreeNs : now;
+
+  txLineFreeNs = start + length * charNs;
+  return txLineFreeNs;
+}
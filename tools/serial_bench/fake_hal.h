@@ -0,0 +1,35 @@
+/**
+ * @file fake_hal.h
+ * @brief Lado "hardware" da HAL simulada no host (UART em pty, DMA, temporizadores, ADC)
+ */
+
+#ifndef __FAKE_HAL_H
+#define __FAKE_HAL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes */
+#include "stm32f0xx_hal.h"
+
+/* Defines */
+#define FAKE_UART_FIFO_SIZE   8192    /* Bytes written by the client, not yet on the line */
+
+/* Public functions */
+void FakeHal_Init(void);
+uint64_t FakeHal_Micros(void);
+void FakeHal_SetInterruptHook(void (*hook)(void));
+void FakeHal_UartAttach(UART_HandleTypeDef *huart, int fd);
+uint32_t FakeHal_UartFeedSpace(void);
+uint32_t FakeHal_UartFeed(const uint8_t* data, uint32_t length);
+uint8_t FakeHal_UartService(uint64_t nowUs);
+uint32_t FakeHal_UartOverruns(void);
+uint8_t FakeHal_TimerAdvance(TIM_HandleTypeDef *htim, uint32_t elapsedUs);
+void FakeHal_AdcConvert(const uint16_t* values);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __FAKE_HAL_H */
@@ -0,0 +1,417 @@
+/**
+ * @file fw_standin.c
+ * @brief Firmware executado no host com a serial exposta em um pseudo-terminal
+ *
+ * Plays the role of main.c and stm32f0xx_it.c: the same modules, the same
+ * init order, the 1 kHz control tick (sequencer + modulation), the USART idle
+ * interrupt and the TIM16 gap timer, and a main loop that calls
+ * SerialComm_Process() and FreqControl_Process() every 10 ms like the
+ * target's HAL_Delay(10).
+ *
+ * The speed loop reads a simulated encoder (TIM15 standing in for TIM3 in
+ * encoder mode): a motor on axis 1 that turns at the synchronous speed of the
+ * output frequency minus a fixed slip, counted x4 per tick.
+ *
+ * The ADC converts once per carrier period after each control tick: the bus
+ * and the phase currents of a balanced resistive load driven by the duties
+ * on the outputs. The bus sits at its nominal voltage; with -d the supply
+ * drops out for that many ms every DIP_PERIOD_MS, and the bus capacitor then
+ * feeds (or is refilled by) a motor model: torque proportional to the slip
+ * of a rotor with inertia, against a constant load torque.
+ *
+ * Usage: fw_standin [-b baud] [-l loop ms] [-s slip rpm] [-R load ohm] [-d dip ms] [-L link]
+ * The pty slave path is printed on stdout; -L also creates a symlink to it.
+ */
+
+#define _GNU_SOURCE
+
+#include "main.h"
+#include "serial_comm.h"
+#include "pwm_control.h"
+#include "freq_control.h"
+#include "adc_sense.h"
+#include "sequencer.h"
+#include "speed_control.h"
+#include "power_meter.h"
+#include "motor_comp.h"
+#include "ride_through.h"
+#include "fake_hal.h"
+#include "pty_port.h"
+
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/* Private defines */
+#define CONTROL_TICK_US     (1000000UL / PWM_CONTROL_TICK_HZ)
+#define DEFAULT_BAUD        115200
+#define DEFAULT_LOOP_MS     10
+#define DEFAULT_SLIP_RPM    40
+#define DEFAULT_LOAD_OHM    30
+#define DIP_PERIOD_MS       5000    /* One supply dip every 5 s with -d */
+#define BUS_CAP_F           1000e-6 /* Bus capacitor */
+#define ROTOR_INERTIA       0.05    /* kg m^2 */
+#define TORQUE_PER_SLIP_HZ  5.0     /* N m per Hz of slip */
+
+/* Peripheral handles, as in main.c */
+UART_HandleTypeDef huart2;
+DMA_HandleTypeDef hdma_usart2_rx;
+DMA_HandleTypeDef hdma_usart2_tx;
+TIM_HandleTypeDef htim1;
+DMA_HandleTypeDef hdma_tim1_ch1;
+TIM_HandleTypeDef htim3;
+TIM_HandleTypeDef htim16;
+TIM_HandleTypeDef htimEncoder;
+ADC_HandleTypeDef hadc;
+
+/* Private variables */
+static int ptyFd = -1;
+static uint64_t nextTickUs;
+static uint64_t lastServiceUs;
+static uint32_t controlTicks;
+static uint32_t lateTicks;
+static uint32_t slipRpm = DEFAULT_SLIP_RPM;
+static int64_t encoderRemainder;
+static uint32_t loadOhm = DEFAULT_LOAD_OHM;
+static uint32_t dipMs = 0;
+static double busVolts = BUS_NOMINAL_DV / 10.0;
+static double rotorHz = 0.0;                /* Rotor speed, electrical Hz */
+static uint16_t outputCompares[PWM_PHASE_COUNT];
+static volatile sig_atomic_t stopRequested = 0;
+
+/* Private function prototypes */
+static void Peripherals_Init(uint32_t baud);
+static void ServiceInterrupts(void);
+static void TurnMotor(void);
+static void SupplyBus(void);
+static void SampleLoad(void);
+/**
+ * @brief Motor model: advances the encoder by one control tick of rotation
+ * @note Slip is constant while running; the rotor stops with the output
+ * @retval None
+ */
+static void TurnMotor(void)
+{
+  const FreqControl_t* axis = FreqControl_GetAxis(FREQ_AXIS_DEFAULT);
+  int64_t rpmMilli, counts;
+
+  if (!FreqControl_IsRunning(axis))
+  {
+    return;
+  }
+
+  /* Synchronous speed in mrpm = mHz * 60 / pole pairs, minus the slip */
+  rpmMilli = (int64_t)FreqControl_GetOutputFrequencyMilliHz(axis) * 60 / SPEED_POLE_PAIRS -
+             (int64_t)slipRpm * 1000;
+  if (rpmMilli < 0)
+  {
+    rpmMilli = 0;
+  }
+
+  /* Counts per tick = rpm * 4 * PPR / 60 / tick rate, remainder carried */
+  encoderRemainder += rpmMilli * 4 * SPEED_ENCODER_PPR;
+  counts = encoderRemainder / (60000LL * PWM_CONTROL_TICK_HZ);
+  encoderRemainder -= counts * 60000LL * PWM_CONTROL_TICK_HZ;
+  htimEncoder.Instance->CNT = (uint16_t)(htimEncoder.Instance->CNT + (uint32_t)counts);
+}
+
+/**
+ * @brief Bus model: stiff supply, or the capacitor alone during a dip
+ * @note The torque is proportional to the slip (stator minus rotor
+ *       frequency); the air-gap power T * ws leaves the capacitor, or
+ *       refills it when the motor regenerates
+ * @retval None
+ */
+static void SupplyBus(void)
+{
+  const FreqControl_t* axis = FreqControl_GetAxis(1);
+  const double dt = 1.0 / PWM_CONTROL_TICK_HZ;
+  const double toMechanical = 2.0 * M_PI / SPEED_POLE_PAIRS;
+  double statorHz = FreqControl_GetOutputFrequencyMilliHz(axis) / 1000.0;
+  double loadTorque = TORQUE_PER_SLIP_HZ * slipRpm * SPEED_POLE_PAIRS / 60.0;
+  double torque = 0.0, energy;
+  uint32_t phaseMs = (controlTicks * 1000UL / PWM_CONTROL_TICK_HZ) % DIP_PERIOD_MS;
+
+  if (axis->pwm.enabled)
+  {
+    torque = TORQUE_PER_SLIP_HZ * (statorHz - rotorHz);
+  }
+  if (rotorHz <= 0.0 && torque < loadTorque)
+  {
+    loadTorque = torque;    /* Held at standstill */
+  }
+  rotorHz += (torque - loadTorque) * dt / (ROTOR_INERTIA * toMechanical);
+  if (rotorHz < 0.0)
+  {
+    rotorHz = 0.0;
+  }
+
+  if (dipMs == 0 || phaseMs >= dipMs)
+  {
+    busVolts = BUS_NOMINAL_DV / 10.0;
+    return;
+  }
+  energy = 0.5 * BUS_CAP_F * busVolts * busVolts - torque * statorHz * toMechanical * dt;
+  busVolts = (energy > 0.0) ? sqrt(2.0 * energy / BUS_CAP_F) : 0.0;
+}
+
+/**
+ * @brief ADC sequences of one control tick (one per carrier period)
+ * @note Star-connected resistors: each phase sees its duty minus the mean of
+ *       the three, times the bus voltage
+ * @retval None
+ */
+static void SampleLoad(void)
+{
+  uint16_t values[ADC_SENSE_CHANNELS];
+  uint32_t period = htim1.Instance->ARR;
+  uint32_t sequences = (htim1.Instance->RCR + 1) / 2;
+  int32_t mean, currentMilliA, counts;
+  uint32_t busDv;
+  uint8_t i;
+  int16_t ranks[PWM_PHASE_COUNT];
+
+  ranks[0] = ADC_SENSE_RANK_IU;
+  ranks[1] = ADC_SENSE_RANK_IV;
+#if ADC_SENSE_CURRENT_PHASES > 2
+  ranks[2] = ADC_SENSE_RANK_IW;
+#else
+  ranks[2] = -1;
+#endif
+
+  busDv = (uint32_t)(busVolts * 10.0);
+  if (busDv > BUS_FULL_SCALE_DV)
+  {
+    busDv = BUS_FULL_SCALE_DV;
+  }
+  values[ADC_SENSE_RANK_VBUS] = (uint16_t)((busDv * ADC_SENSE_FULL_SCALE) / BUS_FULL_SCALE_DV);
+  for (i = 0; i < PWM_PHASE_COUNT; i++)
+  {
+    if (outputCompares[i] > period)
+    {
+      outputCompares[i] = (uint16_t)period;   /* 100% duty */
+    }
+  }
+  mean = ((int32_t)outputCompares[0] + outputCompares[1] + outputCompares[2]) / 3;
+  for (i = 0; i < PWM_PHASE_COUNT; i++)
+  {
+    currentMilliA = 0;
+    if (FreqControl_GetAxis(1)->pwm.enabled && period > 0)
+    {
+      /* i = (d - mean d) * Vbus / R, in mA (Vbus in 0.1 V) */
+      currentMilliA = (int32_t)(((int64_t)(outputCompares[i] - mean) * busDv * 100) /
+                                ((int64_t)period * loadOhm));
+    }
+    counts = ADC_SENSE_MID_SCALE +
+             (currentMilliA * ADC_SENSE_MID_SCALE) / PHASE_CURRENT_FULL_SCALE_MA;
+    if (counts < 0)
+    {
+      counts = 0;
+    }
+    else if (counts > ADC_SENSE_FULL_SCALE)
+    {
+      counts = ADC_SENSE_FULL_SCALE;
+    }
+    if (ranks[i] >= 0)
+    {
+      values[ranks[i]] = (uint16_t)counts;
+    }
+  }
+
+  while (sequences-- > 0)
+  {
+    FakeHal_AdcConvert(values);
+  }
+}
+
+static void OnSignal(int sig);
+
+int main(int argc, char** argv)
+{
+  uint32_t baud = DEFAULT_BAUD;
+  uint32_t loopMs = DEFAULT_LOOP_MS;
+  const char* linkPath = NULL;
+  uint64_t nextLoopUs;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "b:l:s:R:d:L:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'b': baud = (uint32_t)strtoul(optarg, NULL, 10); break;
+      case 'l': loopMs = (uint32_t)strtoul(optarg, NULL, 10); break;
+      case 's': slipRpm = (uint32_t)strtoul(optarg, NULL, 10); break;
+      case 'R': loadOhm = (uint32_t)strtoul(optarg, NULL, 10); break;
+      case 'd': dipMs = (uint32_t)strtoul(optarg, NULL, 10); break;
+      case 'L': linkPath = optarg; break;
+      default:
+        fprintf(stderr, "usage: %s [-b baud] [-l loop ms] [-s slip rpm] [-R load ohm] [-d dip ms] [-L link]\n", argv[0]);
+        return 2;
+    }
+  }
+  if (baud == 0)
+  {
+    baud = DEFAULT_BAUD;
+  }
+  if (loadOhm == 0)
+  {
+    loadOhm = DEFAULT_LOAD_OHM;
+  }
+
+  signal(SIGINT, OnSignal);
+  signal(SIGTERM, OnSignal);
+
+  FakeHal_Init();
+  ptyFd = PtyPort_Open(linkPath);
+  if (ptyFd < 0)
+  {
+    return 1;
+  }
+  Peripherals_Init(baud);
+  FakeHal_UartAttach(&huart2, ptyFd);
+  FakeHal_SetInterruptHook(ServiceInterrupts);
+
+  /* Initialize modules (same order as main.c) */
+  SerialComm_Init(&huart2, &htim16);
+  AdcSense_Init(&hadc);
+  FreqControl_Init();
+  FreqControl_InitAxis(1, &htim1);
+  PowerMeter_Init(FreqControl_GetAxis(1));
+  MotorComp_Init(FreqControl_GetAxis(1));
+  RideThrough_Init(FreqControl_GetAxis(1));
+#if FREQ_AXIS_COUNT > 1
+  FreqControl_InitAxis(2, &htim3);
+#endif
+  Sequencer_Init();
+  SpeedControl_Init(&htimEncoder, FreqControl_GetAxis(FREQ_AXIS_DEFAULT));
+
+  nextTickUs = FakeHal_Micros() + CONTROL_TICK_US;
+  lastServiceUs = FakeHal_Micros();
+  nextLoopUs = lastServiceUs;
+
+  while (!stopRequested)
+  {
+    struct pollfd pfd = { ptyFd, POLLIN, 0 };
+    struct timespec wait = { 0, 50000 };
+
+    ServiceInterrupts();
+
+    if (FakeHal_Micros() >= nextLoopUs)
+    {
+      SerialComm_Process();
+      FreqControl_Process();
+      PowerMeter_Process();
+      nextLoopUs += (uint64_t)loopMs * 1000ULL;
+    }
+
+    /* Sleep until the client writes or the next event is due */
+    ppoll(&pfd, 1, &wait, NULL);
+  }
+
+  fprintf(stderr, "fw_standin: %u control ticks, %u late, %u UART overruns\n",
+          controlTicks, lateTicks, FakeHal_UartOverruns());
+  return 0;
+}
+
+void Error_Handler(void)
+{
+  fprintf(stderr, "fw_standin: Error_Handler()\n");
+  exit(1);
+}
+
+/**
+ * @brief Register-level setup done by the HAL init functions of main.c
+ * @retval None
+ */
+static void Peripherals_Init(uint32_t baud)
+{
+  huart2.Instance = USART2;
+  huart2.Init.BaudRate = baud;
+  hdma_usart2_rx.Instance = DMA1_Channel5;
+  hdma_usart2_tx.Instance = DMA1_Channel4;
+  huart2.hdmarx = &hdma_usart2_rx;
+  huart2.hdmatx = &hdma_usart2_tx;
+
+  /* TIM1/TIM3: center-aligned carriers, ARR/RCR set by PWMControl */
+  htim1.Instance = TIM1;
+  htim1.Instance->CR1 = TIM_CR1_CMS | TIM_CR1_ARPE;
+  hdma_tim1_ch1.Instance = DMA1_Channel2;
+  __HAL_LINKDMA(&htim1, hdma[TIM_DMA_ID_CC1], hdma_tim1_ch1);
+  htim3.Instance = TIM3;
+  htim3.Instance->CR1 = TIM_CR1_CMS | TIM_CR1_ARPE;
+
+  /* TIM16: 1 us tick, one pulse */
+  htim16.Instance = TIM16;
+  htim16.Instance->PSC = (HAL_RCC_GetPCLK1Freq() / 1000000UL) - 1;
+  htim16.Instance->CR1 = TIM_CR1_OPM | TIM_CR1_URS;
+
+  /* TIM15: encoder position counter */
+  htimEncoder.Instance = TIM15;
+  htimEncoder.Instance->ARR = 0xFFFF;
+
+  hadc.Instance = ADC1;
+}
+
+/**
+ * @brief Simulated interrupts: control tick, USART idle line, gap timer
+ * @retval None
+ */
+static void ServiceInterrupts(void)
+{
+  uint64_t now = FakeHal_Micros();
+  uint8_t buffer[256];
+  uint32_t space;
+  ssize_t length;
+
+  /* TIM1 update: one call per elapsed control tick */
+  if (now >= nextTickUs + CONTROL_TICK_US)
+  {
+    lateTicks++;
+  }
+  while (now >= nextTickUs)
+  {
+    /* The frame committed by the previous tick is the one on the outputs */
+    outputCompares[0] = (uint16_t)htim1.Instance->CCR1;
+    outputCompares[1] = (uint16_t)htim1.Instance->CCR2;
+    outputCompares[2] = (uint16_t)htim1.Instance->CCR3;
+    TurnMotor();
+    SupplyBus();
+    PowerMeter_Tick();
+    Sequencer_Tick();
+    SpeedControl_Tick();
+    RideThrough_Tick();
+    MotorComp_Tick();
+    FreqControl_Update();
+    SampleLoad();
+    controlTicks++;
+    nextTickUs += CONTROL_TICK_US;
+  }
+
+  /* Bytes from the client go on the virtual line (the pty holds the rest) */
+  while ((space = FakeHal_UartFeedSpace()) > 0 &&
+         (length = read(ptyFd, buffer, space < sizeof(buffer) ? space : sizeof(buffer))) > 0)
+  {
+    FakeHal_UartFeed(buffer, (uint32_t)length);
+  }
+
+  /* USART2 IRQ (idle line), then the TIM16 one-pulse gap */
+  if (FakeHal_UartService(now))
+  {
+    SerialComm_UART_IRQHandler();
+  }
+  if (FakeHal_TimerAdvance(&htim16, (uint32_t)(now - lastServiceUs)))
+  {
+    htim16.Instance->SR &= ~TIM_SR_UIF;
+    SerialComm_GapTimerElapsed();
+  }
+  lastServiceUs = now;
+}
+
+static void OnSignal(int sig)
+{
+  (void)sig;
+  stopRequested = 1;
+}
@@ -0,0 +1,239 @@
+/**
+ * @file stm32f0xx_hal.h
+ * @brief HAL mínima para compilar o firmware no host (banco de testes serial)
+ *
+ * Only what the firmware modules linked into the stand-in use. Peripheral
+ * registers are plain structures in RAM; fake_hal.c plays the hardware side
+ * (UART bytes from a pty, DMA counter, gap timer, control tick).
+ */
+
+#ifndef __STM32F0XX_HAL_H
+#define __STM32F0XX_HAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#define __IO volatile
+typedef enum { HAL_OK=0, HAL_ERROR, HAL_BUSY, HAL_TIMEOUT } HAL_StatusTypeDef;
+typedef enum { RESET=0, SET=1 } FlagStatus;
+typedef enum { DISABLE=0, ENABLE=1 } FunctionalState;
+typedef struct { __IO uint32_t CR1,CR2,SMCR,DIER,SR,EGR,CCMR1,CCMR2,CCER,CNT,PSC,ARR,RCR,CCR1,CCR2,CCR3,CCR4,BDTR,DCR,DMAR; } TIM_TypeDef;
+typedef struct { __IO uint32_t CR1,CR2,CR3,BRR,GTPR,RTOR,RQR,ISR,ICR,RDR,TDR; } USART_TypeDef;
+typedef struct { __IO uint32_t ISR,IER,CR,CFGR1,CFGR2,SMPR,r0,r1,TR,r2,CHSELR,r3[5],DR; } ADC_TypeDef;
+typedef struct { __IO uint32_t CCR,CNDTR,CPAR,CMAR; } DMA_Channel_TypeDef;
+typedef struct { __IO uint32_t MODER,OTYPER,OSPEEDR,PUPDR,IDR,ODR,BSRR,LCKR,AFR[2],BRR; } GPIO_TypeDef;
+extern TIM_TypeDef *TIM1,*TIM3,*TIM6,*TIM14,*TIM15,*TIM16,*TIM17;
+extern USART_TypeDef *USART1,*USART2;
+extern ADC_TypeDef *ADC1;
+extern GPIO_TypeDef *GPIOA,*GPIOB,*GPIOC;
+extern DMA_Channel_TypeDef *DMA1_Channel1,*DMA1_Channel2,*DMA1_Channel3,*DMA1_Channel4,*DMA1_Channel5;
+#define TIM_CR1_CEN (1u<<0)
+#define TIM_CR1_UDIS (1u<<1)
+#define TIM_CR1_URS (1u<<2)
+#define TIM_CR1_OPM (1u<<3)
+#define TIM_CR1_DIR (1u<<4)
+#define TIM_CR1_CMS (3u<<5)
+#define TIM_CR1_ARPE (1u<<7)
+#define TIM_CR2_CCPC (1u<<0)
+#define TIM_CR2_CCUS (1u<<2)
+#define TIM_CR2_CCDS (1u<<3)
+#define TIM_CR2_MMS (7u<<4)
+#define TIM_SR_UIF (1u<<0)
+#define TIM_SR_CC1IF (1u<<1)
+#define TIM_SR_CC4IF (1u<<4)
+#define TIM_SR_COMIF (1u<<5)
+#define TIM_SR_BIF (1u<<7)
+#define TIM_DIER_UIE (1u<<0)
+#define TIM_DIER_UDE (1u<<8)
+#define TIM_DIER_CC1DE (1u<<9)
+#define TIM_EGR_UG (1u<<0)
+#define TIM_EGR_COMG (1u<<5)
+#define TIM_CCMR1_OC1M (7u<<4)
+#define TIM_CCMR1_OC1M_1 (2u<<4)
+#define TIM_CCMR1_OC1M_2 (4u<<4)
+#define TIM_CCMR1_OC2M (7u<<12)
+#define TIM_CCMR1_OC2M_1 (2u<<12)
+#define TIM_CCMR1_OC2M_2 (4u<<12)
+#define TIM_CCMR2_OC3M (7u<<4)
+#define TIM_CCMR2_OC3M_1 (2u<<4)
+#define TIM_CCMR2_OC3M_2 (4u<<4)
+#define IS_TIM_BREAK_INSTANCE(i) ((i) == TIM1 || (i) == TIM15 || (i) == TIM16 || (i) == TIM17)
+#define TIM_CCMR1_OC1PE (1u<<3)
+#define TIM_CCMR1_OC2PE (1u<<11)
+#define TIM_CCMR2_OC3PE (1u<<3)
+#define TIM_CCMR2_OC4PE (1u<<11)
+#define TIM_CCER_CC1E (1u<<0)
+#define TIM_CCER_CC1NE (1u<<2)
+#define TIM_CCER_CC2E (1u<<4)
+#define TIM_CCER_CC2NE (1u<<6)
+#define TIM_CCER_CC3E (1u<<8)
+#define TIM_CCER_CC3NE (1u<<10)
+#define TIM_BDTR_MOE (1u<<15)
+#define TIM_BDTR_DTG (0xFFu)
+#define TIM_DCR_DBA_Pos 0
+#define TIM_DCR_DBL_Pos 8
+#define USART_ISR_IDLE (1u<<4)
+#define USART_ISR_RXNE (1u<<5)
+#define USART_ISR_TC (1u<<6)
+#define USART_ICR_IDLECF (1u<<4)
+#define USART_CR1_IDLEIE (1u<<4)
+#define DMA_CCR_EN (1u<<0)
+typedef struct { uint32_t Prescaler, CounterMode, Period, ClockDivision, RepetitionCounter, AutoReloadPreload; } TIM_Base_InitTypeDef;
+typedef struct __DMA_HandleTypeDef DMA_HandleTypeDef;
+typedef enum { HAL_TIM_STATE_RESET=0, HAL_TIM_STATE_READY } HAL_TIM_StateTypeDef;
+typedef struct { TIM_TypeDef *Instance; TIM_Base_InitTypeDef Init; uint32_t Channel; DMA_HandleTypeDef *hdma[7]; HAL_TIM_StateTypeDef State; } TIM_HandleTypeDef;
+typedef struct { uint32_t Direction, PeriphInc, MemInc, PeriphDataAlignment, MemDataAlignment, Mode, Priority; } DMA_InitTypeDef;
+struct __DMA_HandleTypeDef { DMA_Channel_TypeDef *Instance; DMA_InitTypeDef Init; void *Parent; };
+typedef struct { uint32_t BaudRate, WordLength, StopBits, Parity, Mode, HwFlowCtl, OverSampling; } UART_InitTypeDef;
+typedef enum { HAL_UART_STATE_RESET=0, HAL_UART_STATE_READY=0x20, HAL_UART_STATE_BUSY_TX=0x21 } HAL_UART_StateTypeDef;
+typedef struct { USART_TypeDef *Instance; UART_InitTypeDef Init; DMA_HandleTypeDef *hdmarx, *hdmatx; uint8_t *pRxBuffPtr; uint16_t RxXferSize; volatile HAL_UART_StateTypeDef gState; } UART_HandleTypeDef;
+typedef struct { uint32_t ClockPrescaler, Resolution, DataAlign, ScanConvMode, EOCSelection, LowPowerAutoWait, LowPowerAutoPowerOff, ContinuousConvMode, DiscontinuousConvMode, ExternalTrigConv, ExternalTrigConvEdge, DMAContinuousRequests, Overrun, SamplingTimeCommon; } ADC_InitTypeDef;
+typedef struct { ADC_TypeDef *Instance; ADC_InitTypeDef Init; DMA_HandleTypeDef *DMA_Handle; } ADC_HandleTypeDef;
+typedef struct { uint32_t Channel, Rank, SamplingTime; } ADC_ChannelConfTypeDef;
+typedef struct { uint32_t Pin, Mode, Pull, Speed, Alternate; } GPIO_InitTypeDef;
+typedef enum { GPIO_PIN_RESET=0, GPIO_PIN_SET } GPIO_PinState;
+typedef struct { uint32_t MasterOutputTrigger, MasterSlaveMode; } TIM_MasterConfigTypeDef;
+typedef struct { uint32_t OCMode, Pulse, OCPolarity, OCNPolarity, OCFastMode, OCIdleState, OCNIdleState; } TIM_OC_InitTypeDef;
+typedef struct { uint32_t OffStateRunMode, OffStateIDLEMode, LockLevel, DeadTime, BreakState, BreakPolarity, AutomaticOutput; } TIM_BreakDeadTimeConfigTypeDef;
+typedef struct { uint32_t EncoderMode, IC1Polarity, IC1Selection, IC1Prescaler, IC1Filter, IC2Polarity, IC2Selection, IC2Prescaler, IC2Filter; } TIM_Encoder_InitTypeDef;
+typedef struct { uint32_t ClockSource, ClockPolarity, ClockPrescaler, ClockFilter; } TIM_ClockConfigTypeDef;
+typedef struct { uint32_t OscillatorType, HSIState, HSICalibrationValue; struct { uint32_t PLLState, PLLSource, PLLMUL, PREDIV; } PLL; } RCC_OscInitTypeDef;
+typedef struct { uint32_t ClockType, SYSCLKSource, AHBCLKDivider, APB1CLKDivider; } RCC_ClkInitTypeDef;
+typedef enum { DMA1_Channel1_IRQn=9, DMA1_Channel2_3_IRQn=10, DMA1_Channel4_5_IRQn=11, ADC1_IRQn=12, TIM1_BRK_UP_TRG_COM_IRQn=13, TIM1_CC_IRQn=14, TIM3_IRQn=16, TIM6_IRQn=17, TIM14_IRQn=19, TIM15_IRQn=20, TIM16_IRQn=21, TIM17_IRQn=22, USART1_IRQn=27, USART2_IRQn=28, SysTick_IRQn=-1 } IRQn_Type;
+/* constants */
+enum { TIM_CHANNEL_1=0, TIM_CHANNEL_2=4, TIM_CHANNEL_3=8, TIM_CHANNEL_4=12, TIM_CHANNEL_ALL=0x3C };
+enum { TIM_COUNTERMODE_UP, TIM_COUNTERMODE_CENTERALIGNED1, TIM_CLOCKDIVISION_DIV1, TIM_AUTORELOAD_PRELOAD_ENABLE, TIM_AUTORELOAD_PRELOAD_DISABLE,
+ TIM_TRGO_RESET, TIM_TRGO_UPDATE, TIM_TRGO_OC4REF, TIM_MASTERSLAVEMODE_DISABLE, TIM_OCMODE_PWM1, TIM_OCMODE_PWM2, TIM_OCMODE_TIMING, TIM_OCPOLARITY_HIGH, TIM_OCPOLARITY_LOW,
+ TIM_OCNPOLARITY_HIGH, TIM_OCNPOLARITY_LOW, TIM_OCFAST_DISABLE, TIM_OCIDLESTATE_RESET, TIM_OCIDLESTATE_SET, TIM_OCNIDLESTATE_RESET, TIM_OCNIDLESTATE_SET,
+ TIM_OSSR_DISABLE, TIM_OSSR_ENABLE, TIM_OSSI_DISABLE, TIM_OSSI_ENABLE, TIM_LOCKLEVEL_OFF, TIM_LOCKLEVEL_1, TIM_BREAK_DISABLE, TIM_BREAK_ENABLE, TIM_BREAKPOLARITY_HIGH, TIM_BREAKPOLARITY_LOW,
+ TIM_AUTOMATICOUTPUT_DISABLE, TIM_ENCODERMODE_TI12, TIM_ICPOLARITY_RISING, TIM_ICSELECTION_DIRECTTI, TIM_ICPSC_DIV1, TIM_CLOCKSOURCE_INTERNAL,
+ TIM_DMA_UPDATE, TIM_DMA_CC4, TIM_IT_UPDATE, TIM_IT_CC4, TIM_IT_BREAK, TIM_FLAG_UPDATE, TIM_FLAG_BREAK, TIM_DMABASE_CCR1, TIM_DMABURSTLENGTH_3TRANSFERS, TIM_OPMODE_SINGLE, TIM_COMMUTATION_SOFTWARE, TIM_TS_NONE, TIM_DMA_ID_UPDATE=1, TIM_DMA_ID_CC1=2 };
+enum { UART_WORDLENGTH_8B, UART_STOPBITS_1, UART_PARITY_NONE, UART_MODE_TX_RX, UART_HWCONTROL_NONE, UART_OVERSAMPLING_16, UART_IT_IDLE, UART_FLAG_IDLE, UART_CLEAR_IDLEF, UART_IT_RXNE };
+enum { DMA_PERIPH_TO_MEMORY, DMA_MEMORY_TO_PERIPH, DMA_MEMORY_TO_MEMORY, DMA_PINC_DISABLE, DMA_PINC_ENABLE, DMA_MINC_ENABLE, DMA_MINC_DISABLE, DMA_PDATAALIGN_BYTE, DMA_PDATAALIGN_HALFWORD, DMA_PDATAALIGN_WORD,
+ DMA_MDATAALIGN_BYTE, DMA_MDATAALIGN_HALFWORD, DMA_MDATAALIGN_WORD, DMA_NORMAL, DMA_CIRCULAR, DMA_PRIORITY_LOW, DMA_PRIORITY_MEDIUM, DMA_PRIORITY_HIGH, DMA_PRIORITY_VERY_HIGH };
+enum { ADC_CLOCK_SYNC_PCLK_DIV2, ADC_CLOCK_SYNC_PCLK_DIV4, ADC_RESOLUTION_12B, ADC_DATAALIGN_RIGHT, ADC_SCAN_DIRECTION_FORWARD, ADC_SCAN_DIRECTION_BACKWARD, ADC_EOC_SEQ_CONV, ADC_EOC_SINGLE_CONV, ADC_EXTERNALTRIGCONV_T1_TRGO, ADC_EXTERNALTRIGCONV_T1_CC4,
+ ADC_EXTERNALTRIGCONVEDGE_RISING, ADC_OVR_DATA_OVERWRITTEN, ADC_SAMPLETIME_7CYCLES_5, ADC_SAMPLETIME_13CYCLES_5, ADC_SAMPLETIME_28CYCLES_5, ADC_SAMPLETIME_239CYCLES_5, ADC_RANK_CHANNEL_NUMBER,
+ ADC_CHANNEL_0, ADC_CHANNEL_1, ADC_CHANNEL_4, ADC_CHANNEL_8, ADC_CHANNEL_9, ADC_CHANNEL_10, ADC_CHANNEL_11, ADC_CHANNEL_12, ADC_CHANNEL_13 };
+enum { GPIO_MODE_INPUT, GPIO_MODE_OUTPUT_PP, GPIO_MODE_AF_PP, GPIO_MODE_ANALOG, GPIO_NOPULL, GPIO_PULLUP, GPIO_PULLDOWN, GPIO_SPEED_FREQ_LOW, GPIO_SPEED_FREQ_HIGH,
+ GPIO_AF0_USART1, GPIO_AF1_USART2, GPIO_AF2_TIM1, GPIO_AF1_TIM3, GPIO_AF0_TIM15, GPIO_AF1_TIM15, GPIO_AF2_TIM16, GPIO_AF0_TIM14, GPIO_AF4_TIM14 };
+#define GPIO_PIN_0 0x1u
+#define GPIO_PIN_1 0x2u
+#define GPIO_PIN_2 0x4u
+#define GPIO_PIN_3 0x8u
+#define GPIO_PIN_4 0x10u
+#define GPIO_PIN_5 0x20u
+#define GPIO_PIN_6 0x40u
+#define GPIO_PIN_7 0x80u
+#define GPIO_PIN_8 0x100u
+#define GPIO_PIN_9 0x200u
+#define GPIO_PIN_10 0x400u
+#define GPIO_PIN_11 0x800u
+#define GPIO_PIN_12 0x1000u
+#define GPIO_PIN_13 0x2000u
+#define GPIO_PIN_14 0x4000u
+#define GPIO_PIN_15 0x8000u
+enum { RCC_OSCILLATORTYPE_HSI, RCC_HSI_ON, RCC_HSICALIBRATION_DEFAULT, RCC_PLL_OFF, RCC_CLOCKTYPE_HCLK=1, RCC_CLOCKTYPE_SYSCLK=2, RCC_CLOCKTYPE_PCLK1=4, RCC_SYSCLKSOURCE_HSI, RCC_SYSCLK_DIV1, RCC_HCLK_DIV1, FLASH_LATENCY_0 };
+#define TICK_INT_PRIORITY 3u
+/* functions */
+HAL_StatusTypeDef HAL_Init(void);
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t);
+void HAL_IncTick(void);
+HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef*);
+HAL_StatusTypeDef HAL_RCC_ClockConfig(RCC_ClkInitTypeDef*, uint32_t);
+uint32_t HAL_RCC_GetPCLK1Freq(void);
+uint32_t HAL_RCC_GetSysClockFreq(void);
+void HAL_GPIO_Init(GPIO_TypeDef*, GPIO_InitTypeDef*);
+void HAL_GPIO_WritePin(GPIO_TypeDef*, uint16_t, GPIO_PinState);
+void HAL_GPIO_TogglePin(GPIO_TypeDef*, uint16_t);
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef*);
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef*, uint8_t*, uint16_t, uint32_t);
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef*, uint8_t*, uint16_t);
+HAL_StatusTypeDef HAL_UART_Receive_IT(UART_HandleTypeDef*, uint8_t*, uint16_t);
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef*, uint8_t*, uint16_t);
+HAL_StatusTypeDef HAL_UART_AbortReceive(UART_HandleTypeDef*);
+HAL_StatusTypeDef HAL_UART_Abort(UART_HandleTypeDef*);
+void HAL_UART_IRQHandler(UART_HandleTypeDef*);
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef*);
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef*);
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef*);
+HAL_StatusTypeDef HAL_DMA_Start(DMA_HandleTypeDef*, uint32_t, uint32_t, uint32_t);
+HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef*);
+void HAL_DMA_IRQHandler(DMA_HandleTypeDef*);
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef*);
+HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef*);
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef*);
+HAL_StatusTypeDef HAL_TIM_Base_Stop(TIM_HandleTypeDef*);
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef*);
+HAL_StatusTypeDef HAL_TIM_OnePulse_Init(TIM_HandleTypeDef*, uint32_t);
+HAL_StatusTypeDef HAL_TIM_PWM_Init(TIM_HandleTypeDef*);
+HAL_StatusTypeDef HAL_TIM_PWM_ConfigChannel(TIM_HandleTypeDef*, TIM_OC_InitTypeDef*, uint32_t);
+HAL_StatusTypeDef HAL_TIM_OC_ConfigChannel(TIM_HandleTypeDef*, TIM_OC_InitTypeDef*, uint32_t);
+HAL_StatusTypeDef HAL_TIM_OC_Start(TIM_HandleTypeDef*, uint32_t);
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef*, uint32_t);
+HAL_StatusTypeDef HAL_TIM_PWM_Stop(TIM_HandleTypeDef*, uint32_t);
+HAL_StatusTypeDef HAL_TIMEx_PWMN_Start(TIM_HandleTypeDef*, uint32_t);
+HAL_StatusTypeDef HAL_TIMEx_PWMN_Stop(TIM_HandleTypeDef*, uint32_t);
+HAL_StatusTypeDef HAL_TIMEx_MasterConfigSynchronization(TIM_HandleTypeDef*, TIM_MasterConfigTypeDef*);
+HAL_StatusTypeDef HAL_TIMEx_ConfigBreakDeadTime(TIM_HandleTypeDef*, TIM_BreakDeadTimeConfigTypeDef*);
+HAL_StatusTypeDef HAL_TIMEx_ConfigCommutEvent(TIM_HandleTypeDef*, uint32_t, uint32_t);
+HAL_StatusTypeDef HAL_TIM_Encoder_Init(TIM_HandleTypeDef*, TIM_Encoder_InitTypeDef*);
+HAL_StatusTypeDef HAL_TIM_Encoder_Start(TIM_HandleTypeDef*, uint32_t);
+HAL_StatusTypeDef HAL_TIM_ConfigClockSource(TIM_HandleTypeDef*, TIM_ClockConfigTypeDef*);
+HAL_StatusTypeDef HAL_TIM_DMABurst_WriteStart(TIM_HandleTypeDef*, uint32_t, uint32_t, uint32_t*, uint32_t);
+HAL_StatusTypeDef HAL_TIM_DMABurst_WriteStop(TIM_HandleTypeDef*, uint32_t);
+void HAL_TIM_IRQHandler(TIM_HandleTypeDef*);
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef*);
+HAL_StatusTypeDef HAL_ADC_Init(ADC_HandleTypeDef*);
+HAL_StatusTypeDef HAL_ADC_ConfigChannel(ADC_HandleTypeDef*, ADC_ChannelConfTypeDef*);
+HAL_StatusTypeDef HAL_ADCEx_Calibration_Start(ADC_HandleTypeDef*);
+HAL_StatusTypeDef HAL_ADC_Start_DMA(ADC_HandleTypeDef*, uint32_t*, uint32_t);
+void HAL_ADC_IRQHandler(ADC_HandleTypeDef*);
+void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef*);
+void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef*);
+void HAL_NVIC_SetPriority(IRQn_Type, uint32_t, uint32_t);
+void HAL_NVIC_EnableIRQ(IRQn_Type);
+void HAL_NVIC_DisableIRQ(IRQn_Type);
+void __disable_irq(void); void __enable_irq(void); void __DMB(void); void __DSB(void); void __NOP(void);
+uint32_t __get_PRIMASK(void); void __set_PRIMASK(uint32_t);
+#define __HAL_TIM_SET_COMPARE(h,c,v) ((void)(h),(void)(c),(void)(v))
+#define __HAL_TIM_GET_COMPARE(h,c) ((void)(h),(void)(c),0u)
+#define __HAL_TIM_SET_AUTORELOAD(h,v) ((h)->Instance->ARR=(v))
+#define __HAL_TIM_GET_AUTORELOAD(h) ((h)->Instance->ARR)
+#define __HAL_TIM_SET_COUNTER(h,v) ((h)->Instance->CNT=(v))
+#define __HAL_TIM_GET_COUNTER(h) ((h)->Instance->CNT)
+#define __HAL_TIM_MOE_ENABLE(h) ((h)->Instance->BDTR|=TIM_BDTR_MOE)
+#define __HAL_TIM_MOE_DISABLE(h) ((h)->Instance->BDTR&=~TIM_BDTR_MOE)
+#define __HAL_TIM_MOE_DISABLE_UNCONDITIONALLY(h) ((h)->Instance->BDTR&=~TIM_BDTR_MOE)
+#define __HAL_TIM_ENABLE_IT(h,i) ((h)->Instance->DIER|=TIM_DIER_UIE)
+#define __HAL_TIM_DISABLE_IT(h,i) ((h)->Instance->DIER&=~TIM_DIER_UIE)
+#define __HAL_TIM_CLEAR_FLAG(h,f) ((h)->Instance->SR&=~TIM_SR_UIF)
+#define __HAL_TIM_CLEAR_IT(h,f) ((void)(h),(void)(f))
+#define __HAL_TIM_GET_FLAG(h,f) ((void)(h),(void)(f),0)
+#define __HAL_TIM_ENABLE_DMA(h,d) ((void)(h),(void)(d))
+#define __HAL_TIM_DISABLE_DMA(h,d) ((void)(h),(void)(d))
+#define __HAL_TIM_ENABLE(h) ((h)->Instance->CR1|=TIM_CR1_CEN)
+#define __HAL_TIM_DISABLE(h) ((h)->Instance->CR1&=~TIM_CR1_CEN)
+#define __HAL_TIM_IS_TIM_COUNTING_DOWN(h) (((h)->Instance->CR1 & TIM_CR1_DIR) == TIM_CR1_DIR)
+#define __HAL_TIM_URS_ENABLE(h) ((h)->Instance->CR1|=TIM_CR1_URS)
+#define __HAL_UART_ENABLE_IT(h,i) ((h)->Instance->CR1|=USART_CR1_IDLEIE)
+#define __HAL_UART_DISABLE_IT(h,i) ((h)->Instance->CR1&=~USART_CR1_IDLEIE)
+#define __HAL_UART_GET_FLAG(h,f) (((h)->Instance->ISR&USART_ISR_IDLE)!=0)
+#define __HAL_UART_CLEAR_FLAG(h,f) ((void)(h),(void)(f))
+#define __HAL_UART_CLEAR_IDLEFLAG(h) ((h)->Instance->ISR&=~USART_ISR_IDLE)
+#define __HAL_DMA_GET_COUNTER(h) ((h)->Instance->CNDTR)
+#define __HAL_LINKDMA(p,f,d) do{(p)->f=&(d);(d).Parent=(p);}while(0)
+#define __HAL_RCC_GPIOA_CLK_ENABLE() ((void)0)
+#define __HAL_RCC_GPIOB_CLK_ENABLE() ((void)0)
+#define __HAL_RCC_GPIOC_CLK_ENABLE() ((void)0)
+#define __HAL_RCC_USART2_CLK_ENABLE() ((void)0)
+#define __HAL_RCC_TIM1_CLK_ENABLE() ((void)0)
+#define __HAL_RCC_TIM3_CLK_ENABLE() ((void)0)
+#define __HAL_RCC_TIM6_CLK_ENABLE() ((void)0)
+#define __HAL_RCC_TIM14_CLK_ENABLE() ((void)0)
+#define __HAL_RCC_TIM15_CLK_ENABLE() ((void)0)
+#define __HAL_RCC_TIM16_CLK_ENABLE() ((void)0)
+#define __HAL_RCC_TIM17_CLK_ENABLE() ((void)0)
+#define __HAL_RCC_DMA1_CLK_ENABLE() ((void)0)
+#define __HAL_RCC_ADC1_CLK_ENABLE() ((void)0)
+#define __HAL_DBGMCU_FREEZE_TIM1() ((void)0)
+#endif /* __STM32F0XX_HAL_H */
@@ -0,0 +1,61 @@
+/**
+ * @file pty_port.c
+ * @brief Pseudo-terminal que faz o papel da USART2 no host
+ *
+ * Kept apart from the HAL headers: <termios.h> defines CR1, which is also a
+ * register name in the peripheral structures.
+ */
+
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+
+#include "pty_port.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+/**
+ * @brief Opens a pty pair in raw mode and prints the slave path on stdout
+ * @param linkPath Optional symlink to the slave (NULL for none)
+ * @retval Master descriptor (non-blocking), -1 on error
+ */
+int PtyPort_Open(const char* linkPath)
+{
+  struct termios tio;
+  const char* slaveName;
+  int master, slave;
+
+  master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+  {
+    perror("fw_standin: posix_openpt");
+    return -1;
+  }
+  slaveName = ptsname(master);
+
+  /* Keep one slave descriptor open: raw line, and no EIO when the client leaves */
+  slave = open(slaveName, O_RDWR | O_NOCTTY);
+  if (slave < 0 || tcgetattr(slave, &tio) != 0)
+  {
+    perror("fw_standin: slave");
+    return -1;
+  }
+  cfmakeraw(&tio);
+  tcsetattr(slave, TCSANOW, &tio);
+  fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+  if (linkPath != NULL)
+  {
+    unlink(linkPath);
+    if (symlink(slaveName, linkPath) != 0)
+    {
+      perror("fw_standin: symlink");
+    }
+  }
+
+  printf("%s\n", slaveName);
+  fflush(stdout);
+  return master;
+}
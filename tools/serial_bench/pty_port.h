@@ -0,0 +1,20 @@
+/**
+ * @file pty_port.h
+ * @brief Pseudo-terminal que faz o papel da USART2 no host
+ */
+
+#ifndef __PTY_PORT_H
+#define __PTY_PORT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Public functions */
+int PtyPort_Open(const char* linkPath);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PTY_PORT_H */
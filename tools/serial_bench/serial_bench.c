@@ -0,0 +1,574 @@
+/**
+ * @file serial_bench.c
+ * @brief Benchmark ponta a ponta do protocolo serial (ASCII e Modbus RTU)
+ *
+ * Floods the inverter (the host stand-in through its pty, or a real board
+ * through its USB-serial adapter) with setpoint writes and status reads at a
+ * configurable rate and window, and reports throughput, latency percentiles
+ * and the commands whose reply never came (lost) or came wrong (garbled).
+ *
+ * Every read is checked against the setpoint written just before it, so a
+ * command that was corrupted on the way in shows up even when the firmware
+ * answered something plausible.
+ *
+ * Usage: serial_bench -d device [-m ascii|modbus] [-n count] [-r rate]
+ *                     [-w window] [-a address] [-T timeout ms] [-v]
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Defines */
+#define MAX_WINDOW          64
+#define LINE_SIZE           128
+#define RX_SIZE             1024
+
+#define MB_FC_READ          0x03
+#define MB_FC_WRITE         0x06
+#define MB_REG_FREQ         0x0000
+#define MB_REG_PROTOCOL     0x0005
+#define MB_READ_COUNT       4           /* Setpoint .. actual frequency */
+
+/* Types */
+typedef enum { MODE_ASCII, MODE_MODBUS } BenchMode_t;
+typedef enum { CMD_SET, CMD_READ } CmdKind_t;
+
+typedef struct {
+  CmdKind_t kind;
+  uint32_t setpoint;                  /* 0.1 Hz (ASCII) / 0.01 Hz (Modbus) */
+  uint64_t sentUs;
+} Pending_t;
+
+/* Private variables */
+static int fd = -1;
+static BenchMode_t mode = MODE_ASCII;
+static uint8_t address = 1;
+static int verbose = 0;
+
+static Pending_t pending[MAX_WINDOW];
+static unsigned pendingHead, pendingCount;
+
+static uint32_t* latencies;
+static unsigned okCount, lostCount, garbledCount;
+
+static uint8_t rxData[RX_SIZE];
+static unsigned rxLength;
+static uint64_t rxLastUs;
+static unsigned statusLines = 1;        /* Lines of a STATUS reply */
+static unsigned linesLeft = 0;          /* Of the reply being received */
+
+/* Private function prototypes */
+static uint64_t Micros(void);
+static int OpenPort(const char* device);
+static void SendCommand(CmdKind_t kind, uint32_t setpoint);
+static void ReceiveReplies(int timeoutUs);
+static void ReceiveRaw(int timeoutUs);
+static void ParseAsciiLines(void);
+static void ParseModbusFrames(void);
+static void MatchAscii(const char* line);
+static void Complete(int ok, const char* detail);
+static void ExpireOldest(uint64_t timeoutUs);
+static uint16_t Crc16(const uint8_t* data, unsigned length);
+static unsigned CountStatusLines(void);
+static int EnterModbus(void);
+static void LeaveModbus(void);
+static int CompareU32(const void* a, const void* b);
+static void Report(unsigned sent, uint64_t elapsedUs);
+
+int main(int argc, char** argv)
+{
+  const char* device = NULL;
+  unsigned count = 1000, window = 1, sent = 0;
+  double rate = 0.0;
+  uint64_t timeoutUs = 500000, startUs, nextSendUs, endUs;
+  uint32_t setpoint = 0, lastSet = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "d:m:n:r:w:a:T:v")) != -1)
+  {
+    switch (opt)
+    {
+      case 'd': device = optarg; break;
+      case 'm': mode = (strcmp(optarg, "modbus") == 0) ? MODE_MODBUS : MODE_ASCII; break;
+      case 'n': count = (unsigned)strtoul(optarg, NULL, 10); break;
+      case 'r': rate = strtod(optarg, NULL); break;
+      case 'w': window = (unsigned)strtoul(optarg, NULL, 10); break;
+      case 'a': address = (uint8_t)strtoul(optarg, NULL, 10); break;
+      case 'T': timeoutUs = strtoull(optarg, NULL, 10) * 1000ULL; break;
+      case 'v': verbose = 1; break;
+      default: device = NULL; optind = argc; break;
+    }
+  }
+  if (device == NULL || count == 0 || window == 0 || window > MAX_WINDOW)
+  {
+    fprintf(stderr, "usage: %s -d device [-m ascii|modbus] [-n count] [-r rate/s]\n"
+                    "          [-w window 1-%d] [-a address] [-T timeout ms] [-v]\n",
+            argv[0], MAX_WINDOW);
+    return 2;
+  }
+
+  fd = OpenPort(device);
+  latencies = calloc(count, sizeof(uint32_t));
+  if (fd < 0 || latencies == NULL)
+  {
+    return 2;
+  }
+  if (mode == MODE_ASCII)
+  {
+    statusLines = CountStatusLines();
+  }
+  if (mode == MODE_MODBUS && EnterModbus() != 0)
+  {
+    fprintf(stderr, "serial_bench: no OK to MODBUS %u\n", address);
+    return 2;
+  }
+
+  startUs = Micros();
+  nextSendUs = startUs;
+  while (sent < count || pendingCount > 0)
+  {
+    uint64_t now = Micros();
+
+    ExpireOldest(timeoutUs);
+
+    /* Writes and reads alternate; each read must return the last write.
+       A reply occupies its window slot until its last line. */
+    if (sent < count && pendingCount + (linesLeft > 0) < window && now >= nextSendUs)
+    {
+      if ((sent & 1) == 0)
+      {
+        setpoint = (mode == MODE_ASCII) ? 10 + (sent / 2) % 490 : 100 + (sent / 2) % 4900;
+        SendCommand(CMD_SET, setpoint);
+        lastSet = setpoint;
+      }
+      else
+      {
+        SendCommand(CMD_READ, lastSet);
+      }
+      sent++;
+      nextSendUs = (rate > 0.0) ? startUs + (uint64_t)(sent * 1000000.0 / rate) : now;
+      continue;
+    }
+
+    ReceiveReplies(200);
+  }
+  endUs = Micros();
+
+  if (mode == MODE_MODBUS)
+  {
+    LeaveModbus();
+  }
+  Report(sent, endUs - startUs);
+  return (lostCount + garbledCount) ? 1 : 0;
+}
+
+static uint64_t Micros(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000ULL + (uint64_t)now.tv_nsec / 1000ULL;
+}
+
+/**
+ * @brief Opens the serial device raw, 115200 8N1 (ignored by a pty)
+ * @retval Descriptor, -1 on error
+ */
+static int OpenPort(const char* device)
+{
+  struct termios tio;
+  int port = open(device, O_RDWR | O_NOCTTY | O_NONBLOCK);
+
+  if (port < 0)
+  {
+    perror(device);
+    return -1;
+  }
+  if (tcgetattr(port, &tio) == 0)
+  {
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, B115200);
+    cfsetospeed(&tio, B115200);
+    tcsetattr(port, TCSANOW, &tio);
+  }
+  tcflush(port, TCIOFLUSH);
+  return port;
+}
+
+/**
+ * @brief Writes one command and records it as pending
+ * @retval None
+ */
+static void SendCommand(CmdKind_t kind, uint32_t setpoint)
+{
+  uint8_t frame[LINE_SIZE];
+  Pending_t* cmd = &pending[(pendingHead + pendingCount) % MAX_WINDOW];
+  unsigned length, done = 0;
+  uint16_t crc;
+
+  if (mode == MODE_ASCII)
+  {
+    length = (kind == CMD_SET)
+           ? (unsigned)snprintf((char*)frame, sizeof(frame), "FREQ %u.%u\r", setpoint / 10, setpoint % 10)
+           : (unsigned)snprintf((char*)frame, sizeof(frame), "STATUS\r");
+  }
+  else
+  {
+    uint16_t value = (kind == CMD_SET) ? (uint16_t)setpoint : MB_READ_COUNT;
+
+    frame[0] = address;
+    frame[1] = (kind == CMD_SET) ? MB_FC_WRITE : MB_FC_READ;
+    frame[2] = 0;
+    frame[3] = MB_REG_FREQ;
+    frame[4] = (uint8_t)(value >> 8);
+    frame[5] = (uint8_t)value;
+    crc = Crc16(frame, 6);
+    frame[6] = (uint8_t)crc;
+    frame[7] = (uint8_t)(crc >> 8);
+    length = 8;
+  }
+
+  cmd->kind = kind;
+  cmd->setpoint = setpoint;
+  cmd->sentUs = Micros();
+  pendingCount++;
+
+  while (done < length)
+  {
+    ssize_t n = write(fd, frame + done, length - done);
+
+    if (n > 0)
+      done += (unsigned)n;
+    else if (n < 0 && errno != EAGAIN && errno != EINTR)
+      return;
+    else
+      ReceiveReplies(100);
+  }
+}
+
+/**
+ * @brief Reads what is available and matches complete replies
+ * @param timeoutUs Longest wait for the first byte
+ * @retval None
+ */
+static void ReceiveReplies(int timeoutUs)
+{
+  ReceiveRaw(timeoutUs);
+  if (mode == MODE_ASCII)
+    ParseAsciiLines();
+  else
+    ParseModbusFrames();
+}
+
+/**
+ * @brief Appends the available bytes to rxData
+ * @param timeoutUs Longest wait for the first byte
+ * @retval None
+ */
+static void ReceiveRaw(int timeoutUs)
+{
+  struct pollfd pfd = { fd, POLLIN, 0 };
+  struct timespec wait = { 0, (long)timeoutUs * 1000L };
+  ssize_t n;
+
+  ppoll(&pfd, 1, &wait, NULL);
+  while (rxLength < RX_SIZE && (n = read(fd, rxData + rxLength, RX_SIZE - rxLength)) > 0)
+  {
+    rxLength += (unsigned)n;
+    rxLastUs = Micros();
+  }
+}
+
+static void ParseAsciiLines(void)
+{
+  char line[LINE_SIZE];
+  uint8_t* end;
+  unsigned length;
+
+  while ((end = memchr(rxData, '\n', rxLength)) != NULL)
+  {
+    length = (unsigned)(end - rxData);
+    if (length > 0 && rxData[length - 1] == '\r')
+      length--;
+    if (length >= LINE_SIZE)
+      length = LINE_SIZE - 1;
+    memcpy(line, rxData, length);
+    line[length] = '\0';
+
+    rxLength -= (unsigned)(end - rxData) + 1;
+    memmove(rxData, end + 1, rxLength);
+    if (length > 0)
+      MatchAscii(line);
+  }
+
+  /* A full buffer with no line end is noise */
+  if (rxLength == RX_SIZE)
+  {
+    garbledCount++;
+    rxLength = 0;
+  }
+}
+
+/**
+ * @brief Matches a reply line with the oldest pending commands
+ * @note Replies come back in order: a reply that matches a later command
+ *       means the earlier ones were lost. Latency is taken at the first
+ *       line; the STATUS continuation lines are only counted.
+ * @retval None
+ */
+static void MatchAscii(const char* line)
+{
+  char expected[LINE_SIZE];
+  unsigned i;
+
+  if (strncmp(line, "Status:", 7) != 0 && strcmp(line, "OK") != 0 &&
+      strncmp(line, "ERROR", 5) != 0 && strncmp(line, "Unknown", 7) != 0)
+  {
+    if (linesLeft > 0)
+    {
+      linesLeft--;
+    }
+    else
+    {
+      garbledCount++;
+      if (verbose)
+        fprintf(stderr, "unexpected: %s\n", line);
+    }
+    return;
+  }
+  linesLeft = (strncmp(line, "Status:", 7) == 0) ? statusLines - 1 : 0;
+
+  for (i = 0; i < pendingCount; i++)
+  {
+    const Pending_t* cmd = &pending[(pendingHead + i) % MAX_WINDOW];
+    const char* freq = strstr(line, "Frequency: ");
+
+    if (cmd->kind == CMD_SET && strcmp(line, "OK") == 0)
+      break;
+    snprintf(expected, sizeof(expected), "Frequency: %u.%u Hz", cmd->setpoint / 10, cmd->setpoint % 10);
+    if (cmd->kind == CMD_READ && freq != NULL && strcmp(freq, expected) == 0)
+      break;
+  }
+
+  if (i == pendingCount)
+  {
+    /* Nothing pending answers like this: the oldest command got it wrong */
+    if (pendingCount > 0)
+      Complete(0, line);
+    else
+      garbledCount++;
+    return;
+  }
+
+  while (i-- > 0)
+  {
+    Complete(-1, "no reply");
+  }
+  Complete(1, NULL);
+}
+
+static void ParseModbusFrames(void)
+{
+  const Pending_t* cmd;
+  unsigned expected;
+  uint16_t value;
+
+  while (pendingCount > 0 && rxLength >= 5)
+  {
+    cmd = &pending[pendingHead];
+    if (rxData[1] & 0x80)
+      expected = 5;
+    else
+      expected = (cmd->kind == CMD_SET) ? 8 : 5 + 2 * MB_READ_COUNT;
+    if (rxLength < expected)
+      return;
+
+    if (Crc16(rxData, expected) != 0 || rxData[0] != address)
+    {
+      /* Lost framing: drop everything received so far */
+      Complete(0, "bad CRC or address");
+      rxLength = 0;
+      return;
+    }
+
+    value = (cmd->kind == CMD_SET) ? (uint16_t)((rxData[4] << 8) | rxData[5])
+                                   : (uint16_t)((rxData[3] << 8) | rxData[4]);
+    Complete((rxData[1] & 0x80) == 0 && value == cmd->setpoint,
+             (rxData[1] & 0x80) ? "exception" : "wrong value");
+    rxLength -= expected;
+    memmove(rxData, rxData + expected, rxLength);
+  }
+
+  /* Bytes with nothing pending */
+  if (pendingCount == 0 && rxLength > 0 && Micros() - rxLastUs > 5000)
+  {
+    garbledCount++;
+    rxLength = 0;
+  }
+}
+
+/**
+ * @brief Retires the oldest pending command (replies come in order)
+ * @param ok 1=correct reply, 0=garbled, -1=lost
+ * @retval None
+ */
+static void Complete(int ok, const char* detail)
+{
+  const Pending_t* cmd = &pending[pendingHead];
+
+  if (ok > 0)
+  {
+    latencies[okCount++] = (uint32_t)(Micros() - cmd->sentUs);
+  }
+  else
+  {
+    if (ok < 0)
+      lostCount++;
+    else
+      garbledCount++;
+    if (verbose && detail != NULL)
+      fprintf(stderr, "%s %s %u: %s\n", ok < 0 ? "lost" : "garbled",
+              cmd->kind == CMD_SET ? "set" : "read", cmd->setpoint, detail);
+  }
+
+  pendingHead = (pendingHead + 1) % MAX_WINDOW;
+  pendingCount--;
+}
+
+static void ExpireOldest(uint64_t timeoutUs)
+{
+  /* Continuation lines that never came free their slot too */
+  if (linesLeft > 0 && Micros() - rxLastUs > timeoutUs)
+  {
+    linesLeft = 0;
+  }
+  while (pendingCount > 0 && Micros() - pending[pendingHead].sentUs > timeoutUs)
+  {
+    Complete(-1, "timeout");
+    if (mode == MODE_MODBUS)
+      rxLength = 0;
+  }
+}
+
+static uint16_t Crc16(const uint8_t* data, unsigned length)
+{
+  uint16_t crc = 0xFFFF;
+  unsigned bit;
+
+  while (length--)
+  {
+    crc ^= *data++;
+    for (bit = 0; bit < 8; bit++)
+      crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+  }
+  return crc;
+}
+
+/**
+ * @brief Learns how many lines a STATUS reply has (firmware dependent)
+ * @retval Line count, at least 1
+ */
+static unsigned CountStatusLines(void)
+{
+  uint64_t quietUs = Micros() + 200000ULL;
+  unsigned lines = 0, i;
+
+  if (write(fd, "STATUS\r", 7) != 7)
+    return 1;
+
+  /* The reply is over after 200 ms of silence */
+  while (Micros() < quietUs)
+  {
+    unsigned before = rxLength;
+
+    ReceiveRaw(1000);
+    if (rxLength != before)
+      quietUs = Micros() + 200000ULL;
+  }
+  for (i = 0; i < rxLength; i++)
+  {
+    lines += (rxData[i] == '\n');
+  }
+  rxLength = 0;
+  return lines ? lines : 1;
+}
+
+/**
+ * @brief Switches the inverter to Modbus RTU with the ASCII command
+ * @retval 0=success
+ */
+static int EnterModbus(void)
+{
+  char command[LINE_SIZE];
+  uint64_t deadline = Micros() + 1000000ULL;
+  int length = snprintf(command, sizeof(command), "MODBUS %u\r", address);
+
+  if (write(fd, command, (size_t)length) != length)
+    return 1;
+
+  while (Micros() < deadline)
+  {
+    ReceiveRaw(1000);
+    if (rxLength >= 4 && memcmp(rxData, "OK\r\n", 4) == 0)
+    {
+      rxLength = 0;
+      usleep(20000);                  /* Let the mode switch settle */
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/**
+ * @brief Writes the protocol register back to ASCII
+ * @retval None
+ */
+static void LeaveModbus(void)
+{
+  uint8_t frame[8] = { address, MB_FC_WRITE, 0, MB_REG_PROTOCOL, 0, 0, 0, 0 };
+  uint16_t crc = Crc16(frame, 6);
+
+  frame[6] = (uint8_t)crc;
+  frame[7] = (uint8_t)(crc >> 8);
+  usleep(5000);
+  if (write(fd, frame, sizeof(frame)) != (ssize_t)sizeof(frame))
+    return;
+  usleep(50000);
+  tcflush(fd, TCIFLUSH);
+}
+
+static int CompareU32(const void* a, const void* b)
+{
+  uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+
+  return (x > y) - (x < y);
+}
+
+static void Report(unsigned sent, uint64_t elapsedUs)
+{
+  double seconds = elapsedUs / 1e6;
+
+  printf("mode %s, %u commands in %.3f s: %.1f cmd/s (%.1f ok/s)\n",
+         mode == MODE_ASCII ? "ascii" : "modbus", sent, seconds,
+         sent / seconds, okCount / seconds);
+  printf("replies: ok %u, garbled %u, lost %u\n", okCount, garbledCount, lostCount);
+
+  if (okCount > 0)
+  {
+    qsort(latencies, okCount, sizeof(uint32_t), CompareU32);
+    printf("latency ms: min %.2f  p50 %.2f  p90 %.2f  p99 %.2f  max %.2f\n",
+           latencies[0] / 1e3, latencies[okCount / 2] / 1e3,
+           latencies[(okCount * 9) / 10] / 1e3, latencies[(okCount * 99) / 100] / 1e3,
+           latencies[okCount - 1] / 1e3);
+  }
+}